@@ -0,0 +1,365 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "include.h"
+#include "PerfCounters.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+
+/**
+ * Small harness for timing kernels in isolation.
+ * A kernel is called repeatedly until the minimum run time is reached, it reports how many operations it did per call.
+ * Heap allocations are counted through Benchmark::allocations(), which the executable's operator new has to increment.
+ * Hardware counters are read around the measured parts when enabled with enablePerfCounters().
+ */
+class Benchmark
+{
+public:
+    using Clock = chrono::steady_clock;
+
+    /**
+     * Result of a single benchmark
+     */
+    struct Result
+    {
+        string name;
+        uint64_t ops = 0;
+        double seconds = 0.0;
+        uint64_t allocations = 0;
+        PerfCounters::Values counters;
+
+        double nsPerOp() const
+        {
+            return ops == 0 ? 0.0 : seconds * 1e9 / ops;
+        }
+
+        double opsPerSec() const
+        {
+            return seconds <= 0.0 ? 0.0 : ops / seconds;
+        }
+
+        double allocsPerOp() const
+        {
+            return ops == 0 ? 0.0 : static_cast<double>(allocations) / ops;
+        }
+
+        /**
+         * Get a hardware counter per operation.
+         * @param e The event.
+         * @return The count per operation, or -1 if the event was not counted.
+         */
+        double perOp(int e) const
+        {
+            if (!counters.valid[e])
+            {
+                return -1.0;
+            }
+            return ops == 0 ? 0.0 : counters.counts[e] / ops;
+        }
+
+        /**
+         * Get the instructions per cycle.
+         * @return The IPC, or -1 if cycles or instructions were not counted.
+         */
+        double ipc() const
+        {
+            if (!counters.valid[PerfCounters::CYCLES] || !counters.valid[PerfCounters::INSTRUCTIONS] || counters.counts[PerfCounters::CYCLES] <= 0)
+            {
+                return -1.0;
+            }
+            return counters.counts[PerfCounters::INSTRUCTIONS] / counters.counts[PerfCounters::CYCLES];
+        }
+    };
+
+    /**
+     * Timing state handed to a kernel, allows excluding setup work from the measurement.
+     */
+    class State
+    {
+    public:
+        /**
+         * Stop the clock and the allocation counter, e.g. before building the input of the next iteration.
+         */
+        void pauseTiming()
+        {
+            elapsed += Clock::now() - start;
+            allocations += Benchmark::allocations().load(memory_order_relaxed) - allocationStart;
+            if (perf)
+            {
+                counters += perf->read() - counterStart;
+            }
+            running = false;
+        }
+
+        /**
+         * Restart the clock and the allocation counter after pauseTiming().
+         */
+        void resumeTiming()
+        {
+            allocationStart = Benchmark::allocations().load(memory_order_relaxed);
+            if (perf)
+            {
+                counterStart = perf->read();
+            }
+            start = Clock::now();
+            running = true;
+        }
+
+    private:
+        friend class Benchmark;
+
+        Clock::time_point start;
+        Clock::duration elapsed = Clock::duration::zero();
+        uint64_t allocationStart = 0;
+        uint64_t allocations = 0;
+        const PerfCounters *perf = nullptr;
+        PerfCounters::Values counterStart;
+        PerfCounters::Values counters;
+        bool running = false;
+    };
+
+    /**
+     * Constructor for the Benchmark class.
+     * @param minSeconds The minimum measured time per benchmark.
+     * @param filter Only benchmarks whose name contains this string are run.
+     */
+    explicit Benchmark(double minSeconds = 0.5, string filter = "")
+        : MINSECONDS(minSeconds), FILTER(std::move(filter))
+    {
+    }
+
+    /**
+     * Read hardware counters around every benchmark from now on.
+     * Counters are opened for the calling thread, kernels must run on it.
+     * @return True if at least one counter is available, false if only wall-clock time is reported.
+     */
+    bool enablePerfCounters()
+    {
+        perf = make_unique<PerfCounters>();
+        if (!perf->available())
+        {
+            perf.reset();
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Global heap allocation counter.
+     * @return The counter, incremented by the replaced operator new of the benchmark executable.
+     */
+    static atomic<uint64_t> &allocations()
+    {
+        static atomic<uint64_t> counter{0};
+        return counter;
+    }
+
+    /**
+     * Keep the compiler from optimizing away a computed value.
+     * @param value The value that has to be computed.
+     */
+    template <typename T>
+    static void doNotOptimize(const T &value)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    /**
+     * Run a kernel until the minimum run time is reached.
+     * @param name The name of the benchmark.
+     * @param kernel Callable taking State &, returning the number of operations it performed.
+     * @return True if the benchmark ran, false if it was filtered out.
+     */
+    template <typename Kernel>
+    bool run(const string &name, Kernel &&kernel)
+    {
+        if (!FILTER.empty() && name.find(FILTER) == string::npos)
+        {
+            return false;
+        }
+
+        // warm-up: fill caches and pools before measuring
+        {
+            State warmup;
+            warmup.perf = perf.get();
+            warmup.resumeTiming();
+            kernel(warmup);
+        }
+
+        Result result;
+        result.name = name;
+        State state;
+        state.perf = perf.get();
+        while (chrono::duration<double>(state.elapsed).count() < MINSECONDS)
+        {
+            state.resumeTiming();
+            result.ops += kernel(state);
+            if (state.running)
+            {
+                state.pauseTiming();
+            }
+        }
+        result.seconds = chrono::duration<double>(state.elapsed).count();
+        result.allocations = state.allocations;
+        result.counters = state.counters;
+
+        printResult(result);
+        results.push_back(result);
+        return true;
+    }
+
+    /**
+     * Print the header of the result table.
+     */
+    void printHeader() const
+    {
+        printf("%-44s %14s %16s %12s", "benchmark", "ns/op", "ops/sec", "allocs/op");
+        if (perf)
+        {
+            printf(" %12s %12s %6s %12s %12s %12s", "cycles/op", "instr/op", "IPC", "L1Dmiss/op", "LLCmiss/op", "brmiss/op");
+        }
+        printf("\n");
+    }
+
+    /**
+     * Print a single result as a table row, counters that are not available are shown as -.
+     * @param result The result to print.
+     */
+    void printResult(const Result &result) const
+    {
+        printf("%-44s %14.1f %16.0f %12.3f", result.name.c_str(), result.nsPerOp(), result.opsPerSec(), result.allocsPerOp());
+        if (perf)
+        {
+            for (int e : {PerfCounters::CYCLES, PerfCounters::INSTRUCTIONS})
+            {
+                printCounter(result.perOp(e), 12, 1);
+            }
+            printCounter(result.ipc(), 6, 2);
+            for (int e : {PerfCounters::L1DMISSES, PerfCounters::LLCMISSES, PerfCounters::BRANCHMISSES})
+            {
+                printCounter(result.perOp(e), 12, 3);
+            }
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+
+    /**
+     * Write all results as JSON.
+     * @param filename The output file.
+     */
+    void writeJson(const string &filename) const
+    {
+        ofstream ofs(filename);
+        ofs << "{\n  \"benchmarks\": [\n";
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const Result &r = results[i];
+            ofs << "    {\"name\": \"" << r.name << "\""
+                << ", \"ops\": " << r.ops
+                << ", \"seconds\": " << r.seconds
+                << ", \"ns_per_op\": " << r.nsPerOp()
+                << ", \"ops_per_sec\": " << r.opsPerSec()
+                << ", \"allocs_per_op\": " << r.allocsPerOp();
+            for (int e = 0; e < PerfCounters::EVENTS; ++e)
+            {
+                if (r.counters.valid[e])
+                {
+                    ofs << ", \"" << PerfCounters::name(e) << "_per_op\": " << r.perOp(e);
+                }
+            }
+            if (r.ipc() >= 0)
+            {
+                ofs << ", \"ipc\": " << r.ipc();
+            }
+            ofs << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        ofs << "  ]\n}\n";
+    }
+
+    /**
+     * Get the results of all benchmarks run so far.
+     * @return The results.
+     */
+    const vector<Result> &getResults() const
+    {
+        return results;
+    }
+
+private:
+    double MINSECONDS;
+    string FILTER;
+    vector<Result> results;
+    unique_ptr<PerfCounters> perf;
+
+    static void printCounter(double value, int width, int precision)
+    {
+        if (value < 0)
+        {
+            printf(" %*s", width, "-");
+        }
+        else
+        {
+            printf(" %*.*f", width, precision, value);
+        }
+    }
+};
+
+/**
+ * A position from the benchmark corpus together with the player to move.
+ */
+template <typename Board>
+struct CorpusPosition
+{
+    Board board;
+    Player toMove;
+    int moves;
+};
+
+/**
+ * Generate a reproducible corpus of positions by random play.
+ * Games are cut at a random length and never contain a win, so every position is still in play.
+ * @param count The number of positions.
+ * @param seed The random seed.
+ * @param maxMoves The maximum number of moves played per position.
+ * @return The positions.
+ */
+template <typename Board>
+vector<CorpusPosition<Board>> generateCorpus(size_t count, uint32_t seed = 42, int maxMoves = 30)
+{
+    mt19937 rng(seed);
+    vector<CorpusPosition<Board>> corpus;
+    corpus.reserve(count);
+
+    while (corpus.size() < count)
+    {
+        Board board;
+        Player player = Player::USER;
+        int length = static_cast<int>(rng() % (maxMoves + 1));
+        int moves = 0;
+        for (; moves < length; ++moves)
+        {
+            uint32_t safe = board.nonLosingColumns(player) & ~board.winningColumns(player);
+            if (!safe)
+            {
+                break;
+            }
+            typename Board::MoveList options;
+            for (int c = 0; c < Board::COLS; ++c)
+            {
+                if (safe & (1u << c))
+                {
+                    options.push_back(static_cast<Column>(c));
+                }
+            }
+            board.dropDisc(options[rng() % options.size()], player);
+            player = board.getOponent(player);
+        }
+        corpus.push_back({board, player, moves});
+    }
+    return corpus;
+}
+
+#endif // BENCHMARK_H
@@ -0,0 +1,60 @@
+#ifndef BOUNDS_CHECK_H
+#define BOUNDS_CHECK_H
+
+#include "include.h"
+
+/**
+ * Compile-time switch for bounds checking on board access.
+ * Checked by default, unchecked when NDEBUG is defined (release builds).
+ * Override with -DCONNECT4_BOUNDS_CHECK=0 or -DCONNECT4_BOUNDS_CHECK=1.
+ */
+#ifndef CONNECT4_BOUNDS_CHECK
+#ifdef NDEBUG
+#define CONNECT4_BOUNDS_CHECK 0
+#else
+#define CONNECT4_BOUNDS_CHECK 1
+#endif
+#endif
+
+/**
+ * Bounds policy that throws out_of_range on an invalid cell.
+ */
+struct CheckedBounds
+{
+    static constexpr bool enabled = true;
+
+    /**
+     * Check that a cell lies on a rows x cols board.
+     * @param row The row index.
+     * @param col The column index.
+     * @param rows The number of rows.
+     * @param cols The number of columns.
+     * @param where Description of the caller, used as exception message.
+     */
+    static void check(int row, int col, int rows, int cols, const char *where)
+    {
+        if (row < 0 || row >= rows || col < 0 || col >= cols)
+        {
+            throw out_of_range(where);
+        }
+    }
+};
+
+/**
+ * Bounds policy that trusts the caller, the check compiles to nothing.
+ */
+struct UncheckedBounds
+{
+    static constexpr bool enabled = false;
+
+    static void check(int, int, int, int, const char *)
+    {
+    }
+};
+
+/**
+ * The bounds policy selected for this build
+ */
+using BoundsCheck = conditional_t<CONNECT4_BOUNDS_CHECK, CheckedBounds, UncheckedBounds>;
+
+#endif // BOUNDS_CHECK_H
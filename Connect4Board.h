@@ -3,16 +3,11 @@
 
 #include "include.h"
 
-class Connect4Board
+/**
+ * Types shared by the boards of every size.
+ */
+struct Connect4Types
 {
-public:
-    /**
-     * Constants for the dimensions of the Connect 4 board.
-     * ROWS = 6, COLS = 7
-     */
-    static constexpr int ROWS = 6;
-    static constexpr int COLS = 7;
-
     /**
      * Direction vectors for checking winning conditions.
      * These represent the 4 possible directions: horizontal, vertical, diagonal down-right, and diagonal down-left.
@@ -32,7 +27,7 @@ public:
 
     /**
      * Enumeration for the columns of the Connect 4 board.
-     * Each column is represented by a character from A to G.
+     * Each column is represented by a character from A to G, boards with more columns continue with H and I.
      */
     enum Column
     {
@@ -43,12 +38,14 @@ public:
         E = 4,
         F = 5,
         G = 6,
+        H = 7,
+        I = 8,
         INVALID = -1
     };
 
     /**
      * Convert a character to a Column enumeration.
-     * @param column The character representing the column (A-G).
+     * @param column The character representing the column (A-I).
      * @return The corresponding Column enumeration.
      */
     static Column charToColumn(char column)
@@ -83,42 +80,19 @@ public:
             return Column::G;
         case 'G':
             return Column::G;
+        case 'h':
+            return Column::H;
+        case 'H':
+            return Column::H;
+        case 'i':
+            return Column::I;
+        case 'I':
+            return Column::I;
         default:
             throw invalid_argument("Invalid column character");
         }
     }
 
-    /**
-     * Convert a character to a Column enumeration.
-     * @param column The character representing the column (A-G).
-     * @return The corresponding Column enumeration.
-     */
-    static string colToChar(Column column)
-    {
-        switch (column)
-        {
-        case Column::A:
-            return string(1, 'A');
-        case Column::B:
-            return string(1, 'B');
-        case Column::C:
-            return string(1, 'C');
-        case Column::D:
-            return string(1, 'D');
-        case Column::E:
-            return string(1, 'E');
-        case Column::F:
-            return string(1, 'F');
-        case Column::G:
-            return string(1, 'G');
-        case Column::INVALID:
-            return string(1, '?');
-        default:
-            cout << "Invalid column: " << column << endl;
-            throw invalid_argument("Invalid column");
-        }
-    }
-
     /**
      * Enumeration for the players in the game.
      * EMPTY represents an empty cell, BOT and USER represent the two players.
@@ -150,6 +124,74 @@ public:
         }
     }
 
+    /**
+     * Structure to hold information about a move
+     */
+    struct MoveInfo
+    {
+        Column column;
+        Player player;
+    };
+};
+
+/**
+ * Connect 4 board with the dimensions and win length fixed at compile time.
+ * @tparam ROWS_ The number of rows.
+ * @tparam COLS_ The number of columns (at most 9).
+ * @tparam WIN_ The number of discs in a row needed to win.
+ */
+template <int ROWS_, int COLS_, int WIN_>
+class BasicConnect4Board : public Connect4Types
+{
+public:
+    /**
+     * Constants for the dimensions of the Connect 4 board.
+     * The classic board has ROWS = 6, COLS = 7 and WIN = 4
+     */
+    static constexpr int ROWS = ROWS_;
+    static constexpr int COLS = COLS_;
+    static constexpr int WIN = WIN_;
+
+    static_assert(COLS >= 1 && COLS <= 9, "Columns are named A to I");
+    static_assert(WIN >= 2 && WIN <= ROWS && WIN <= COLS, "The win length must fit on the board");
+
+    /**
+     * Convert a Column enumeration to its character.
+     * @param column The Column enumeration.
+     * @return The character representing the column (A-G), or '?' for INVALID.
+     */
+    static char colToChar(Column column)
+    {
+        if (column == Column::INVALID)
+        {
+            return '?';
+        }
+        if (column < 0 || column >= COLS)
+        {
+            if constexpr (BoundsCheck::enabled)
+            {
+                cout << "Invalid column: " << column << endl;
+            }
+            throw invalid_argument("Invalid column");
+        }
+        return static_cast<char>('A' + column);
+    }
+
+    /**
+     * Get the column name as a string literal, without allocating.
+     * @param column The Column enumeration.
+     * @return The name of the column (A-G), or "?" for INVALID.
+     */
+    static const char *columnLabel(Column column)
+    {
+        static constexpr const char *labels[] = {"A", "B", "C", "D", "E", "F", "G", "H", "I"};
+        if (column < 0 || column >= COLS)
+        {
+            return "?";
+        }
+        return labels[column];
+    }
+
     /**
      * The grid representing the Connect 4 board.
      * Each cell can be EMPTY, BOT, or USER.
@@ -157,10 +199,117 @@ public:
     array<array<Player, COLS>, ROWS> grid;
 
     /**
-     * Constructor for the Connect4Board class.
+     * Bitboards mirroring the grid, kept up to date by setCell.
+     * Every column uses ROWS + 1 bits, bit 0 of a column is its bottom cell and the top bit is always empty.
+     * discs[0] holds the BOT discs, discs[1] the USER discs.
+     */
+    array<uint64_t, 2> discs = {0, 0};
+
+    /**
+     * Number of bits used per column in the bitboards.
+     */
+    static constexpr int COLBITS = ROWS + 1;
+    static_assert(COLBITS * COLS <= 64, "The bitboards do not fit in 64 bits");
+    static_assert((WIN - 1) * (COLBITS + 1) < 64, "The win length is too long for the bitboard shifts");
+
+    /**
+     * Bitboard with the bottom cell of every column set.
+     */
+    static constexpr uint64_t BOTTOMMASK = []
+    {
+        uint64_t mask = 0;
+        for (int c = 0; c < COLS; ++c)
+        {
+            mask |= uint64_t(1) << (c * COLBITS);
+        }
+        return mask;
+    }();
+
+    /**
+     * Bitboard with every cell of the board set.
+     */
+    static constexpr uint64_t BOARDMASK = BOTTOMMASK * ((uint64_t(1) << ROWS) - 1);
+
+    /**
+     * Bitboard shifts for the 4 directions: horizontal, vertical, and both diagonals.
+     * The empty top bit of every column keeps lines from wrapping into the next column.
+     */
+    static constexpr int SHIFTS[4] = {COLBITS, 1, COLBITS + 1, COLBITS - 1};
+
+    /**
+     * Number of lines of WIN cells that fit on the board.
+     */
+    static constexpr int LINECOUNT = ROWS * (COLS - WIN + 1) + (ROWS - WIN + 1) * COLS + 2 * (ROWS - WIN + 1) * (COLS - WIN + 1);
+
+    /**
+     * Bitboards of all lines of WIN cells on the board, in the order
+     * horizontal, vertical, diagonal down-right, diagonal down-left.
+     */
+    static constexpr array<uint64_t, LINECOUNT> LINES = []
+    {
+        array<uint64_t, LINECOUNT> lines{};
+        int n = 0;
+        for (int dir = 0; dir < 4; ++dir)
+        {
+            for (int r = 0; r < ROWS; ++r)
+            {
+                for (int c = 0; c < COLS; ++c)
+                {
+                    int er = r + dr[dir] * (WIN - 1);
+                    int ec = c + dc[dir] * (WIN - 1);
+                    if (er < 0 || er >= ROWS || ec < 0 || ec >= COLS)
+                    {
+                        continue;
+                    }
+                    uint64_t line = 0;
+                    for (int k = 0; k < WIN; ++k)
+                    {
+                        line |= uint64_t(1) << ((c + dc[dir] * k) * COLBITS + (ROWS - 1 - (r + dr[dir] * k)));
+                    }
+                    lines[n++] = line;
+                }
+            }
+        }
+        return lines;
+    }();
+
+    /**
+     * The lines passing through a single cell.
+     */
+    struct CellLines
+    {
+        array<uint64_t, 4 * WIN> lines{};
+        int count = 0;
+    };
+
+    /**
+     * For every cell (indexed row * COLS + col), the lines of WIN cells passing through it.
+     */
+    static constexpr array<CellLines, ROWS * COLS> CELLLINES = []
+    {
+        array<CellLines, ROWS * COLS> table{};
+        for (int r = 0; r < ROWS; ++r)
+        {
+            for (int c = 0; c < COLS; ++c)
+            {
+                CellLines &cell = table[r * COLS + c];
+                for (uint64_t line : LINES)
+                {
+                    if (line & (uint64_t(1) << (c * COLBITS + (ROWS - 1 - r))))
+                    {
+                        cell.lines[cell.count++] = line;
+                    }
+                }
+            }
+        }
+        return table;
+    }();
+
+    /**
+     * Constructor for the BasicConnect4Board class.
      * Initializes the board to an empty state.
      */
-    Connect4Board()
+    BasicConnect4Board()
     {
         for (auto &row : grid)
         {
@@ -168,6 +317,55 @@ public:
         }
     }
 
+    /**
+     * Get the bit of a cell in the bitboards.
+     * @param row The row index.
+     * @param col The column index.
+     * @return The bitboard with only that cell set.
+     */
+    static constexpr uint64_t cellBit(int row, int col)
+    {
+        return uint64_t(1) << (col * COLBITS + (ROWS - 1 - row));
+    }
+
+    /**
+     * Get the bitboard with all cells of a column set.
+     * @param col The column index.
+     * @return The column bitboard.
+     */
+    static constexpr uint64_t columnMask(int col)
+    {
+        return ((uint64_t(1) << ROWS) - 1) << (col * COLBITS);
+    }
+
+    /**
+     * Get the bitboard of the discs of a player.
+     * @param player The player.
+     * @return The bitboard with all cells of the player set.
+     */
+    uint64_t playerBits(Player player) const
+    {
+        return player == Player::BOT ? discs[0] : discs[1];
+    }
+
+    /**
+     * Get the bitboard of all occupied cells.
+     * @return The occupied cells.
+     */
+    uint64_t occupied() const
+    {
+        return discs[0] | discs[1];
+    }
+
+    /**
+     * Get the bitboard of the cells where a disc can be dropped right now.
+     * @return The playable cells, one per non-full column.
+     */
+    uint64_t playableCells() const
+    {
+        return (occupied() + BOTTOMMASK) & BOARDMASK;
+    }
+
     /**
      * Print the current state of the board.
      */
@@ -212,7 +410,7 @@ public:
     {
         if (column < 0 || column >= COLS)
         {
-            throw out_of_range("Column index out of range (" + colToChar(column) + ")");
+            throw out_of_range(string("Column index out of range (") + colToChar(column) + ")");
         }
         int row = findRow(column);
         if (row < 0)
@@ -224,6 +422,27 @@ public:
         return checkWin(player);
     }
 
+    /**
+     * Take the top disc out of a column, the reverse of dropDisc.
+     * @param column The column to take the disc from.
+     * @return The player whose disc was removed, Player::EMPTY if the column is empty.
+     */
+    Player removeDisc(Column column)
+    {
+        if (column < 0 || column >= COLS)
+        {
+            throw out_of_range(string("Column index out of range (") + colToChar(column) + ")");
+        }
+        int row = findRow(column) + 1;
+        if (row >= ROWS)
+        {
+            return Player::EMPTY;
+        }
+        Player player = getCell(row, column);
+        setCell(row, column, Player::EMPTY);
+        return player;
+    }
+
     /**
      * Get the current state of a cell in the grid.
      * @param row The row index.
@@ -232,11 +451,7 @@ public:
      */
     Player getCell(int row, int col) const
     {
-        if (!inBoard(row, col, true))
-        {
-            cout << "Connect4Board::getCell: Row or column index out of range" << endl;
-            // throw out_of_range("Connect4Board::getCell: Row or column index out of range");
-        }
+        BoundsCheck::check(row, col, ROWS, COLS, "Connect4Board::getCell: Row or column index out of range");
         return grid[row][col];
     }
 
@@ -248,12 +463,20 @@ public:
      */
     void setCell(int row, int column, Player val)
     {
-        // optionele bound-checks:
-        if (!inBoard(row, column, true))
+        BoundsCheck::check(row, column, ROWS, COLS, "Connect4Board::setCell: index out of range");
+        grid[row][column] = val;
+
+        uint64_t bit = cellBit(row, column);
+        discs[0] &= ~bit;
+        discs[1] &= ~bit;
+        if (val == Player::BOT)
         {
-            throw out_of_range("Connect4Board::setCell: index out of range");
+            discs[0] |= bit;
+        }
+        else if (val == Player::USER)
+        {
+            discs[1] |= bit;
         }
-        grid[row][column] = val;
     }
 
     /**
@@ -267,57 +490,156 @@ public:
     }
 
     /**
-     * Check if the specified player has won the game.
+     * Check if the specified player has WIN discs in a row.
      * @param player The player to check for a win.
      * @return True if the player has won, false otherwise.
      */
     bool checkWin(Player player) const
     {
-        for (int r = 0; r < ROWS; ++r)
+        return hasWin(playerBits(player));
+    }
+
+    /**
+     * Check if a bitboard contains WIN discs in a row.
+     * @param bits The discs of one player.
+     * @return True if the discs contain a winning line.
+     */
+    static bool hasWin(uint64_t bits)
+    {
+        for (int shift : SHIFTS)
         {
-            for (int c = 0; c < COLS; ++c)
+            uint64_t run = bits;
+            for (int k = 1; k < WIN; ++k)
             {
-                if (getCell(r, c) != player)
-                {
-                    continue;
-                }
-                for (int dir = 0; dir < 4; ++dir)
+                run &= bits >> (k * shift);
+            }
+            if (run)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Get all empty cells that would complete WIN in a row for the player.
+     * The cells do not have to be playable yet.
+     * @param player The player to check for.
+     * @return The bitboard of winning cells.
+     */
+    uint64_t winningCells(Player player) const
+    {
+        return winningCells(playerBits(player), occupied());
+    }
+
+    /**
+     * Get all empty cells that would complete WIN in a row for a set of discs.
+     * @param p The discs of one player.
+     * @param occupiedCells The cells occupied by either player.
+     * @return The bitboard of winning cells.
+     */
+    static uint64_t winningCells(uint64_t p, uint64_t occupiedCells)
+    {
+        uint64_t r = 0;
+
+        for (int shift : SHIFTS)
+        {
+            // the empty cell is at position j of the line, all other cells belong to the player
+            for (int j = 0; j < WIN; ++j)
+            {
+                uint64_t line = BOARDMASK;
+                for (int k = 0; k < WIN; ++k)
                 {
-                    int cnt = 1;
-                    int rr = r + dr[dir], cc = c + dc[dir];
-                    while (inBoard(rr, cc) && getCell(rr, cc) == player)
+                    if (k < j)
+                    {
+                        line &= p << ((j - k) * shift);
+                    }
+                    else if (k > j)
                     {
-                        ++cnt;
-                        if (cnt == 4)
-                        {
-                            return true;
-                        }
-                        rr += dr[dir];
-                        cc += dc[dir];
+                        line &= p >> ((k - j) * shift);
                     }
                 }
+                r |= line;
             }
         }
-        return false;
+
+        return r & (BOARDMASK ^ occupiedCells);
+    }
+
+    /**
+     * Convert a bitboard to a mask with bit c set for every column c that has a cell in the bitboard.
+     * @param cells The bitboard.
+     * @return The column mask.
+     */
+    static uint32_t toColumnMask(uint64_t cells)
+    {
+        uint32_t mask = 0;
+        for (int c = 0; c < COLS; ++c)
+        {
+            if (cells & columnMask(c))
+            {
+                mask |= 1u << c;
+            }
+        }
+        return mask;
+    }
+
+    /**
+     * Get the columns in which the player wins immediately.
+     * @param player The player to move.
+     * @return Column mask with bit c set if playing column c wins.
+     */
+    uint32_t winningColumns(Player player) const
+    {
+        return toColumnMask(winningCells(player) & playableCells());
+    }
+
+    /**
+     * Get the columns the player can play without handing the opponent an immediate win.
+     * A move loses if the opponent can already win somewhere else, or if it makes the cell
+     * above it playable while that cell wins for the opponent.
+     * @param player The player to move.
+     * @return Column mask with bit c set if playing column c does not lose on the next move.
+     */
+    uint32_t nonLosingColumns(Player player) const
+    {
+        uint64_t playable = playableCells();
+        uint64_t opponentWin = winningCells(getOponent(player));
+        uint64_t forced = playable & opponentWin;
+
+        if (forced)
+        {
+            if (forced & (forced - 1))
+            {
+                // the opponent has two threats, only one can be blocked
+                return 0;
+            }
+            playable = forced;
+        }
+        return toColumnMask(playable & ~(opponentWin >> 1));
     }
 
     /**
      * Check if the specified row and column are within the bounds of the board.
      * @param r The row index.
      * @param c The column index.
+     * @param debug Report out of bounds indices on cerr, only in builds with bounds checking.
      * @return True if the indices are within bounds, false otherwise.
      */
     bool inBoard(int r, int c, bool debug = false) const
     {
-        if (debug)
+        if constexpr (BoundsCheck::enabled)
         {
-            if (r < 0 || r >= ROWS)
-            {
-                cerr << "Row index out of bounds: " << r << endl;
-            }
-            if (c < 0 || c >= COLS)
+            if (debug)
             {
-                cerr << "Column index out of bounds: " << c << endl;
+                if (r < 0 || r >= ROWS)
+                {
+                    cerr << "Row index out of bounds: " << r << endl;
+                }
+                if (c < 0 || c >= COLS)
+                {
+                    cerr << "Column index out of bounds: " << c << endl;
+                }
             }
         }
         return r >= 0 && r < ROWS && c >= 0 && c < COLS;
@@ -372,24 +694,25 @@ public:
         return true;
     }
 
+    /**
+     * Fixed-capacity list of moves, stored on the stack.
+     */
+    using MoveList = StaticVector<Column, COLS>;
+
     /**
      * Get all possible moves for the current player
-     * @param board The current state of the board
-     * @return A vector of Columns representing possible moves
+     * @return A MoveList of Columns representing possible moves
      */
-    vector<Column> getPossibleMoves()
+    MoveList getPossibleMoves() const
     {
-        vector<Column> validMoves;
+        MoveList validMoves;
+        uint32_t columns = possibleColumns();
 
         for (int col = 0; col < COLS; ++col)
         {
-            for (int row = ROWS - 1; row >= 0; --row)
+            if (columns & (1u << col))
             {
-                if (getCell(row, col) == Player::EMPTY)
-                {
-                    validMoves.push_back(static_cast<Column>(col));
-                    break;
-                }
+                validMoves.push_back(static_cast<Column>(col));
             }
         }
 
@@ -397,13 +720,13 @@ public:
     }
 
     /**
-     * Structure to hold information about a move
+     * Get the columns that still have space.
+     * @return Column mask with bit c set if column c is not full.
      */
-    struct MoveInfo
+    uint32_t possibleColumns() const
     {
-        Column column;
-        Player player;
-    };
+        return toColumnMask(playableCells());
+    }
 
     /**
      * Get the difference between two board states.
@@ -411,7 +734,7 @@ public:
      * @param after The board state after the move.
      * @return A MoveInfo struct representing the move difference.
      */
-    static MoveInfo getMoveDifference(const Connect4Board &before, const Connect4Board &after)
+    static MoveInfo getMoveDifference(const BasicConnect4Board &before, const BasicConnect4Board &after)
     {
         for (int col = 0; col < before.COLS; ++col)
         {
@@ -437,11 +760,77 @@ public:
         throw runtime_error("No move difference found.");
     }
 
+    /**
+     * Get a unique key for the current position.
+     * Every column is encoded in COLBITS bits: one bit per BOT disc, plus a sentinel bit on top of the stack.
+     * Assumes the discs respect gravity, which holds for every position reachable through dropDisc.
+     * @return The 64-bit position key.
+     */
+    uint64_t key() const
+    {
+        return discs[0] + occupied() + BOTTOMMASK;
+    }
+
+    /**
+     * Mirror a bitboard (or position key) left to right.
+     * @param bits The bitboard to mirror.
+     * @return The bitboard with column c moved to column COLS - 1 - c.
+     */
+    static constexpr uint64_t mirrorBits(uint64_t bits)
+    {
+        constexpr uint64_t column = (uint64_t(1) << COLBITS) - 1;
+        uint64_t result = 0;
+        for (int c = 0; c < COLS; ++c)
+        {
+            result |= ((bits >> (c * COLBITS)) & column) << ((COLS - 1 - c) * COLBITS);
+        }
+        return result;
+    }
+
+    /**
+     * Get the column a move is mapped to by mirroring the board.
+     * @param column The column.
+     * @return The mirrored column.
+     */
+    static Column mirrorColumn(Column column)
+    {
+        return static_cast<Column>(COLS - 1 - column);
+    }
+
+    /**
+     * Get the key of the mirrored position.
+     * @return The key of the position mirrored left to right.
+     */
+    uint64_t mirrorKey() const
+    {
+        return mirrorBits(key());
+    }
+
+    /**
+     * Get the key of the position in canonical orientation: the smallest of the key and the mirrored key.
+     * A position and its mirror image share the same canonical key.
+     * @return The canonical key.
+     */
+    uint64_t canonicalKey() const
+    {
+        return min(key(), mirrorKey());
+    }
+
+    /**
+     * Check if the position is its own mirror image.
+     * In a symmetric position, the moves in column c and COLS - 1 - c lead to mirrored positions.
+     * @return True if the position is left-right symmetric, false otherwise.
+     */
+    bool isSymmetric() const
+    {
+        return mirrorBits(discs[0]) == discs[0] && mirrorBits(discs[1]) == discs[1];
+    }
+
     /**
      * Adds functionality to compare 2 boards their grid
      * @return true if the grids are equal, false otherwise
      */
-    bool operator==(const Connect4Board &other) const
+    bool operator==(const BasicConnect4Board &other) const
     {
         return this->grid == other.grid;
     }
@@ -450,10 +839,15 @@ public:
      * Adds functionality to check if 2 boards their grid are not equal
      * @return true if the grids are not equal, false otherwise
      */
-    bool operator!=(const Connect4Board &other) const
+    bool operator!=(const BasicConnect4Board &other) const
     {
         return !(*this == other);
     }
 };
 
+/**
+ * The classic 6 x 7 board with four in a row.
+ */
+using Connect4Board = BasicConnect4Board<6, 7, 4>;
+
 #endif // CONNECT4_BOARD_H
\ No newline at end of file
@@ -0,0 +1,1037 @@
+#ifndef DISTRIBUTED_SOLVER_H
+#define DISTRIBUTED_SOLVER_H
+
+#include "include.h"
+#include "LocalSocket.h"
+#include "Solver.h"
+#include <chrono>
+#include <deque>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unordered_map>
+
+/**
+ * Exact solver that splits a position into subproblems and solves them in worker processes.
+ *
+ * The coordinator expands the position to every line of `split` moves (the opening prefixes). Every distinct position
+ * at the end of a prefix is one subproblem; transpositions and mirror images are merged. Lines that end the game
+ * earlier are scored on the spot. Workers search the subproblems with their own Solver and keep its transposition
+ * table across searches.
+ *
+ * The coordinator runs alpha-beta over the prefixes, in the center-first order of Solver, and hands the subproblems to
+ * the workers with the window the walk has when it reaches them. Like Solver, it narrows the score of the root down
+ * with null-window walks, then one walk with a window around the score finds the best move. Within a walk, the first
+ * move of a position gets the window, the other moves a null window on the best score so far; only a move that beats
+ * it is searched again with the window. The other moves wait for the score of the first, then they are searched in
+ * parallel. Every subproblem keeps the bounds its searches proved and is only searched again if they do not settle
+ * the window of the walk. A walk is repeated whenever a search finishes, until it needs none, so a subproblem is only
+ * solved exactly if its score can change the result. Scores and the best move (the first of equal moves in
+ * center-first order) are the same as a single Solver finds.
+ *
+ * Workers are forked processes that talk to the coordinator over a socket pair, one line per message:
+ *
+ *   solve <job> <budget> <alpha> <beta> <moves>   -> <job> progress <n>                      (while solving, see heartbeatSeconds)
+ *                                                    <job> score <s> exact <0|1> nodes <n>   (or <job> error <message>)
+ *   quit                                             the worker exits
+ *
+ * The score is that of Solver::solve with the window (alpha, beta). With a node budget, a search that runs out
+ * replies a guess and exact 0; the guess stands for the score of the subproblem and the result is not exact.
+ *
+ * A subproblem is the move string that reaches it from the start position, so a worker needs no state from the
+ * coordinator. serveJobs only needs a connection; workers on other machines can use it over any stream later.
+ * A worker that dies or closes its connection is replaced, and its search is sent again. So is a worker that
+ * sends nothing, not even a progress line, for heartbeatSeconds while it solves (hung, or stopped with SIGSTOP); it is
+ * killed first.
+ * The coordinator forks, so create it before the process starts threads.
+ *
+ * With a checkpoint file, a solve can be stopped at any time and resumed by solving the same position again:
+ *  - the coordinator rewrites the checkpoint, the root and every subproblem with the bounds found so far, at most every
+ *    checkpointSeconds when a search finished, and once the solve is done. A resume only searches what they leave open.
+ *  - every worker saves its transposition table to <checkpoint>.tt<n> (n is the worker's slot) every checkpointSeconds,
+ *    also in the middle of a subproblem. The worker forks and the child writes the copy-on-write snapshot of the table,
+ *    so the worker does not wait for the disk. A started or restarted worker loads the table of its slot.
+ * A resume repeats the searches that were running, with the tables of the last checkpoint to speed them up, and those
+ * finished after the last coordinator checkpoint. All files are replaced through a rename, a crash leaves the last
+ * complete checkpoint behind.
+ *
+ * Checkpoint file: "C4CK", version (1 byte), split (1 byte), the root moves, the number of subproblems (8 bytes), then
+ * per subproblem its moves, lower bound, upper bound, exact (1 byte each) and nodes (8 bytes). Strings are a 4 byte length and the
+ * characters, numbers are stored in host byte order.
+ */
+class DistributedSolver
+{
+public:
+    /**
+     * Settings of a solve
+     */
+    struct Config
+    {
+        size_t workers = 4;                 // worker processes
+        int split = 4;                      // moves in the opening prefixes, at least 1
+        size_t ttEntries = size_t(1) << 22; // transposition table entries per worker
+        uint64_t budget = 0;                // node budget per subproblem, 0 for exact scores
+        int maxAttempts = 3;                // dispatches of a subproblem before the solve fails
+        bool verbose = false;               // report every solved subproblem on cerr
+        string checkpoint;                  // checkpoint file, empty for none; worker tables go to <checkpoint>.tt<n>
+        double checkpointSeconds = 60;      // time between two checkpoints
+        double heartbeatSeconds = 30;       // a busy worker silent for this long is killed and replaced, 0 to wait forever
+    };
+
+    static constexpr char MAGIC[4] = {'C', '4', 'C', 'K'};
+    static constexpr uint8_t VERSION = 2;
+
+    /**
+     * Position at the end of an opening prefix
+     */
+    struct Subproblem
+    {
+        string moves;                 // a line from the start position that reaches the position
+        int lower = Solver::MINSCORE; // bounds of the score from the view of the player to move, equal once solved
+        int upper = Solver::MAXSCORE;
+        bool exact = true;            // false if the node budget ran out
+        uint64_t nodes = 0;           // of all its searches
+        int attempts = 0;             // dispatches of the current search
+    };
+
+    /**
+     * Combined result of a solve
+     */
+    struct Result
+    {
+        int score = 0;
+        Column bestMove = Column::INVALID;
+        bool exact = true;
+        uint64_t nodes = 0;
+        size_t subproblems = 0;
+        size_t solved = 0;       // subproblems whose exact score was needed
+        size_t searches = 0;     // searches of subproblems finished by the workers
+        size_t merged = 0;       // prefixes that reached the position of an earlier prefix
+        size_t redispatched = 0; // searches sent again after their worker died
+        size_t resumed = 0;      // subproblems with bounds from an earlier run, read from the checkpoint
+    };
+
+    /**
+     * Constructor for the DistributedSolver class.
+     * @param config_ The settings.
+     */
+    explicit DistributedSolver(const Config &config_) : config(config_)
+    {
+        config.workers = max<size_t>(1, config.workers);
+        config.split = max(1, config.split);
+    }
+
+    /**
+     * Stop the workers.
+     */
+    ~DistributedSolver()
+    {
+        stopWorkers();
+    }
+
+    DistributedSolver(const DistributedSolver &) = delete;
+    DistributedSolver &operator=(const DistributedSolver &) = delete;
+
+    /**
+     * Solve a position.
+     * @param moves The moves from the start position, the first player starts.
+     * @return The score from the view of the player to move and the best move.
+     * @throws invalid_argument If the moves are illegal or the game is over.
+     * @throws runtime_error If a worker reports an error or a subproblem failed maxAttempts times.
+     */
+    Result solve(const string &moves)
+    {
+        Connect4Board board;
+        Player toMove = replay(moves, board);
+        if (board.full())
+        {
+            throw invalid_argument("Board full: " + moves);
+        }
+
+        subproblems.clear();
+        index.clear();
+        prefixes.clear();
+        root = moves;
+        merged = 0;
+        redispatched = 0;
+        searches = 0;
+        string line = moves;
+        expand(board, toMove, line, config.split, Column::INVALID);
+        size_t resumed = config.checkpoint.empty() ? 0 : resume();
+        int cells = Connect4Board::ROWS * Connect4Board::COLS;
+        int played = __builtin_popcountll(board.occupied());
+        int score = run(-(cells - played) / 2, (cells + 1 - played) / 2);
+
+        Result result;
+        vector<Search> needed;
+        result.score = search(0, score - 1, score + 1, needed, &result.bestMove).score;
+        for (const Subproblem &subproblem : subproblems)
+        {
+            result.exact = result.exact && subproblem.exact;
+            result.nodes += subproblem.nodes;
+            result.solved += subproblem.lower == subproblem.upper;
+        }
+        if (result.nodes == 0)
+        {
+            // the prefixes decided it, the position itself is the only node looked at, as with Solver
+            result.nodes = 1;
+        }
+        result.subproblems = subproblems.size();
+        result.searches = searches;
+        result.merged = merged;
+        result.redispatched = redispatched;
+        result.resumed = resumed;
+        return result;
+    }
+
+    /**
+     * Get the subproblems of the last solve.
+     * @return The subproblems, in the order they were found.
+     */
+    const vector<Subproblem> &getSubproblems() const
+    {
+        return subproblems;
+    }
+
+    /**
+     * Solve subproblems sent over a connection until the peer quits or disconnects; the loop of a worker.
+     * @param connection The connection to the coordinator.
+     * @param ttEntries The transposition table entries, the table is kept across subproblems.
+     * @param tableFile The file the table is loaded from and saved to, empty for none.
+     * @param tableSeconds The time between two saves of the table.
+     * @param progressSeconds The time between two progress lines while a subproblem is solved, 0 for none.
+     */
+    static void serveJobs(LocalSocket &connection, size_t ttEntries, const string &tableFile = "", double tableSeconds = 60,
+                          double progressSeconds = 0)
+    {
+        Solver solver(ttEntries);
+        pid_t saver = -1;
+        string job;
+        auto lastSave = chrono::steady_clock::now();
+        auto lastProgress = chrono::steady_clock::now();
+        auto checkpoint = [&]()
+        {
+            auto now = chrono::steady_clock::now();
+            if (!tableFile.empty() && chrono::duration<double>(now - lastSave).count() >= tableSeconds &&
+                saveInBackground(solver, tableFile, connection, saver))
+            {
+                lastSave = now;
+            }
+        };
+        auto progress = [&]()
+        {
+            checkpoint();
+            auto now = chrono::steady_clock::now();
+            if (progressSeconds > 0 && chrono::duration<double>(now - lastProgress).count() >= progressSeconds)
+            {
+                connection.writeLine(job + " progress " + to_string(solver.getNodes()));
+                lastProgress = now;
+            }
+        };
+        if (!tableFile.empty())
+        {
+            solver.loadTable(tableFile);
+        }
+        if (!tableFile.empty() || progressSeconds > 0)
+        {
+            solver.setProgress(progress);
+        }
+
+        string line;
+        while (connection.readLine(line))
+        {
+            stringstream in(line);
+            string command, moves;
+            uint64_t budget = 0;
+            int alpha = Solver::MINSCORE - 1;
+            int beta = Solver::MAXSCORE + 1;
+            job.clear();
+            in >> command >> job >> budget >> alpha >> beta >> moves;
+            if (command == "quit")
+            {
+                break;
+            }
+            if (command != "solve")
+            {
+                connection.writeLine(job + " error unknown command " + command);
+                continue;
+            }
+            try
+            {
+                Connect4Board board;
+                Player toMove = replay(moves, board);
+                lastProgress = chrono::steady_clock::now();
+                Solver::Result result = solver.solve(board, toMove, budget, alpha, beta);
+                connection.writeLine(job + " score " + to_string(result.score) + " exact " + to_string(result.exact ? 1 : 0) +
+                                     " nodes " + to_string(result.nodes));
+            }
+            catch (const exception &e)
+            {
+                connection.writeLine(job + " error " + e.what());
+            }
+            checkpoint();
+        }
+
+        if (!tableFile.empty())
+        {
+            // the last table, once a background save is done with the file
+            int status = 0;
+            if (saver > 0)
+            {
+                ::waitpid(saver, &status, 0);
+            }
+            solver.saveTable(tableFile);
+        }
+    }
+
+private:
+    /**
+     * Worker process and the search it works on
+     */
+    struct Worker
+    {
+        pid_t pid = -1;
+        unique_ptr<LocalSocket> connection;
+        long job = -1;                              // the subproblem
+        int alpha = 0;                              // the window of the search
+        int beta = 0;
+        chrono::steady_clock::time_point lastHeard; // dispatch or the last line received
+    };
+
+    /**
+     * Position within the opening prefixes
+     */
+    struct Prefix
+    {
+        Column move = Column::INVALID; // the move that reached it
+        bool decided = false;          // the game is over or the player to move wins right away
+        int score = 0;                 // the score if decided
+        Column win = Column::INVALID;  // the first winning move in center-first order
+        long subproblem = -1;          // the subproblem at the end of a prefix
+        vector<size_t> children;       // the positions after each move, in center-first order
+    };
+
+    /**
+     * Search of a subproblem the walk over the prefixes waits for
+     */
+    struct Search
+    {
+        size_t subproblem = 0;
+        int alpha = 0;
+        int beta = 0;
+    };
+
+    /**
+     * Score of a position in the walk, pending while it waits for searches
+     */
+    struct Outcome
+    {
+        bool pending = false;
+        int score = 0;
+    };
+
+    Config config;
+    string root;
+    vector<Subproblem> subproblems;
+    unordered_map<uint64_t, size_t> index; // canonical key -> subproblem
+    vector<Prefix> prefixes;               // the root first
+    vector<Worker> workers;
+    size_t merged = 0;
+    size_t redispatched = 0;
+    size_t searches = 0;
+    chrono::steady_clock::time_point lastCheckpoint;
+
+    /**
+     * Play a move string from the start position.
+     * @return The player to move.
+     */
+    static Player replay(const string &moves, Connect4Board &board)
+    {
+        Player toMove = Player::USER;
+        for (char move : moves)
+        {
+            Column column = Connect4Board::charToColumn(move);
+            if (column == Column::INVALID || column >= Connect4Board::COLS || !board.columnHasSpace(column))
+            {
+                throw invalid_argument(string("Illegal move ") + move + " in " + moves);
+            }
+            if (board.dropDisc(column, toMove))
+            {
+                throw invalid_argument("Game over after " + moves);
+            }
+            toMove = board.getOponent(toMove);
+        }
+        return toMove;
+    }
+
+    /**
+     * Get the i-th column in center-first order, the order Solver tries moves in.
+     */
+    static Column centerFirst(int i)
+    {
+        constexpr int COLS = Connect4Board::COLS;
+        return static_cast<Column>(COLS / 2 + (1 - 2 * (i % 2)) * (i + 1) / 2);
+    }
+
+    /**
+     * Add a position and the opening prefixes below it to prefixes, the positions at their end become subproblems.
+     * @param line The moves that reached the position, restored on return.
+     * @param depth The moves left in the prefix.
+     * @param move The move that reached the position.
+     * @return The place of the position in prefixes.
+     */
+    size_t expand(Connect4Board &board, Player toMove, string &line, int depth, Column move)
+    {
+        constexpr int COLS = Connect4Board::COLS;
+        constexpr int CELLS = Connect4Board::ROWS * COLS;
+        size_t at = prefixes.size();
+        prefixes.emplace_back();
+        prefixes[at].move = move;
+
+        uint32_t wins = board.winningColumns(toMove);
+        if (wins || board.full())
+        {
+            prefixes[at].decided = true;
+            for (int i = 0; i < COLS && wins; ++i)
+            {
+                if (wins & (1u << centerFirst(i)))
+                {
+                    prefixes[at].score = (CELLS + 1 - __builtin_popcountll(board.occupied())) / 2;
+                    prefixes[at].win = centerFirst(i);
+                    break;
+                }
+            }
+            return at;
+        }
+
+        if (depth == 0)
+        {
+            auto inserted = index.emplace(board.canonicalKey(), subproblems.size());
+            if (inserted.second)
+            {
+                Subproblem subproblem;
+                subproblem.moves = line;
+                subproblems.push_back(subproblem);
+            }
+            else
+            {
+                ++merged;
+            }
+            prefixes[at].subproblem = static_cast<long>(inserted.first->second);
+            return at;
+        }
+
+        for (int i = 0; i < COLS; ++i)
+        {
+            Column column = centerFirst(i);
+            if (!board.columnHasSpace(column))
+            {
+                continue;
+            }
+            board.dropDisc(column, toMove);
+            line.push_back(Connect4Board::colToChar(column));
+            size_t child = expand(board, board.getOponent(toMove), line, depth - 1, column);
+            line.pop_back();
+            board.removeDisc(column);
+            prefixes[at].children.push_back(child);
+        }
+        return at;
+    }
+
+    /**
+     * Alpha-beta over the opening prefixes on the bounds of the subproblems found so far. The first move gets the
+     * window, the others a null window on the best score so far and the window again if they beat it; they wait for
+     * the score of the first move.
+     * @param at The position in prefixes.
+     * @param needed Receives the searches the walk waits for, in the order it reached them.
+     * @param bestMove Receives the best move if not nullptr, the first of equal moves in center-first order.
+     * @return The score from the view of the player to move, exact within (alpha, beta), otherwise a bound on the side
+     *         of the window it lies on; or pending.
+     */
+    Outcome search(size_t at, int alpha, int beta, vector<Search> &needed, Column *bestMove = nullptr) const
+    {
+        const Prefix &prefix = prefixes[at];
+        if (prefix.decided)
+        {
+            if (bestMove)
+            {
+                *bestMove = prefix.win;
+            }
+            return {false, prefix.score};
+        }
+
+        if (prefix.subproblem >= 0)
+        {
+            size_t job = static_cast<size_t>(prefix.subproblem);
+            const Subproblem &subproblem = subproblems[job];
+            if (subproblem.upper <= alpha)
+            {
+                return {false, subproblem.upper};
+            }
+            if (subproblem.lower >= beta || subproblem.lower == subproblem.upper)
+            {
+                return {false, subproblem.lower};
+            }
+            // the search only has to decide what the bounds leave open
+            needed.push_back({job, max(alpha, subproblem.lower - 1), min(beta, subproblem.upper + 1)});
+            return {true, 0};
+        }
+
+        int best = numeric_limits<int>::min();
+        bool pending = false;
+        for (size_t i = 0; i < prefix.children.size() && alpha < beta; ++i)
+        {
+            size_t child = prefix.children[i];
+            Outcome outcome;
+            if (i == 0)
+            {
+                outcome = search(child, -beta, -alpha, needed);
+                if (outcome.pending)
+                {
+                    return outcome;
+                }
+            }
+            else
+            {
+                outcome = search(child, -alpha - 1, -alpha, needed);
+                if (!outcome.pending && -outcome.score > alpha && -outcome.score < beta)
+                {
+                    // beats the best so far, its score is needed
+                    int lower = -outcome.score;
+                    outcome = search(child, -beta, -alpha, needed);
+                    if (outcome.pending)
+                    {
+                        alpha = lower;
+                    }
+                }
+                if (outcome.pending)
+                {
+                    pending = true;
+                    continue;
+                }
+            }
+            int score = -outcome.score;
+            if (score > best)
+            {
+                best = score;
+                if (bestMove)
+                {
+                    *bestMove = prefixes[child].move;
+                }
+            }
+            alpha = max(alpha, score);
+        }
+        return {pending && best < beta, best};
+    }
+
+    /**
+     * Find the score of the root through null-window walks, as Solver::evaluate does, and settle the walk that finds
+     * the best move.
+     * @param min The lowest score the root can have.
+     * @param max The highest score the root can have.
+     * @return The score of the root.
+     */
+    int run(int min, int max)
+    {
+        lastCheckpoint = chrono::steady_clock::now();
+        while (min < max)
+        {
+            int med = min + (max - min) / 2;
+            if (med <= 0 && min / 2 < med)
+            {
+                med = min / 2;
+            }
+            else if (med >= 0 && max / 2 > med)
+            {
+                med = max / 2;
+            }
+            int r = settle(med, med + 1);
+            if (r <= med)
+            {
+                max = r;
+            }
+            else
+            {
+                min = r;
+            }
+        }
+        settle(min - 1, min + 1);
+
+        // searches still running cannot change the result anymore
+        for (Worker &worker : workers)
+        {
+            if (worker.job >= 0)
+            {
+                ::kill(worker.pid, SIGKILL);
+                worker.job = -1;
+                replace(worker);
+            }
+        }
+        if (!config.checkpoint.empty())
+        {
+            saveCheckpoint();
+        }
+        return min;
+    }
+
+    /**
+     * Search subproblems on the workers until a walk over the prefixes needs no more searches.
+     * @return The score of the root, for the window (alpha, beta).
+     */
+    int settle(int alpha, int beta)
+    {
+        while (true)
+        {
+            vector<Search> needed;
+            Outcome outcome = search(0, alpha, beta, needed);
+            if (!outcome.pending)
+            {
+                return outcome.score;
+            }
+            for (const Search &next : needed)
+            {
+                Worker *worker = idleWorker(next.subproblem);
+                if (worker)
+                {
+                    dispatch(*worker, next);
+                }
+            }
+            wait();
+        }
+    }
+
+    /**
+     * Get a worker for a search, starting one if fewer than configured run.
+     * @param job The subproblem of the search.
+     * @return The worker, nullptr if the subproblem is searched already or all workers are busy.
+     */
+    Worker *idleWorker(size_t job)
+    {
+        Worker *idle = nullptr;
+        for (Worker &worker : workers)
+        {
+            if (worker.job == static_cast<long>(job))
+            {
+                return nullptr;
+            }
+            if (worker.job < 0 && !idle)
+            {
+                idle = &worker;
+            }
+        }
+        if (!idle && workers.size() < config.workers)
+        {
+            workers.push_back(spawn(workers.size()));
+            idle = &workers.back();
+        }
+        return idle;
+    }
+
+    /**
+     * Wait for replies of the busy workers and take in their scores; kill workers that stay silent.
+     */
+    void wait()
+    {
+        vector<pollfd> fds;
+        for (const Worker &worker : workers)
+        {
+            if (worker.job >= 0)
+            {
+                fds.push_back({worker.connection->descriptor(), POLLIN, 0});
+            }
+        }
+        if (fds.empty())
+        {
+            return;
+        }
+        if (::poll(fds.data(), fds.size(), pollTimeout()) < 0)
+        {
+            if (errno == EINTR)
+            {
+                return;
+            }
+            throw runtime_error(string("Cannot wait for workers: ") + strerror(errno));
+        }
+
+        for (Worker &worker : workers)
+        {
+            bool ready = false;
+            for (const pollfd &fd : fds)
+            {
+                ready = ready || (fd.fd == worker.connection->descriptor() && fd.revents);
+            }
+            if (worker.job < 0)
+            {
+                continue;
+            }
+            if (!ready)
+            {
+                if (config.heartbeatSeconds > 0 &&
+                    chrono::duration<double>(chrono::steady_clock::now() - worker.lastHeard).count() >= config.heartbeatSeconds)
+                {
+                    if (config.verbose)
+                    {
+                        cerr << "worker " << worker.pid << " silent for " << config.heartbeatSeconds << " s, killed" << endl;
+                    }
+                    ::kill(worker.pid, SIGKILL);
+                    replace(worker);
+                }
+                continue;
+            }
+            // progress lines and the reply may arrive together, poll does not see what is already buffered
+            do
+            {
+                string reply;
+                if (!worker.connection->readLine(reply))
+                {
+                    replace(worker);
+                    break;
+                }
+                worker.lastHeard = chrono::steady_clock::now();
+                if (isProgress(reply))
+                {
+                    continue;
+                }
+                complete(worker, reply);
+                if (!config.checkpoint.empty() &&
+                    chrono::duration<double>(chrono::steady_clock::now() - lastCheckpoint).count() >= config.checkpointSeconds)
+                {
+                    saveCheckpoint();
+                }
+            } while (worker.job >= 0 && worker.connection->hasLine());
+        }
+    }
+
+    /**
+     * Get the time poll may wait, until the first busy worker has been silent for heartbeatSeconds.
+     * @return The timeout in milliseconds, -1 to wait forever.
+     */
+    int pollTimeout() const
+    {
+        if (config.heartbeatSeconds <= 0)
+        {
+            return -1;
+        }
+        auto now = chrono::steady_clock::now();
+        double wait = config.heartbeatSeconds;
+        for (const Worker &worker : workers)
+        {
+            if (worker.job >= 0)
+            {
+                wait = min(wait, config.heartbeatSeconds - chrono::duration<double>(now - worker.lastHeard).count());
+            }
+        }
+        // rounded up, so the worker is due when poll returns
+        return static_cast<int>(max(0.0, wait) * 1000) + 1;
+    }
+
+    /**
+     * Check if a worker's line only reports that it is still solving.
+     */
+    static bool isProgress(const string &reply)
+    {
+        stringstream in(reply);
+        string job, word;
+        return in >> job >> word && word == "progress";
+    }
+
+    /**
+     * Send a search to an idle worker.
+     */
+    void dispatch(Worker &worker, const Search &next)
+    {
+        Subproblem &subproblem = subproblems[next.subproblem];
+        if (subproblem.attempts >= config.maxAttempts)
+        {
+            throw runtime_error("Subproblem " + subproblem.moves + " failed " + to_string(subproblem.attempts) + " times");
+        }
+        ++subproblem.attempts;
+        worker.job = static_cast<long>(next.subproblem);
+        worker.alpha = next.alpha;
+        worker.beta = next.beta;
+        worker.lastHeard = chrono::steady_clock::now();
+        if (!worker.connection->writeLine("solve " + to_string(next.subproblem) + " " + to_string(config.budget) + " " +
+                                          to_string(next.alpha) + " " + to_string(next.beta) + " " + subproblem.moves))
+        {
+            replace(worker);
+        }
+    }
+
+    /**
+     * Narrow the bounds of a subproblem by the score a worker replied for its search.
+     */
+    void complete(Worker &worker, const string &reply)
+    {
+        stringstream in(reply);
+        long job = -1;
+        string word;
+        int score = 0;
+        int exact = 0;
+        uint64_t nodes = 0;
+        in >> job >> word;
+        if (job != worker.job || word != "score" || !(in >> score >> word >> exact >> word >> nodes))
+        {
+            throw runtime_error("Worker failed: " + reply);
+        }
+        Subproblem &subproblem = subproblems[static_cast<size_t>(job)];
+        if (!exact)
+        {
+            // the budget ran out, the guess stands for the score
+            subproblem.lower = subproblem.upper = score;
+            subproblem.exact = false;
+        }
+        else if (score <= worker.alpha)
+        {
+            subproblem.upper = min(subproblem.upper, score);
+        }
+        else if (score >= worker.beta)
+        {
+            subproblem.lower = max(subproblem.lower, score);
+        }
+        else
+        {
+            subproblem.lower = subproblem.upper = score;
+        }
+        subproblem.nodes += nodes;
+        subproblem.attempts = 0;
+        ++searches;
+        worker.job = -1;
+        if (config.verbose)
+        {
+            cerr << "searched " << subproblem.moves << " window (" << worker.alpha << ", " << worker.beta << ") score " << score
+                 << " nodes " << nodes << endl;
+        }
+    }
+
+    /**
+     * Reap a dead worker and start a new worker in its place, the next walk sends its search again.
+     */
+    void replace(Worker &worker)
+    {
+        int status = 0;
+        worker.connection.reset();
+        ::waitpid(worker.pid, &status, 0);
+        if (worker.job >= 0)
+        {
+            ++redispatched;
+            if (config.verbose)
+            {
+                cerr << "worker " << worker.pid << " died, searching " << subproblems[static_cast<size_t>(worker.job)].moves << " again" << endl;
+            }
+        }
+        worker = spawn(static_cast<size_t>(&worker - workers.data()));
+    }
+
+    /**
+     * Fork a worker process.
+     * @param slot The place of the worker, it names the worker's table file.
+     */
+    Worker spawn(size_t slot)
+    {
+        auto ends = LocalSocket::socketPair();
+        cout.flush();
+        cerr.flush();
+        pid_t pid = ::fork();
+        if (pid < 0)
+        {
+            throw runtime_error(string("Cannot start worker: ") + strerror(errno));
+        }
+        if (pid == 0)
+        {
+            // the child keeps only its own end, and leaves without running the coordinator's destructors
+            ends.first.reset();
+            for (Worker &other : workers)
+            {
+                if (other.connection)
+                {
+                    other.connection->close();
+                }
+            }
+            int status = 0;
+            try
+            {
+                serveJobs(*ends.second, config.ttEntries, config.checkpoint.empty() ? "" : config.checkpoint + ".tt" + to_string(slot),
+                          config.checkpointSeconds, config.heartbeatSeconds / 4);
+            }
+            catch (const exception &e)
+            {
+                cerr << "worker: " << e.what() << endl;
+                status = 1;
+            }
+            ::_exit(status);
+        }
+        Worker worker;
+        worker.pid = pid;
+        worker.connection = std::move(ends.first);
+        return worker;
+    }
+
+    /**
+     * Write the checkpoint file: the root and the bounds of all subproblems.
+     */
+    void saveCheckpoint()
+    {
+        string temporary = config.checkpoint + ".tmp";
+        ofstream ofs(temporary, ios::binary | ios::trunc);
+        ofs.write(MAGIC, sizeof(MAGIC));
+        writeValue(ofs, VERSION);
+        writeValue(ofs, static_cast<uint8_t>(config.split));
+        writeString(ofs, root);
+        writeValue(ofs, static_cast<uint64_t>(subproblems.size()));
+        for (const Subproblem &subproblem : subproblems)
+        {
+            writeString(ofs, subproblem.moves);
+            writeValue(ofs, static_cast<int8_t>(subproblem.lower));
+            writeValue(ofs, static_cast<int8_t>(subproblem.upper));
+            writeValue(ofs, static_cast<uint8_t>(subproblem.exact));
+            writeValue(ofs, subproblem.nodes);
+        }
+        ofs.close();
+        if (ofs.fail() || rename(temporary.c_str(), config.checkpoint.c_str()) != 0)
+        {
+            remove(temporary.c_str());
+            throw runtime_error("Cannot write checkpoint " + config.checkpoint);
+        }
+        lastCheckpoint = chrono::steady_clock::now();
+    }
+
+    /**
+     * Take over the bounds of the subproblems from the checkpoint file, if it is for the same root and split.
+     * @return The number of subproblems with a bound taken over.
+     */
+    size_t resume()
+    {
+        ifstream ifs(config.checkpoint, ios::binary);
+        char magic[sizeof(MAGIC)];
+        uint8_t version = 0;
+        uint8_t split = 0;
+        string moves;
+        uint64_t count = 0;
+        if (!ifs.read(magic, sizeof(magic)) || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || !readValue(ifs, version) ||
+            version != VERSION || !readValue(ifs, split) || split != config.split || !readString(ifs, moves) || moves != root ||
+            !readValue(ifs, count))
+        {
+            return 0;
+        }
+
+        unordered_map<string, size_t> byMoves;
+        for (size_t i = 0; i < subproblems.size(); ++i)
+        {
+            byMoves.emplace(subproblems[i].moves, i);
+        }
+        size_t resumed = 0;
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            int8_t lower = 0;
+            int8_t upper = 0;
+            uint8_t exact = 0;
+            uint64_t nodes = 0;
+            if (!readString(ifs, moves) || !readValue(ifs, lower) || !readValue(ifs, upper) || !readValue(ifs, exact) ||
+                !readValue(ifs, nodes))
+            {
+                break;
+            }
+            auto it = byMoves.find(moves);
+            if ((lower == Solver::MINSCORE && upper == Solver::MAXSCORE) || it == byMoves.end())
+            {
+                continue;
+            }
+            Subproblem &subproblem = subproblems[it->second];
+            subproblem.lower = lower;
+            subproblem.upper = upper;
+            subproblem.exact = exact != 0;
+            subproblem.nodes = nodes;
+            ++resumed;
+        }
+        if (config.verbose)
+        {
+            cerr << "resumed " << resumed << " of " << subproblems.size() << " subproblems from " << config.checkpoint << endl;
+        }
+        return resumed;
+    }
+
+    template <typename T>
+    static void writeValue(ostream &os, T value)
+    {
+        os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    static bool readValue(istream &is, T &value)
+    {
+        return static_cast<bool>(is.read(reinterpret_cast<char *>(&value), sizeof(value)));
+    }
+
+    static void writeString(ostream &os, const string &value)
+    {
+        writeValue(os, static_cast<uint32_t>(value.size()));
+        os.write(value.data(), static_cast<streamsize>(value.size()));
+    }
+
+    static bool readString(istream &is, string &value)
+    {
+        uint32_t size = 0;
+        if (!readValue(is, size) || size > 4096)
+        {
+            return false;
+        }
+        value.resize(size);
+        return static_cast<bool>(is.read(&value[0], size));
+    }
+
+    /**
+     * Save a worker's table from a forked child, the worker goes on right away.
+     * @param saver The child of the last save, a new save only starts once it is done.
+     * @return True if a save was started.
+     */
+    static bool saveInBackground(const Solver &solver, const string &tableFile, LocalSocket &connection, pid_t &saver)
+    {
+        int status = 0;
+        if (saver > 0 && ::waitpid(saver, &status, WNOHANG) == 0)
+        {
+            return false;
+        }
+        saver = ::fork();
+        if (saver == 0)
+        {
+            // the child writes its own file and moves it in place, a replaced worker's child may still be writing
+            connection.close();
+            string own = tableFile + "." + to_string(::getpid());
+            int code = 0;
+            try
+            {
+                solver.saveTable(own);
+                code = rename(own.c_str(), tableFile.c_str()) == 0 ? 0 : 1;
+            }
+            catch (const exception &)
+            {
+                code = 1;
+            }
+            ::_exit(code);
+        }
+        return saver > 0;
+    }
+
+    /**
+     * Ask idle workers to quit, stop busy ones, and reap them all.
+     */
+    void stopWorkers()
+    {
+        for (Worker &worker : workers)
+        {
+            if (worker.job >= 0 || !worker.connection->writeLine("quit"))
+            {
+                ::kill(worker.pid, SIGKILL);
+            }
+            worker.connection.reset();
+        }
+        for (Worker &worker : workers)
+        {
+            int status = 0;
+            ::waitpid(worker.pid, &status, 0);
+        }
+        workers.clear();
+    }
+};
+
+#endif // DISTRIBUTED_SOLVER_H
@@ -0,0 +1,467 @@
+#ifndef ENGINE_PROTOCOL_H
+#define ENGINE_PROTOCOL_H
+
+#include "include.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <memory>
+
+/**
+ * Line protocol for driving the engine from another program (GUI, test harness, process pool).
+ * One command per line, every reply is a single line of space separated key/value pairs:
+ *
+ *   isready                                  -> readyok
+ *   setoption name <depth|level|pruning|movetime> value <v>
+ *   position [startpos] [moves] <columns>    columns as letters, e.g. "position startpos moves DCD" or "position DCD"
+ *   go [depth <d>] [movetime <ms>]           -> info depth <d> nodes <n> time <ms>   (after every deepening step that grew the tree)
+ *                                               bestmove <column|none> score <s> depth <d> nodes <n> time <ms>
+ *   stop                                     ends a running go, an unfinished deepening step is abandoned
+ *   analyze                                  -> info move <column> score <s> win <0|1> threat <0|1> minor <0|1> pressure <p> options <w>
+ *                                               bestmove ...
+ *   quit
+ *
+ * Malformed commands reply "error <message>". Scores are from the view of the side to move, a winning move scores SCOREWIN.
+ * The bestmove score is backed up from the depth it reports (see GameTheorie::backUp), plies the tree already holds are not
+ * searched again. With pruning 1 the side to move keeps only its preferred move at each of its turns, so the score is
+ * not a search result: SCOREWIN is a proven win, -SCOREWIN only means the opponent wins right after the move, anything
+ * else is the heuristic of the preferred line. With pruning 0 every move is searched. After a go the tree is cut back to the depth option, so a deep search does not stay in memory.
+ * The side to move is searched as Player::BOT. The game tree stays warm between commands as long as the same colour is
+ * searched and the new position extends the previous one or steps back at most TAKEBACKS moves from it; otherwise it is rebuilt.
+ */
+class EngineProtocol
+{
+public:
+    /**
+     * Score of a move that wins immediately
+     */
+    static constexpr int SCOREWIN = GameTheorie::SCOREWIN;
+    static constexpr size_t GROWSLICE = 4096; // nodes visited between checks for stop and the time limit
+    static constexpr size_t TAKEBACKS = 16;   // previous roots kept, so stepping back through a line reuses the tree
+
+    /**
+     * Constructor for the EngineProtocol class.
+     * @param out_ The stream replies are written to.
+     */
+    explicit EngineProtocol(ostream &out_) : out(out_)
+    {
+    }
+
+    ~EngineProtocol()
+    {
+        stopRequested = true;
+        worker.wait();
+    }
+
+    /**
+     * Read and execute commands until quit or end of input.
+     * @param in The stream commands are read from.
+     */
+    void run(istream &in)
+    {
+        string line;
+        while (getline(in, line) && execute(line))
+        {
+        }
+        stopRequested = true;
+        worker.wait();
+    }
+
+    /**
+     * Execute a single command, go returns immediately and searches in the background.
+     * @param line The command.
+     * @return False if the command was quit, true otherwise.
+     */
+    bool execute(const string &line)
+    {
+        stringstream ss(line);
+        string command;
+        if (!(ss >> command))
+        {
+            return true;
+        }
+
+        if (command == "quit")
+        {
+            return false;
+        }
+        if (command == "isready")
+        {
+            reply("readyok");
+            return true;
+        }
+        if (command == "stop")
+        {
+            stopRequested = true;
+            return true;
+        }
+
+        // every other command waits for a running search
+        finishSearch();
+
+        if (command == "position")
+        {
+            position(ss);
+        }
+        else if (command == "setoption")
+        {
+            setOption(ss);
+        }
+        else if (command == "go")
+        {
+            go(ss);
+        }
+        else if (command == "analyze")
+        {
+            worker.submit([this]
+                          { analyze(); });
+            finishSearch();
+        }
+        else
+        {
+            reply("error unknown command " + command);
+        }
+        return true;
+    }
+
+private:
+    ostream &out;
+    mutex outLock;
+
+    /**
+     * Single worker, so the thread-local metrics cache and node pool stay warm across commands
+     */
+    ThreadPool worker{1};
+    atomic<bool> stopRequested{false};
+
+    // options
+    int DEPTH = 5;
+    Level LEVEL = Level::HARD;
+    bool ADVANCEDPRUNING = true;
+    int MOVETIME = 0;
+
+    // requested position
+    string target;
+    bool gameOver = false;
+
+    // engine state, only touched by the worker
+    unique_ptr<Connect4Board> board;
+    unique_ptr<GameTheorie> brain;
+    string played;
+    bool dirty = true;
+
+    void reply(const string &message)
+    {
+        lock_guard<mutex> guard(outLock);
+        out << message << endl;
+    }
+
+    void finishSearch()
+    {
+        try
+        {
+            worker.wait();
+        }
+        catch (const exception &e)
+        {
+            reply(string("error ") + e.what());
+        }
+    }
+
+    /**
+     * Parse and validate a position, the engine follows it on the next go or analyze.
+     */
+    void position(stringstream &ss)
+    {
+        string moves;
+        string token;
+        while (ss >> token)
+        {
+            if (token != "startpos" && token != "moves")
+            {
+                moves += token;
+            }
+        }
+
+        Connect4Board scratch;
+        Player player = Player::USER;
+        bool over = false;
+        for (size_t i = 0; i < moves.size(); ++i)
+        {
+            Column column = Column::INVALID;
+            try
+            {
+                column = Connect4Board::charToColumn(moves[i]);
+            }
+            catch (const invalid_argument &)
+            {
+            }
+            if (over || column == Column::INVALID || column >= Connect4Board::COLS || scratch.findRow(column) < 0)
+            {
+                reply(string("error illegal move ") + moves[i] + " at " + to_string(i + 1));
+                return;
+            }
+            over = scratch.dropDisc(column, player) || scratch.full();
+            player = scratch.getOponent(player);
+        }
+        for (char &c : moves)
+        {
+            c = static_cast<char>(toupper(c));
+        }
+        target = moves;
+        gameOver = over;
+    }
+
+    void setOption(stringstream &ss)
+    {
+        string token;
+        string name;
+        string value;
+        while (ss >> token)
+        {
+            if (token == "name")
+            {
+                ss >> name;
+            }
+            else if (token == "value")
+            {
+                ss >> value;
+            }
+        }
+
+        try
+        {
+            if (name == "depth")
+            {
+                DEPTH = max(1, stoi(value));
+                if (brain)
+                {
+                    brain->getTree()->DEPTH = DEPTH;
+                }
+            }
+            else if (name == "movetime")
+            {
+                MOVETIME = max(0, stoi(value));
+            }
+            else if (name == "pruning")
+            {
+                ADVANCEDPRUNING = value == "1" || value == "true";
+                dirty = true;
+            }
+            else if (name == "level")
+            {
+                if (value == "easy")
+                {
+                    LEVEL = Level::EASY;
+                }
+                else if (value == "medium")
+                {
+                    LEVEL = Level::MEDIUM;
+                }
+                else if (value == "hard")
+                {
+                    LEVEL = Level::HARD;
+                }
+                else
+                {
+                    reply("error unknown level " + value);
+                }
+            }
+            else
+            {
+                reply("error unknown option " + name);
+            }
+        }
+        catch (const exception &)
+        {
+            reply("error invalid value " + value + " for " + name);
+        }
+    }
+
+    void go(stringstream &ss)
+    {
+        int depth = 0;
+        int movetime = MOVETIME;
+        string token;
+        while (ss >> token)
+        {
+            if (token == "depth" && ss >> depth)
+            {
+                movetime = 0;
+            }
+            else if (token == "movetime" && ss >> movetime)
+            {
+                depth = 0;
+            }
+        }
+        if (depth <= 0 && movetime <= 0)
+        {
+            depth = DEPTH;
+        }
+
+        stopRequested = false;
+        worker.submit([this, depth, movetime]
+                      { search(depth, movetime); });
+    }
+
+    /**
+     * Bring the engine to the requested position, reusing the tree when the position shares moves with the previous one.
+     * Moves after the shared ones are taken back while the tree kept their previous roots, otherwise the tree is rebuilt.
+     */
+    void sync()
+    {
+        Player starting = (target.size() % 2 == 0) ? Player::BOT : Player::USER;
+        size_t common = 0;
+        if (brain && !dirty && brain->getStartingPlayer() == starting)
+        {
+            while (common < played.size() && common < target.size() && played[common] == target[common])
+            {
+                ++common;
+            }
+        }
+        bool reuse = brain && !dirty && brain->getStartingPlayer() == starting &&
+                     played.size() - common <= brain->getTree()->historySize();
+        if (!reuse)
+        {
+            brain.reset();
+            board = make_unique<Connect4Board>();
+            brain = make_unique<GameTheorie>(*board, starting, DEPTH, LEVEL, ADVANCEDPRUNING, false);
+            brain->setTakebacks(TAKEBACKS);
+            played.clear();
+            dirty = false;
+        }
+        while (reuse && played.size() > common)
+        {
+            brain->undoMove();
+            played.pop_back();
+        }
+
+        for (size_t i = played.size(); i < target.size(); ++i)
+        {
+            Player player = (i % 2 == 0) ? starting : board->getOponent(starting);
+            brain->playMove(Connect4Board::charToColumn(target[i]), player);
+        }
+        played = target;
+    }
+
+    /**
+     * Score of a move for the side to move.
+     */
+    int score(Column column)
+    {
+        TileMetrics metrics = Metrics::generateMetricsForTile(*board, Player::BOT, board->findRow(column), column);
+        return metrics.winningMove ? SCOREWIN : brain->moveScore(metrics);
+    }
+
+    /**
+     * Reply the move with the best score backed up from a depth, the move of the level wins ties.
+     */
+    void bestMove(int depth, uint64_t nodes, double ms)
+    {
+        if (gameOver)
+        {
+            reply("bestmove none score 0 depth 0 nodes 0 time 0");
+            return;
+        }
+        Column column = brain->getBestMove(LEVEL);
+        int best = score(column);
+        GameTheorie::ScoredMoves scores = brain->backUp(depth);
+        for (const GameTheorie::ScoredMove &scored : scores)
+        {
+            if (scored.move == column)
+            {
+                best = scored.score;
+            }
+        }
+        for (const GameTheorie::ScoredMove &scored : scores)
+        {
+            if (scored.score > best)
+            {
+                best = scored.score;
+                column = scored.move;
+            }
+        }
+        reply(string("bestmove ") + Connect4Board::colToChar(column) + " score " + to_string(best) +
+              " depth " + to_string(depth) + " nodes " + to_string(nodes) + " time " + to_string(static_cast<int64_t>(ms)));
+    }
+
+    /**
+     * Iterative deepening, stops at the depth limit, the time limit or a stop command.
+     * Depths the tree is already grown to are reached without a step. A step is not started when it is unlikely to
+     * finish within the time limit, a running step is grown in slices and abandoned when the limit passes or a stop
+     * arrives. The tree is cut back to DEPTH plies once the best move is found.
+     */
+    void search(int maxDepth, int movetime)
+    {
+        auto start = chrono::steady_clock::now();
+        uint64_t nodes = SearchStats::snapshot().nodesCreated;
+        sync();
+
+        int remaining = Connect4Board::ROWS * Connect4Board::COLS - static_cast<int>(target.size());
+        int limit = maxDepth > 0 ? min(maxDepth, remaining) : remaining;
+        int reached = gameOver ? 0 : min(limit, brain->getTree()->grownDepth());
+        double lastStep = 0.0;
+
+        for (int depth = reached + 1; depth <= limit && !gameOver && !stopRequested; ++depth)
+        {
+            double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            if (movetime > 0 && reached > 0 && elapsed + lastStep * 4 > movetime)
+            {
+                break;
+            }
+
+            auto stepStart = chrono::steady_clock::now();
+            Tree *tree = brain->getTree();
+            tree->startGrow(*board, depth);
+            while (!tree->growStep(GROWSLICE))
+            {
+                elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+                if (stopRequested || (movetime > 0 && elapsed > movetime))
+                {
+                    tree->cancelGrow();
+                    break;
+                }
+            }
+            if (tree->growing() || stopRequested)
+            {
+                break;
+            }
+            lastStep = chrono::duration<double, milli>(chrono::steady_clock::now() - stepStart).count();
+            reached = depth;
+
+            elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            reply("info depth " + to_string(depth) + " nodes " + to_string(SearchStats::snapshot().nodesCreated - nodes) +
+                  " time " + to_string(static_cast<int64_t>(elapsed)));
+        }
+
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        bestMove(reached, SearchStats::snapshot().nodesCreated - nodes, ms);
+        brain->getTree()->trim(DEPTH);
+    }
+
+    void analyze()
+    {
+        auto start = chrono::steady_clock::now();
+        uint64_t nodes = SearchStats::snapshot().nodesCreated;
+        sync();
+
+        if (!gameOver)
+        {
+            for (Column column : board->getPossibleMoves())
+            {
+                TileMetrics m = Metrics::generateMetricsForTile(*board, Player::BOT, board->findRow(column), column);
+                reply(string("info move ") + Connect4Board::colToChar(column) +
+                      " score " + to_string(m.winningMove ? SCOREWIN : brain->moveScore(m)) +
+                      " win " + to_string(m.winningMove) +
+                      " threat " + to_string(m.immediateThreat) +
+                      " minor " + to_string(m.minorThreat) +
+                      " pressure " + to_string(m.pressure) +
+                      " options " + to_string(m.winOptions));
+            }
+        }
+
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        bestMove(brain->getTree()->DEPTH, SearchStats::snapshot().nodesCreated - nodes, ms);
+    }
+};
+
+#endif // ENGINE_PROTOCOL_H
@@ -0,0 +1,509 @@
+#ifndef GAME_LOG_H
+#define GAME_LOG_H
+
+#include "include.h"
+#include <cstring>
+#include <filesystem>
+
+/**
+ * Compact append-only binary log of finished games on the classic board.
+ *
+ * Layout (little endian):
+ *   file header   "C4GL", version, rows, columns, bits per move                      8 bytes
+ *   game records  first player, level, result, move count, then the columns packed  4 + ceil(moves * bits / 8) bytes
+ *                 LSB first with bits per move each (3 for 7 columns)
+ *   index footer  offset of every game record (uint64), game count (uint64), offset of the index (uint64), "C4GLIDX"
+ *
+ * The footer is written when the writer is closed and stripped again when the file is reopened for appending.
+ * Records are self-delimiting, so a log without footer (the writer did not close) is still readable by scanning.
+ */
+class GameLog
+{
+public:
+    static constexpr int ROWS = Connect4Board::ROWS;
+    static constexpr int COLS = Connect4Board::COLS;
+
+    /**
+     * Bits needed to store a column
+     */
+    static constexpr int BITS = COLS <= 2 ? 1 : (COLS <= 4 ? 2 : (COLS <= 8 ? 3 : 4));
+    static_assert(ROWS * COLS <= 255, "the move count is stored in a byte");
+
+    static constexpr char MAGIC[4] = {'C', '4', 'G', 'L'};
+    static constexpr char INDEXMAGIC[8] = {'C', '4', 'G', 'L', 'I', 'D', 'X', '\0'};
+    static constexpr uint8_t VERSION = 1;
+    static constexpr size_t HEADERSIZE = 8;
+    static constexpr size_t RECORDHEADERSIZE = 4;
+    static constexpr size_t TRAILERSIZE = 24;
+
+    /**
+     * Level byte of games not played by a GameTheorie level
+     */
+    static constexpr uint8_t NOLEVEL = 0xFF;
+
+    /**
+     * Outcome of a game, a winner is stored as its Player value
+     */
+    enum Result
+    {
+        UNFINISHED = 0,
+        BOTWIN = Player::BOT,
+        USERWIN = Player::USER,
+        DRAW = 3
+    };
+
+    /**
+     * Number of bytes of a game record.
+     * @param moves The number of moves of the game.
+     */
+    static size_t recordSize(size_t moves)
+    {
+        return RECORDHEADERSIZE + (moves * BITS + 7) / 8;
+    }
+
+    /**
+     * Check the file header.
+     * @param data The first bytes of the file, at least HEADERSIZE.
+     * @return An error message, empty if the header matches this board.
+     */
+    static string checkHeader(const uint8_t *data)
+    {
+        if (memcmp(data, MAGIC, sizeof(MAGIC)) != 0)
+        {
+            return "not a game log";
+        }
+        if (data[4] != VERSION)
+        {
+            return "unsupported game log version " + to_string(data[4]);
+        }
+        if (data[5] != ROWS || data[6] != COLS || data[7] != BITS)
+        {
+            return "game log of a " + to_string(data[5]) + "x" + to_string(data[6]) + " board";
+        }
+        return "";
+    }
+
+    /**
+     * Offset of the index, or 0 if the file has no valid index footer.
+     * @param data The file.
+     * @param size The size of the file.
+     * @param games Receives the number of games in the index.
+     */
+    static uint64_t findIndex(const uint8_t *data, size_t size, uint64_t &games)
+    {
+        if (size < HEADERSIZE + TRAILERSIZE || memcmp(data + size - sizeof(INDEXMAGIC), INDEXMAGIC, sizeof(INDEXMAGIC)) != 0)
+        {
+            return 0;
+        }
+        uint64_t indexOffset;
+        memcpy(&games, data + size - TRAILERSIZE, 8);
+        memcpy(&indexOffset, data + size - TRAILERSIZE + 8, 8);
+        if (indexOffset < HEADERSIZE || indexOffset > size - TRAILERSIZE || (size - TRAILERSIZE - indexOffset) / 8 != games)
+        {
+            return 0;
+        }
+        return indexOffset;
+    }
+
+    /**
+     * Offsets of the complete records between the file header and end, for logs without index.
+     * @param data The file.
+     * @param end The end of the records.
+     * @param offsets Receives the offsets.
+     * @return The end of the last complete record.
+     */
+    static uint64_t scan(const uint8_t *data, uint64_t end, vector<uint64_t> &offsets)
+    {
+        uint64_t offset = HEADERSIZE;
+        while (offset + RECORDHEADERSIZE <= end && offset + recordSize(data[offset + 3]) <= end)
+        {
+            offsets.push_back(offset);
+            offset += recordSize(data[offset + 3]);
+        }
+        return offset;
+    }
+};
+
+/**
+ * Appends games to a game log through a write buffer.
+ */
+class GameLogWriter
+{
+public:
+    /**
+     * Constructor for the GameLogWriter class, opens the log and strips its index footer.
+     * @param path_ The log file, created if it does not exist.
+     * @param bufferSize The number of bytes buffered before they are written.
+     */
+    explicit GameLogWriter(const string &path_, size_t bufferSize = size_t(1) << 16) : path(path_), BUFFERSIZE(bufferSize)
+    {
+        uint64_t end = GameLog::HEADERSIZE;
+        if (filesystem::exists(path) && filesystem::file_size(path) > 0)
+        {
+            end = recover();
+            filesystem::resize_file(path, end);
+            file.open(path, ios::binary | ios::in | ios::out);
+            file.seekp(static_cast<streamoff>(end));
+        }
+        else
+        {
+            file.open(path, ios::binary | ios::out | ios::trunc);
+            uint8_t header[GameLog::HEADERSIZE] = {'C', '4', 'G', 'L', GameLog::VERSION, GameLog::ROWS, GameLog::COLS, GameLog::BITS};
+            file.write(reinterpret_cast<const char *>(header), sizeof(header));
+        }
+        if (!file)
+        {
+            throw runtime_error("Cannot open game log " + path);
+        }
+        written = end;
+        buffer.reserve(BUFFERSIZE);
+    }
+
+    /**
+     * Destructor, writes the buffer and the index footer.
+     */
+    ~GameLogWriter()
+    {
+        try
+        {
+            close();
+        }
+        catch (const exception &)
+        {
+        }
+    }
+
+    GameLogWriter(const GameLogWriter &) = delete;
+    GameLogWriter &operator=(const GameLogWriter &) = delete;
+
+    /**
+     * Append a game.
+     * @param firstPlayer The player who made the first move, the players alternate.
+     * @param level The level of the bot, GameLog::NOLEVEL if none.
+     * @param result The outcome.
+     * @param columns The moves.
+     */
+    void append(Player firstPlayer, uint8_t level, GameLog::Result result, const vector<Column> &columns)
+    {
+        if (!file.is_open())
+        {
+            throw runtime_error("Game log " + path + " is closed");
+        }
+        if (columns.size() > static_cast<size_t>(GameLog::ROWS * GameLog::COLS))
+        {
+            throw invalid_argument("Too many moves for a game: " + to_string(columns.size()));
+        }
+
+        offsets.push_back(written + buffer.size());
+        buffer.push_back(static_cast<uint8_t>(firstPlayer));
+        buffer.push_back(level);
+        buffer.push_back(static_cast<uint8_t>(result));
+        buffer.push_back(static_cast<uint8_t>(columns.size()));
+
+        size_t start = buffer.size();
+        buffer.resize(start + (columns.size() * GameLog::BITS + 7) / 8, 0);
+        for (size_t i = 0; i < columns.size(); ++i)
+        {
+            if (columns[i] < 0 || columns[i] >= GameLog::COLS)
+            {
+                offsets.pop_back();
+                buffer.resize(start - GameLog::RECORDHEADERSIZE);
+                throw invalid_argument("Invalid column: " + to_string(columns[i]));
+            }
+            size_t bit = i * GameLog::BITS;
+            unsigned value = static_cast<unsigned>(columns[i]) << (bit % 8);
+            buffer[start + bit / 8] |= static_cast<uint8_t>(value);
+            if (bit % 8 + GameLog::BITS > 8)
+            {
+                buffer[start + bit / 8 + 1] |= static_cast<uint8_t>(value >> 8);
+            }
+        }
+
+        if (buffer.size() >= BUFFERSIZE)
+        {
+            flush();
+        }
+    }
+
+    /**
+     * Write the buffered games, the log stays readable by scanning.
+     */
+    void flush()
+    {
+        if (buffer.empty())
+        {
+            return;
+        }
+        file.write(reinterpret_cast<const char *>(buffer.data()), static_cast<streamsize>(buffer.size()));
+        file.flush();
+        if (!file)
+        {
+            throw runtime_error("Cannot write game log " + path);
+        }
+        written += buffer.size();
+        buffer.clear();
+    }
+
+    /**
+     * Write the buffer and the index footer and close the file.
+     */
+    void close()
+    {
+        if (!file.is_open())
+        {
+            return;
+        }
+        flush();
+        uint64_t indexOffset = written;
+        uint64_t games = offsets.size();
+        file.write(reinterpret_cast<const char *>(offsets.data()), static_cast<streamsize>(offsets.size() * sizeof(uint64_t)));
+        file.write(reinterpret_cast<const char *>(&games), sizeof(games));
+        file.write(reinterpret_cast<const char *>(&indexOffset), sizeof(indexOffset));
+        file.write(GameLog::INDEXMAGIC, sizeof(GameLog::INDEXMAGIC));
+        file.close();
+        if (file.fail())
+        {
+            throw runtime_error("Cannot write game log " + path);
+        }
+    }
+
+    /**
+     * Get the number of games in the log, including buffered ones.
+     * @return The number of games.
+     */
+    size_t size() const
+    {
+        return offsets.size();
+    }
+
+private:
+    string path;
+    size_t BUFFERSIZE;
+    fstream file;
+    vector<uint8_t> buffer;
+    vector<uint64_t> offsets;
+    uint64_t written = 0;
+
+    /**
+     * Load the offsets of an existing log.
+     * @return The end of the game records, where appending continues.
+     */
+    uint64_t recover()
+    {
+        MappedFile data(path, MappedFile::SEQUENTIAL);
+        if (data.size() < GameLog::HEADERSIZE)
+        {
+            throw runtime_error("Game log " + path + ": truncated header");
+        }
+        string error = GameLog::checkHeader(data.data());
+        if (!error.empty())
+        {
+            throw runtime_error("Game log " + path + ": " + error);
+        }
+
+        uint64_t games;
+        uint64_t indexOffset = GameLog::findIndex(data.data(), data.size(), games);
+        if (indexOffset)
+        {
+            offsets.resize(games);
+            memcpy(offsets.data(), data.data() + indexOffset, games * sizeof(uint64_t));
+            return indexOffset;
+        }
+        // not closed, drop a partially written record
+        return GameLog::scan(data.data(), data.size(), offsets);
+    }
+};
+
+/**
+ * Memory-mapped read-only view of a game log.
+ */
+class GameLogReader
+{
+public:
+    /**
+     * A game record inside the mapped file
+     */
+    class Game
+    {
+    public:
+        explicit Game(const uint8_t *data_) : data(data_)
+        {
+        }
+
+        Player firstPlayer() const
+        {
+            return static_cast<Player>(data[0]);
+        }
+
+        uint8_t level() const
+        {
+            return data[1];
+        }
+
+        GameLog::Result result() const
+        {
+            return static_cast<GameLog::Result>(data[2]);
+        }
+
+        size_t moves() const
+        {
+            return data[3];
+        }
+
+        /**
+         * Get a move.
+         * @param i The index of the move, 0 is the first move.
+         * @return The column played.
+         */
+        Column column(size_t i) const
+        {
+            size_t bit = i * GameLog::BITS;
+            const uint8_t *p = data + GameLog::RECORDHEADERSIZE + bit / 8;
+            unsigned value = p[0];
+            if (bit % 8 + GameLog::BITS > 8)
+            {
+                value |= static_cast<unsigned>(p[1]) << 8;
+            }
+            return static_cast<Column>((value >> (bit % 8)) & ((1u << GameLog::BITS) - 1));
+        }
+
+        /**
+         * Get the player of a move.
+         * @param i The index of the move.
+         * @return The player who made it.
+         */
+        Player player(size_t i) const
+        {
+            return (i % 2 == 0) ? firstPlayer() : (firstPlayer() == Player::BOT ? Player::USER : Player::BOT);
+        }
+
+        /**
+         * Get the moves as column letters, e.g. "DDC".
+         * @return The moves.
+         */
+        string moveString() const
+        {
+            string s;
+            for (size_t i = 0; i < moves(); ++i)
+            {
+                s += Connect4Board::colToChar(column(i));
+            }
+            return s;
+        }
+
+    private:
+        const uint8_t *data;
+    };
+
+    /**
+     * Iterator over the games in file order
+     */
+    class Iterator
+    {
+    public:
+        Iterator(const GameLogReader *reader_, size_t index_) : reader(reader_), index(index_)
+        {
+        }
+
+        Game operator*() const
+        {
+            return (*reader)[index];
+        }
+
+        Iterator &operator++()
+        {
+            ++index;
+            return *this;
+        }
+
+        bool operator!=(const Iterator &other) const
+        {
+            return index != other.index;
+        }
+
+    private:
+        const GameLogReader *reader;
+        size_t index;
+    };
+
+    /**
+     * Constructor for the GameLogReader class, maps the log into memory.
+     * @param path The log file.
+     */
+    explicit GameLogReader(const string &path) : file(path, MappedFile::SEQUENTIAL)
+    {
+        data = file.data();
+        if (file.size() < GameLog::HEADERSIZE)
+        {
+            throw runtime_error("Game log " + path + ": truncated header");
+        }
+        string error = GameLog::checkHeader(data);
+        if (!error.empty())
+        {
+            throw runtime_error("Game log " + path + ": " + error);
+        }
+
+        uint64_t games;
+        uint64_t indexOffset = GameLog::findIndex(data, file.size(), games);
+        if (indexOffset)
+        {
+            index = data + indexOffset;
+            count = games;
+        }
+        else
+        {
+            GameLog::scan(data, file.size(), scanned);
+            count = scanned.size();
+        }
+    }
+
+    GameLogReader(const GameLogReader &) = delete;
+    GameLogReader &operator=(const GameLogReader &) = delete;
+
+    /**
+     * Get the number of games.
+     * @return The number of games.
+     */
+    size_t games() const
+    {
+        return count;
+    }
+
+    /**
+     * Get a game.
+     * @param i The index of the game, in the order the games were appended.
+     * @return The game.
+     */
+    Game operator[](size_t i) const
+    {
+        uint64_t offset;
+        if (index)
+        {
+            memcpy(&offset, index + i * sizeof(uint64_t), sizeof(offset));
+        }
+        else
+        {
+            offset = scanned[i];
+        }
+        return Game(data + offset);
+    }
+
+    Iterator begin() const
+    {
+        return Iterator(this, 0);
+    }
+
+    Iterator end() const
+    {
+        return Iterator(this, count);
+    }
+
+private:
+    MappedFile file;
+    const uint8_t *data = nullptr;
+    const uint8_t *index = nullptr;
+    vector<uint64_t> scanned;
+    size_t count = 0;
+};
+
+#endif // GAME_LOG_H
@@ -2,15 +2,90 @@
 #define GAMETHEORIE_H
 
 #include "include.h"
-class GameTheorie
+
+/**
+ * Types shared by the game theories of every board size.
+ */
+struct GameTheorieTypes
+{
+    /**
+     * Enumeration for the difficulty levels of the game theory algorithm.
+     * EASY: Basic heuristics
+     * MEDIUM: More advanced heuristics
+     * HARD: Full tree search with pruning
+     */
+    enum Level
+    {
+        EASY = 0,
+        MEDIUM = 1,
+        HARD = 2
+    };
+};
+
+/**
+ * Game theory (the brains of the bot) for a board type.
+ * @tparam Board The board the game is played on, e.g. Connect4Board.
+ */
+template <typename Board>
+class BasicGameTheorie : public GameTheorieTypes
 {
 public:
+    using Metrics = BasicMetrics<Board>;
+    using TreeNode = BasicTreeNode<Board>;
+    using Tree = BasicTree<Board>;
+
+    /**
+     * A root child as seen by the move selection
+     */
+    struct RootChild
+    {
+        Column move;
+        int row;
+        Player owner;
+        TileMetrics metrics;
+    };
+    using RootChildren = StaticVector<RootChild, Board::COLS>;
+
+    /**
+     * A root child with the score backed up to it, see backUp
+     */
+    struct ScoredMove
+    {
+        Column move;
+        int score;
+    };
+    using ScoredMoves = StaticVector<ScoredMove, Board::COLS>;
+
+    /**
+     * Score of a position that is won by the player who moved into it
+     */
+    static constexpr int SCOREWIN = 10000;
+
+    /**
+     * Read-only view of the game, published after every change so other threads can query it without locks
+     */
+    struct Position
+    {
+        Board board;
+        Player currentPlayer = Player::EMPTY;
+        size_t moves = 0;
+        RootChildren children;
+
+        /**
+         * The settings the move selection reads, copied so readers never touch members the game thread may write
+         */
+        const PositionIndex *book = nullptr;
+        uint32_t bookMinGames = 0;
+        Player startingPlayer = Player::EMPTY;
+        bool advancedPruning = true;
+    };
+
     /**
      * Constants for the dimensions of the Connect 4 board.
-     * ROWS = 6, COLS = 7
+     * The classic board has ROWS = 6, COLS = 7
      */
-    static constexpr int ROWS = Connect4Board::ROWS;
-    static constexpr int COLS = Connect4Board::COLS;
+    static constexpr int ROWS = Board::ROWS;
+    static constexpr int COLS = Board::COLS;
 
     /**
      * Pointer to the game tree used for decision making
@@ -20,7 +95,7 @@ public:
     /**
      * Pointer to the Connect4Board instance
      */
-    Connect4Board *BOARD = nullptr;
+    Board *BOARD = nullptr;
 
     /**
      * The current player
@@ -31,19 +106,6 @@ public:
     Player STARTINGPLAYER = Player::EMPTY; // The player who starts the game
     Player CURRENTPLAYER = Player::EMPTY;  // The player who is currently playing
 
-    /**
-     * Enumeration for the difficulty levels of the game theory algorithm.
-     * EASY: Basic heuristics
-     * MEDIUM: More advanced heuristics
-     * HARD: Full tree search with pruning
-     */
-    enum Level
-    {
-        EASY = 0,
-        MEDIUM = 1,
-        HARD = 2
-    };
-
     /**
      * The level of the game theory algorithm
      * EASY: Basic heuristics
@@ -62,21 +124,65 @@ public:
      */
     MoveRecorder MOVERECORDER;
 
+    /**
+     * Experience book consulted by getBestMove before the game tree, nullptr for none (classic board only)
+     */
+    const PositionIndex *BOOK = nullptr;
+
+    /**
+     * The number of finished games a book move needs before it is played
+     */
+    uint32_t BOOKMINGAMES = 10;
+
+    /**
+     * Search counters of the last played move, covering the best-move selection before it and the tree update after it
+     */
+    SearchCounters LASTMOVESTATS;
+
+    /**
+     * The position for concurrent readers, see publish
+     */
+    Published<Position> POSITION;
+
     /**
      * Default constructor for GameTheorie
      * Initializes the game theory with a default board and players
+     * @param exportDot If false, the tree is never written to tree.dot and tree.svg (headless runs)
+     * @param treeSnapshot If not empty, the initial tree is loaded from this snapshot file, or built and saved to it
      */
-    GameTheorie(Connect4Board &board, Player startingPlayer = Player::BOT,
-                int depth = 2, Level level = Level::EASY, bool advancedPruning = true)
+    BasicGameTheorie(Board &board, Player startingPlayer = Player::BOT,
+                int depth = 2, Level level = Level::EASY, bool advancedPruning = true, bool exportDot = true,
+                const string &treeSnapshot = "")
         : STARTINGPLAYER(startingPlayer), CURRENTPLAYER(startingPlayer), LEVEL(level), ADVANCEDPRUNING(advancedPruning)
     {
         BOARD = &board;
-        tree = new Tree(board, startingPlayer, depth, advancedPruning);
-        tree->toDot();
-        tree->dotToSvg();
+        tree = new Tree(board, startingPlayer, depth, advancedPruning, treeSnapshot);
+        tree->EXPORTDOT = exportDot;
+        if (exportDot)
+        {
+            tree->toDot();
+            tree->dotToSvg();
+        }
         MOVERECORDER = MoveRecorder();
+        moveStart = SearchStats::snapshot();
+        publish();
     }
 
+    /**
+     * Destructor for GameTheorie, hands the game tree to the reclaimer
+     */
+    ~BasicGameTheorie()
+    {
+        if (tree)
+        {
+            tree->release();
+            delete tree;
+        }
+    }
+
+    BasicGameTheorie(const BasicGameTheorie &) = delete;
+    BasicGameTheorie &operator=(const BasicGameTheorie &) = delete;
+
     /**
      * Play a move in the specified column for the given player and update the game tree
      * @param column The column to play in
@@ -85,6 +191,7 @@ public:
      */
     bool playMove(Column column, Player player, bool debug = false)
     {
+        TRACE_SCOPE("GameTheorie::playMove");
         if (!BOARD)
         {
             throw runtime_error("Board is not initialized.");
@@ -102,24 +209,164 @@ public:
 
         if (BOARD->findRow(column) < 0)
         {
-            throw runtime_error("Column " + Connect4Board::colToChar(column) + " is full.");
+            throw runtime_error(string("Column ") + Board::colToChar(column) + " is full.");
         }
 
         if (debug)
         {
-            cout << "Player " << (player == Player::BOT ? "Bot" : "User") << " plays in column: " << Connect4Board::colToChar(column) << endl;
+            cout << "Player " << (player == Player::BOT ? "Bot" : "User") << " plays in column: " << Board::colToChar(column) << endl;
         }
 
-        bool playerWon = BOARD->dropDisc(column, player);
+        bool playerWon;
+        {
+            SearchStats::PhaseTimer timer(SearchCounters::PLAYMOVE);
+            playerWon = BOARD->dropDisc(column, player);
+
+            tree->updateTree(*BOARD, column);
 
-        tree->updateTree(*BOARD, column);
+            setCurrentPlayer(BOARD->getOponent(player));
 
-        setCurrentPlayer(BOARD->getOponent(player));
+            MOVERECORDER.recordMove(player, column);
+            publish();
+        }
 
-        MOVERECORDER.recordMove(player, column);
+        SearchCounters now = SearchStats::snapshot();
+        LASTMOVESTATS = now.since(moveStart);
+        moveStart = now;
         return playerWon;
     }
 
+    /**
+     * Take the last move back, the board, the current player and the move history are restored.
+     * The tree steps back to its previous root if it kept one (see setTakebacks), otherwise it is rebuilt.
+     * @return False if no move was played.
+     */
+    bool undoMove()
+    {
+        TRACE_SCOPE("GameTheorie::undoMove");
+        const vector<Move> &history = MOVERECORDER.getHistory();
+        if (history.empty())
+        {
+            return false;
+        }
+        Move last = history.back();
+        if (BOARD->removeDisc(last.column) != last.player)
+        {
+            throw runtime_error(string("Column ") + Board::colToChar(last.column) + " does not hold the last move.");
+        }
+        MOVERECORDER.undoMove();
+        setCurrentPlayer(last.player);
+
+        if (!tree->moveRootBack())
+        {
+            Tree *rebuilt = new Tree(*BOARD, last.player, tree->DEPTH, ADVANCEDPRUNING);
+            rebuilt->EXPORTDOT = tree->EXPORTDOT;
+            rebuilt->DOTFILE = tree->DOTFILE;
+            rebuilt->HISTORY = tree->HISTORY;
+            tree->release();
+            delete tree;
+            tree = rebuilt;
+        }
+        publish();
+        return true;
+    }
+
+    /**
+     * Publish the board, the player to move, the root children and the selection settings for readers on other threads.
+     * playMove, undoMove, setBook and setStartingPlayer publish themselves, call this after changing the board,
+     * growing the tree or setting ADVANCEDPRUNING directly.
+     */
+    void publish()
+    {
+        Position position;
+        position.board = *BOARD;
+        position.currentPlayer = CURRENTPLAYER;
+        position.moves = MOVERECORDER.getHistory().size();
+        position.children = rootChildren(tree->ROOT);
+        position.book = BOOK;
+        position.bookMinGames = BOOKMINGAMES;
+        position.startingPlayer = STARTINGPLAYER;
+        position.advancedPruning = ADVANCEDPRUNING;
+        POSITION.publish(std::move(position));
+    }
+
+    /**
+     * Pin the last published position, safe to call from any thread while the game goes on.
+     * @return The reader, the position stays valid until it is destroyed.
+     */
+    typename Published<Position>::Reader readPosition() const
+    {
+        return POSITION.read();
+    }
+
+    /**
+     * Get the best move in the last published position, safe to call from any thread while the game goes on.
+     * Uses the same selection as getBestMove on the root children and settings that were published, the tree and the
+     * members of this object are not touched.
+     * @param level The difficulty level
+     * @return The best move as a Column
+     */
+    Column queryBestMove(Level level = MEDIUM) const
+    {
+        typename Published<Position>::Reader position = POSITION.read();
+        Board board = position->board;
+        if constexpr (is_same<Board, Connect4Board>::value)
+        {
+            if (position->book)
+            {
+                Column bookMove = position->book->bestMove(board, position->startingPlayer, position->bookMinGames);
+                if (bookMove != Column::INVALID)
+                {
+                    return bookMove;
+                }
+            }
+        }
+        if (position->advancedPruning && !position->children.empty())
+        {
+            return position->children.front().move;
+        }
+        if (level == EASY)
+        {
+            return selectEasy(board, position->currentPlayer);
+        }
+        else if (level == MEDIUM)
+        {
+            return selectMedium(position->children, board.getPossibleMoves());
+        }
+        else if (level == HARD)
+        {
+            return selectHard(position->children, board.getPossibleMoves(), position->startingPlayer);
+        }
+        throw invalid_argument("Invalid game theory level.");
+    }
+
+    /**
+     * Set how many moves undoMove can take back without rebuilding the tree.
+     * Every kept move holds on to the previous root and its other branches.
+     * @param moves The number of previous roots the tree keeps.
+     */
+    void setTakebacks(size_t moves)
+    {
+        tree->HISTORY = moves;
+    }
+
+    /**
+     * Print the search counters of the last played move
+     */
+    void printMoveStats() const
+    {
+        LASTMOVESTATS.print();
+    }
+
+    /**
+     * Get the search counters of the last played move
+     * @return The counters
+     */
+    const SearchCounters &getMoveStats() const
+    {
+        return LASTMOVESTATS;
+    }
+
     /**
      * print the current state of the board
      */
@@ -150,8 +397,25 @@ public:
      * @param debug If true, enables debug output
      * @return The best move as a Column
      */
-    Column getBestMove(GameTheorie::Level level = MEDIUM, bool debug = false)
+    Column getBestMove(Level level = MEDIUM, bool debug = false)
     {
+        TRACE_SCOPE("GameTheorie::getBestMove");
+        SearchStats::PhaseTimer timer(SearchCounters::BESTMOVE);
+        if constexpr (is_same<Board, Connect4Board>::value)
+        {
+            if (BOOK)
+            {
+                Column bookMove = BOOK->bestMove(*BOARD, STARTINGPLAYER, BOOKMINGAMES);
+                if (bookMove != Column::INVALID)
+                {
+                    if (debug)
+                    {
+                        cout << "Book move: " << Board::colToChar(bookMove) << endl;
+                    }
+                    return bookMove;
+                }
+            }
+        }
         if (ADVANCEDPRUNING)
         {
             if (!tree->ROOT->children.empty())
@@ -188,17 +452,29 @@ public:
      */
     Column getBestMoveEasy(bool debug = false)
     {
-        Player player = CURRENTPLAYER;
-        vector<Column> possibleMoves = BOARD->getPossibleMoves();
+        TRACE_SCOPE("GameTheorie::getBestMoveEasy");
+        return selectEasy(*BOARD, CURRENTPLAYER, debug);
+    }
+
+    /**
+     * Level = Easy selection from the metrics of a position.
+     * @param board The position.
+     * @param player The player to move.
+     * @param debug if there should be extra output to help debugging
+     * @return The best move as a Column
+     */
+    Column selectEasy(Board &board, Player player, bool debug = false) const
+    {
+        typename Board::MoveList possibleMoves = board.getPossibleMoves();
         if (possibleMoves.empty())
         {
             throw runtime_error("No possible moves available.");
         }
-        vector<int> pressure = Metrics::countPressureSum(*BOARD, player);
-        vector<int> winOptions = Metrics::countWinOptions(*BOARD, player);
-        vector<bool> threats = Metrics::computeImmediateThreats(*BOARD, player);
-        vector<bool> minorThreats = Metrics::computeMinorThreats(*BOARD, player);
-        vector<bool> winMoves = Metrics::computeWinningMoves(*BOARD, player);
+        typename Metrics::ColumnValues pressure = Metrics::countPressureSum(board, player);
+        typename Metrics::ColumnValues winOptions = Metrics::countWinOptions(board, player);
+        typename Metrics::ColumnFlags threats = Metrics::computeImmediateThreats(board, player);
+        typename Metrics::ColumnFlags minorThreats = Metrics::computeMinorThreats(board, player);
+        typename Metrics::ColumnFlags winMoves = Metrics::computeWinningMoves(board, player);
 
         if (debug)
         {
@@ -213,7 +489,7 @@ public:
 
             cout << "\nSpanning per kolom voor speler 2:" << endl;
 
-            for (int c = 0; c < Connect4Board::COLS; ++c)
+            for (int c = 0; c < COLS; ++c)
             {
                 if (pressure[c] < 0)
                 {
@@ -230,7 +506,7 @@ public:
 
             cout << "Aantal win-opties per kolom voor speler 2:" << endl;
 
-            for (int c = 0; c < 7; ++c)
+            for (int c = 0; c < COLS; ++c)
             {
                 if (winOptions[c] < 0)
                 {
@@ -245,7 +521,7 @@ public:
             cout << endl;
             cout << "Threat:" << endl;
 
-            for (int c = 0; c < 7; ++c)
+            for (int c = 0; c < COLS; ++c)
             {
                 if (threats[c] == true)
                 {
@@ -260,7 +536,7 @@ public:
             cout << endl;
             cout << "Minor Threat:" << endl;
 
-            for (int c = 0; c < 7; ++c)
+            for (int c = 0; c < COLS; ++c)
             {
                 if (minorThreats[c] == true)
                 {
@@ -275,7 +551,7 @@ public:
             cout << endl;
             cout << "win moves:" << endl;
 
-            for (int c = 0; c < 7; ++c)
+            for (int c = 0; c < COLS; ++c)
             {
                 if (winMoves[c] == true)
                 {
@@ -338,6 +614,7 @@ public:
      */
     Column getBestMoveMedium(bool debug = false)
     {
+        TRACE_SCOPE("GameTheorie::getBestMoveMedium");
         if (!tree)
         {
             throw runtime_error("Tree is not initialized.");
@@ -349,63 +626,72 @@ public:
             throw runtime_error("Tree root is not initialized.");
         }
 
-        Tree copy = *tree;
-        vector<Column> possibleMoves = BOARD->getPossibleMoves();
+        return selectMedium(rootChildren(root), BOARD->getPossibleMoves(), debug);
+    }
 
+    /**
+     * Level = Medium selection from the metrics of the root children.
+     * @param children The root children.
+     * @param possibleMoves The playable columns.
+     * @param debug if there should be extra output to help debugging
+     * @return The best move as a Column
+     */
+    Column selectMedium(const RootChildren &children, const typename Board::MoveList &possibleMoves, bool debug = false) const
+    {
         int bestPressure = -1;
         int bestWinOptions = -1;
         Column threatTile = Column::INVALID;
         Column minorThreatTile = Column::INVALID;
         Column bestMove = possibleMoves.front();
 
-        for (auto child : copy.ROOT->children)
+        for (const RootChild &child : children)
         {
             if (debug)
             {
-                cout << "Child: " << Connect4Board::colToChar(child->move) << to_string(child->row)
-                     << " Owner: " << (child->owner == 1 ? "Player 1" : "Player 2")
-                     << " Win: " << (child->metrics.winningMove ? "True" : "False")
-                     << " Threat: " << (child->metrics.immediateThreat ? "True" : "False")
-                     << " Minor Threat: " << (child->metrics.minorThreat ? "True" : "False")
-                     << " Win Options: " << child->metrics.winOptions
-                     << " Pressure: " << child->metrics.pressure
+                cout << "Child: " << Board::colToChar(child.move) << to_string(child.row)
+                     << " Owner: " << (child.owner == 1 ? "Player 1" : "Player 2")
+                     << " Win: " << (child.metrics.winningMove ? "True" : "False")
+                     << " Threat: " << (child.metrics.immediateThreat ? "True" : "False")
+                     << " Minor Threat: " << (child.metrics.minorThreat ? "True" : "False")
+                     << " Win Options: " << child.metrics.winOptions
+                     << " Pressure: " << child.metrics.pressure
                      << endl;
             }
 
-            if (child->metrics.winningMove)
+            if (child.metrics.winningMove)
             {
-                return child->move;
+                return child.move;
             }
-            if (child->metrics.immediateThreat)
+            if (child.metrics.immediateThreat)
             {
-                if (threatTile == Column::INVALID || child->metrics.pressure > bestPressure)
+                if (threatTile == Column::INVALID || child.metrics.pressure > bestPressure)
                 {
-                    threatTile = child->move;
-                    bestPressure = child->metrics.pressure;
+                    threatTile = child.move;
+                    bestPressure = child.metrics.pressure;
                 }
             }
-            if (child->metrics.minorThreat)
+            if (child.metrics.minorThreat)
             {
-                if (minorThreatTile == Column::INVALID || child->metrics.pressure > bestPressure)
+                if (minorThreatTile == Column::INVALID || child.metrics.pressure > bestPressure)
                 {
-                    minorThreatTile = child->move;
-                    bestPressure = child->metrics.pressure;
+                    minorThreatTile = child.move;
+                    bestPressure = child.metrics.pressure;
                 }
             }
 
-            int p = child->metrics.winOptions;
+            int p = child.metrics.winOptions;
             if (p > bestWinOptions)
             {
                 bestWinOptions = p;
-                bestPressure = child->metrics.pressure;
-                bestMove = child->move;
+                bestPressure = child.metrics.pressure;
+                bestMove = child.move;
             }
             else if (p == bestWinOptions)
             {
-                if (child->metrics.pressure > bestPressure)
+                if (child.metrics.pressure > bestPressure)
                 {
-                    bestPressure = child->metrics.pressure;
-                    bestMove = child->move;
+                    bestPressure = child.metrics.pressure;
+                    bestMove = child.move;
                 }
             }
         }
@@ -428,6 +714,7 @@ public:
      */
     Column getBestMoveHard(bool debug = false)
     {
+        TRACE_SCOPE("GameTheorie::getBestMoveHard");
         if (!tree)
         {
             throw runtime_error("Tree is not initialized.");
@@ -436,9 +723,19 @@ public:
         {
             throw runtime_error("Tree root is not initialized.");
         }
-        Tree copy = *tree;
-        vector<Column> possibleMoves = BOARD->getPossibleMoves();
+        return selectHard(rootChildren(tree->ROOT), BOARD->getPossibleMoves(), STARTINGPLAYER, debug);
+    }
 
+    /**
+     * Level = HARD selection from the metrics of the root children, see moveScore.
+     * @param children The root children.
+     * @param possibleMoves The playable columns.
+     * @param startingPlayer The player who started the game.
+     * @param debug if there should be extra output to help debugging
+     * @return The best move as a Column
+     */
+    Column selectHard(const RootChildren &children, const typename Board::MoveList &possibleMoves, Player startingPlayer, bool debug = false) const
+    {
         Column bestMove = possibleMoves.front();
         Column threatTile = Column::INVALID;
         Column minorThreatTile = Column::INVALID;
@@ -447,35 +744,28 @@ public:
         int bestScore = -1;
         int pressure = -1;
 
-        bool botPrefersOddWin = (STARTINGPLAYER == Player::BOT);
-
-        for (TreeNode *child : copy.ROOT->children)
+        for (const RootChild &child : children)
         {
-            if (!child)
-            {
-                continue;
-            }
-
             if (debug)
             {
-                cout << "Child: " << Connect4Board::colToChar(child->move) << child->row
-                     << " Owner: " << (child->owner == 1 ? "Player 1" : "Player 2")
-                     << " Win: " << (child->metrics.winningMove ? "True" : "False")
-                     << " Threat: " << (child->metrics.immediateThreat ? "True" : "False")
-                     << " Minor Threat: " << (child->metrics.minorThreat ? "True" : "False")
-                     << " Win Options: " << child->metrics.winOptions
-                     << " Pressure: " << child->metrics.pressure
-                     << " FutureWinRow: " << child->metrics.preferredWinningRow
-                     << " EnablesOpponentThreat: " << (child->metrics.enablesOpponentThreat ? "True" : "False")
+                cout << "Child: " << Board::colToChar(child.move) << child.row
+                     << " Owner: " << (child.owner == 1 ? "Player 1" : "Player 2")
+                     << " Win: " << (child.metrics.winningMove ? "True" : "False")
+                     << " Threat: " << (child.metrics.immediateThreat ? "True" : "False")
+                     << " Minor Threat: " << (child.metrics.minorThreat ? "True" : "False")
+                     << " Win Options: " << child.metrics.winOptions
+                     << " Pressure: " << child.metrics.pressure
+                     << " FutureWinRow: " << child.metrics.preferredWinningRow
+                     << " EnablesOpponentThreat: " << (child.metrics.enablesOpponentThreat ? "True" : "False")
                      << endl;
             }
 
-            if (child->metrics.winningMove)
+            if (child.metrics.winningMove)
             {
-                return child->move;
+                return child.move;
             }
 
-            if (child->metrics.immediateThreat)
+            if (child.metrics.immediateThreat)
             {
                 bool better = false;
 
@@ -483,24 +773,24 @@ public:
                 {
                     better = true;
                 }
-                else if (child->metrics.pressure > pressure)
+                else if (child.metrics.pressure > pressure)
                 {
                     better = true;
                 }
-                else if (child->metrics.pressure == pressure && child->metrics.enablesOpponentThreat == false && enablesOpponentThreatFound == true)
+                else if (child.metrics.pressure == pressure && child.metrics.enablesOpponentThreat == false && enablesOpponentThreatFound == true)
                 {
                     better = true;
                 }
 
                 if (better)
                 {
-                    threatTile = child->move;
-                    pressure = child->metrics.pressure;
-                    enablesOpponentThreatFound = child->metrics.enablesOpponentThreat;
+                    threatTile = child.move;
+                    pressure = child.metrics.pressure;
+                    enablesOpponentThreatFound = child.metrics.enablesOpponentThreat;
                 }
             }
 
-            if (child->metrics.minorThreat)
+            if (child.metrics.minorThreat)
             {
                 bool better = false;
 
@@ -508,47 +798,29 @@ public:
                 {
                     better = true;
                 }
-                else if (child->metrics.pressure > pressure)
+                else if (child.metrics.pressure > pressure)
                 {
                     better = true;
                 }
-                else if (child->metrics.pressure == pressure && child->metrics.enablesOpponentThreat == false && enablesOpponentThreatFound == true)
+                else if (child.metrics.pressure == pressure && child.metrics.enablesOpponentThreat == false && enablesOpponentThreatFound == true)
                 {
                     better = true;
                 }
 
                 if (better)
                 {
-                    minorThreatTile = child->move;
-                    pressure = child->metrics.pressure;
-                    enablesOpponentThreatFound = child->metrics.enablesOpponentThreat;
+                    minorThreatTile = child.move;
+                    pressure = child.metrics.pressure;
+                    enablesOpponentThreatFound = child.metrics.enablesOpponentThreat;
                 }
             }
 
-            int bonus = 0;
-
-            if (!child->metrics.enablesOpponentThreat)
-            {
-                bonus += 5;
-            }
-
-            int futureRow = child->metrics.preferredWinningRow;
-
-            if (futureRow != -1)
-            {
-                bool isOdd = (futureRow % 2 == 1);
-                if (isOdd == botPrefersOddWin)
-                {
-                    bonus += 5;
-                }
-            }
-
-            int score = child->metrics.winOptions * 10 + child->metrics.pressure + bonus;
+            int score = moveScore(child.metrics, Player::BOT, startingPlayer);
 
             if (score > bestScore)
             {
                 bestScore = score;
-                bestMove = child->move;
+                bestMove = child.move;
             }
         }
 
@@ -562,11 +834,130 @@ public:
         }
         return bestMove;
     }
+
+    /**
+     * Heuristic score of a bot move used by getBestMoveHard, threats and wins are ranked before it.
+     * @param metrics The metrics of the move.
+     * @return The score, higher is better.
+     */
+    int moveScore(const TileMetrics &metrics) const
+    {
+        return moveScore(metrics, Player::BOT);
+    }
+
+    /**
+     * Heuristic score of a move for the player who makes it, the player who started prefers wins on odd rows.
+     * @param metrics The metrics of the move.
+     * @param player The player making the move.
+     * @return The score, higher is better.
+     */
+    int moveScore(const TileMetrics &metrics, Player player) const
+    {
+        return moveScore(metrics, player, STARTINGPLAYER);
+    }
+
+    /**
+     * Heuristic score of a move, see moveScore(metrics, player).
+     * @param metrics The metrics of the move.
+     * @param player The player making the move.
+     * @param startingPlayer The player who started the game.
+     * @return The score, higher is better.
+     */
+    static int moveScore(const TileMetrics &metrics, Player player, Player startingPlayer)
+    {
+        bool botPrefersOddWin = (startingPlayer == player);
+        int bonus = 0;
+
+        if (!metrics.enablesOpponentThreat)
+        {
+            bonus += 5;
+        }
+
+        int futureRow = metrics.preferredWinningRow;
+
+        if (futureRow != -1)
+        {
+            bool isOdd = (futureRow % 2 == 1);
+            if (isOdd == botPrefersOddWin)
+            {
+                bonus += 5;
+            }
+        }
+
+        return metrics.winOptions * 10 + metrics.pressure + bonus;
+    }
+
+    /**
+     * Negamax over the tree below the root, down to a number of plies.
+     * A node is worth SCOREWIN to the player who moved into it if that move wins, a node on the last ply or without
+     * children is worth its moveScore, any other node is worth the best reply of the opponent, negated.
+     * Nodes deeper than the plies are ignored, so the scores only depend on the depth asked for.
+     * With advanced pruning the bot keeps only its preferred move (see Tree::addLayer), so a win of the bot is proven
+     * but a loss is not: a node where the kept bot move loses is worth its moveScore, as if it were not searched.
+     * A mirrored child has no subtree of its own, it gets the score of its twin (see searched).
+     * @param plies The plies below the root to look at, the root children are on ply 1.
+     * @return The root children with their scores for the player who makes them.
+     */
+    ScoredMoves backUp(int plies) const
+    {
+        TRACE_SCOPE("GameTheorie::backUp");
+        // a node on the current line and the best score of its children so far, for the player who replies to it
+        struct Frame
+        {
+            const TreeNode *node;
+            int ply;
+            size_t next;
+            int best;
+        };
+        StaticVector<Frame, Board::ROWS * Board::COLS + 1> stack;
+        ScoredMoves scores;
+        for (const TreeNode *child : tree->ROOT->children)
+        {
+            const TreeNode *node = searched(tree->ROOT, child);
+            int score = leafScore(node, 1, plies);
+            if (score == numeric_limits<int>::min())
+            {
+                stack.push_back({node, 1, 0, numeric_limits<int>::min()});
+            }
+            while (!stack.empty())
+            {
+                Frame &frame = stack.back();
+                if (frame.next < frame.node->children.size())
+                {
+                    const TreeNode *next = searched(frame.node, frame.node->children[frame.next++]);
+                    int leaf = leafScore(next, frame.ply + 1, plies);
+                    if (leaf == numeric_limits<int>::min())
+                    {
+                        stack.push_back({next, frame.ply + 1, 0, numeric_limits<int>::min()});
+                    }
+                    else
+                    {
+                        frame.best = max(frame.best, replyScore(frame.node, next, leaf));
+                    }
+                    continue;
+                }
+                score = -frame.best;
+                const TreeNode *node = frame.node;
+                if (prunedForBot(node) && frame.best <= -SCOREWIN)
+                {
+                    score = moveScore(node->metrics, node->owner);
+                }
+                stack.pop_back();
+                if (!stack.empty())
+                {
+                    stack.back().best = max(stack.back().best, replyScore(stack.back().node, node, score));
+                }
+            }
+            scores.push_back({child->move, score});
+        }
+        return scores;
+    }
+
     /**
      * Set the board and player for this game theory instance
      * @param newBoard The new Connect4Board instance
      */
-    void setBoard(Connect4Board &newBoard)
+    void setBoard(Board &newBoard)
     {
         BOARD = &newBoard;
     }
@@ -596,6 +987,7 @@ public:
     void setStartingPlayer(Player player)
     {
         STARTINGPLAYER = player;
+        publish();
     }
 
     /**
@@ -638,7 +1030,7 @@ public:
      * Get the current board
      * @return The Connect4Board instance
      */
-    Connect4Board &getBoard() const
+    Board &getBoard() const
     {
         return *BOARD;
     }
@@ -653,12 +1045,58 @@ public:
     }
 
     /**
-     * Set the tree for this game theory instance
-     * @param newTree The new Tree instance
+     * Replace the tree of this game theory instance and publish its root.
+     * The instance takes ownership of the new tree and deletes it like the one it built itself;
+     * the previous tree is released and deleted here.
+     * @param newTree The new Tree instance, allocated with new. Must not be null.
      */
     void setTree(Tree *newTree)
     {
+        if (newTree == tree)
+        {
+            return;
+        }
+        if (tree)
+        {
+            tree->release();
+            delete tree;
+        }
         tree = newTree;
+        publish();
+    }
+
+    /**
+     * Consult a position index before searching, moves are taken from it while the position is known.
+     * @param book The index, nullptr to stop using one. Must outlive this object.
+     * @param minGames The number of finished games a move needs before it is played.
+     */
+    void setBook(const PositionIndex *book, uint32_t minGames = 10)
+    {
+        BOOK = book;
+        BOOKMINGAMES = minGames;
+        publish();
+    }
+
+    /**
+     * Append the played game to a binary game log, the result is taken from the current board.
+     * @param log The log.
+     */
+    void saveGame(GameLogWriter &log) const
+    {
+        GameLog::Result result = GameLog::UNFINISHED;
+        if (BOARD->checkWin(Player::BOT))
+        {
+            result = GameLog::BOTWIN;
+        }
+        else if (BOARD->checkWin(Player::USER))
+        {
+            result = GameLog::USERWIN;
+        }
+        else if (BOARD->full())
+        {
+            result = GameLog::DRAW;
+        }
+        MOVERECORDER.save(log, static_cast<uint8_t>(LEVEL), result);
     }
 
     /**
@@ -668,6 +1106,86 @@ public:
     {
         MOVERECORDER.print();
     }
+
+private:
+    /**
+     * Copy the root children for the move selection.
+     */
+    static RootChildren rootChildren(const TreeNode *root)
+    {
+        RootChildren children;
+        for (const TreeNode *child : root->children)
+        {
+            children.push_back({child->move, child->row, child->owner, child->metrics});
+        }
+        return children;
+    }
+
+    /**
+     * Score of a node that is not searched any deeper, see backUp.
+     * @return The score for the player who moved into the node, numeric_limits<int>::min() if its children are searched.
+     */
+    int leafScore(const TreeNode *node, int ply, int plies) const
+    {
+        if (node->metrics.winningMove)
+        {
+            return SCOREWIN;
+        }
+        if (ply >= plies || node->children.empty())
+        {
+            return moveScore(node->metrics, node->owner);
+        }
+        return numeric_limits<int>::min();
+    }
+
+    /**
+     * Get the node whose subtree stands for a child.
+     * A mirrored child is never expanded, its twin on the other half of the board has the mirror image of its subtree.
+     * The tile metrics do not depend on the orientation of the board, so the twin's subtree scores exactly like the mirrored one.
+     * @return The twin for a mirrored child, the child itself otherwise.
+     */
+    static const TreeNode *searched(const TreeNode *parent, const TreeNode *child)
+    {
+        if (!child->mirrored)
+        {
+            return child;
+        }
+        Column twin = Board::mirrorColumn(child->move);
+        for (const TreeNode *other : parent->children)
+        {
+            if (other->move == twin)
+            {
+                return other;
+            }
+        }
+        return child;
+    }
+
+    /**
+     * Score of a child for the player who replies to its parent; a fallback child is owned by the parent's player.
+     */
+    /**
+     * Check if the bot's moves below a node were cut to the one it prefers, see backUp.
+     */
+    bool prunedForBot(const TreeNode *node) const
+    {
+        return tree->ADVANCEDPRUNING && !node->children.empty() && node->children.front()->owner == Player::BOT;
+    }
+
+    static int replyScore(const TreeNode *parent, const TreeNode *child, int score)
+    {
+        return child->owner == parent->owner ? -score : score;
+    }
+
+    /**
+     * Counters of this thread when the last move was finished
+     */
+    SearchCounters moveStart;
 };
 
+/**
+ * Game theory for the classic 6 x 7 board
+ */
+using GameTheorie = BasicGameTheorie<Connect4Board>;
+
 #endif // GAMETHEORIE_H
@@ -0,0 +1,222 @@
+#ifndef LOCAL_SOCKET_H
+#define LOCAL_SOCKET_H
+
+#include "include.h"
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * Line-oriented unix domain stream socket, used by the session server and its clients and by the distributed solver.
+ * Reads are buffered and split on newlines, writes send a whole line at once and may come from several threads.
+ */
+class LocalSocket
+{
+public:
+    /**
+     * Create a listening socket, an existing socket file at the path is replaced.
+     * @param path The socket file.
+     * @param backlog The number of pending connections.
+     * @return The socket.
+     */
+    static unique_ptr<LocalSocket> listen(const string &path, int backlog = 128)
+    {
+        int fd = open(path);
+        unlink(path.c_str());
+        sockaddr_un address = addressOf(path);
+        if (::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || ::listen(fd, backlog) != 0)
+        {
+            ::close(fd);
+            throw runtime_error("Cannot listen on " + path + ": " + strerror(errno));
+        }
+        return unique_ptr<LocalSocket>(new LocalSocket(fd));
+    }
+
+    /**
+     * Connect to a listening socket.
+     * @param path The socket file.
+     * @return The connection.
+     */
+    static unique_ptr<LocalSocket> connect(const string &path)
+    {
+        int fd = open(path);
+        sockaddr_un address = addressOf(path);
+        if (::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+        {
+            ::close(fd);
+            throw runtime_error("Cannot connect to " + path + ": " + strerror(errno));
+        }
+        return unique_ptr<LocalSocket>(new LocalSocket(fd));
+    }
+
+    /**
+     * Create a connected pair of sockets, e.g. to talk to a forked process.
+     * @return Both ends.
+     */
+    static pair<unique_ptr<LocalSocket>, unique_ptr<LocalSocket>> socketPair()
+    {
+        int fds[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        {
+            throw runtime_error(string("Cannot create socket pair: ") + strerror(errno));
+        }
+        return {unique_ptr<LocalSocket>(new LocalSocket(fds[0])), unique_ptr<LocalSocket>(new LocalSocket(fds[1]))};
+    }
+
+    ~LocalSocket()
+    {
+        close();
+    }
+
+    LocalSocket(const LocalSocket &) = delete;
+    LocalSocket &operator=(const LocalSocket &) = delete;
+
+    /**
+     * Wait for a connection on a listening socket.
+     * @return The connection, nullptr once the socket was shut down.
+     */
+    unique_ptr<LocalSocket> accept()
+    {
+        while (true)
+        {
+            int client = ::accept(fd, nullptr, nullptr);
+            if (client >= 0)
+            {
+                return unique_ptr<LocalSocket>(new LocalSocket(client));
+            }
+            if (errno != EINTR)
+            {
+                return nullptr;
+            }
+        }
+    }
+
+    /**
+     * Read the next line, without the newline.
+     * @param line Receives the line.
+     * @return False at the end of the stream.
+     */
+    bool readLine(string &line)
+    {
+        while (true)
+        {
+            size_t end = buffer.find('\n', start);
+            if (end != string::npos)
+            {
+                line.assign(buffer, start, end - start);
+                start = end + 1;
+                return true;
+            }
+            buffer.erase(0, start);
+            start = 0;
+            char chunk[4096];
+            ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                return false;
+            }
+            buffer.append(chunk, static_cast<size_t>(n));
+        }
+    }
+
+    /**
+     * Check if a whole line is already buffered, poll does not see it.
+     * @return True if the next readLine returns without reading from the socket.
+     */
+    bool hasLine() const
+    {
+        return buffer.find('\n', start) != string::npos;
+    }
+
+    /**
+     * Send a line, a newline is appended.
+     * @param line The line.
+     * @return False if the peer is gone.
+     */
+    bool writeLine(const string &line)
+    {
+        string data = line + '\n';
+        lock_guard<mutex> guard(writeLock);
+        size_t sent = 0;
+        while (sent < data.size())
+        {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    /**
+     * Stop reading and writing, a blocked accept or readLine returns.
+     */
+    void shutdown()
+    {
+        ::shutdown(fd, SHUT_RDWR);
+    }
+
+    void close()
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    /**
+     * Get the file descriptor, e.g. to wait for several sockets with poll.
+     * @return The descriptor, -1 once closed.
+     */
+    int descriptor() const
+    {
+        return fd;
+    }
+
+private:
+    int fd;
+    string buffer;
+    size_t start = 0;
+    mutex writeLock;
+
+    explicit LocalSocket(int fd_) : fd(fd_)
+    {
+    }
+
+    static int open(const string &path)
+    {
+        if (path.size() >= sizeof(sockaddr_un::sun_path))
+        {
+            throw invalid_argument("Socket path too long: " + path);
+        }
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+        {
+            throw runtime_error(string("Cannot create socket: ") + strerror(errno));
+        }
+        return fd;
+    }
+
+    static sockaddr_un addressOf(const string &path)
+    {
+        sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return address;
+    }
+};
+
+#endif // LOCAL_SOCKET_H
@@ -0,0 +1,123 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include "include.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAPPED_FILE_MMAP 1
+#else
+#define MAPPED_FILE_MMAP 0
+#endif
+
+/**
+ * Read-only view of a whole file, memory-mapped where the system supports it and read into memory otherwise.
+ * Mapped pages are shared with the page cache, so opening a large file costs nothing until it is read.
+ */
+class MappedFile
+{
+public:
+    /**
+     * Access pattern hint for the mapped pages
+     */
+    enum Access
+    {
+        NORMAL,
+        SEQUENTIAL,
+        RANDOM
+    };
+
+    /**
+     * Constructor for the MappedFile class.
+     * @param path The file.
+     * @param access How the file will be read.
+     */
+    explicit MappedFile(const string &path, Access access = NORMAL)
+    {
+#if MAPPED_FILE_MMAP
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw runtime_error("Cannot open " + path);
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            ::close(fd);
+            throw runtime_error("Cannot read " + path);
+        }
+        bytes = static_cast<size_t>(st.st_size);
+        if (bytes > 0)
+        {
+            void *map = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (map == MAP_FAILED)
+            {
+                throw runtime_error("Cannot map " + path);
+            }
+            bytesData = static_cast<const uint8_t *>(map);
+            if (access != NORMAL)
+            {
+                madvise(map, bytes, access == SEQUENTIAL ? MADV_SEQUENTIAL : MADV_RANDOM);
+            }
+        }
+        else
+        {
+            ::close(fd);
+        }
+#else
+        (void)access;
+        ifstream in(path, ios::binary);
+        if (!in)
+        {
+            throw runtime_error("Cannot open " + path);
+        }
+        storage.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        bytesData = storage.data();
+        bytes = storage.size();
+#endif
+    }
+
+    ~MappedFile()
+    {
+#if MAPPED_FILE_MMAP
+        if (bytesData)
+        {
+            munmap(const_cast<uint8_t *>(bytesData), bytes);
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /**
+     * Get the contents of the file.
+     * @return The first byte, nullptr for an empty file.
+     */
+    const uint8_t *data() const
+    {
+        return bytesData;
+    }
+
+    /**
+     * Get the size of the file.
+     * @return The number of bytes.
+     */
+    size_t size() const
+    {
+        return bytes;
+    }
+
+private:
+    const uint8_t *bytesData = nullptr;
+    size_t bytes = 0;
+#if !MAPPED_FILE_MMAP
+    vector<uint8_t> storage;
+#endif
+};
+
+#endif // MAPPED_FILE_H
@@ -13,8 +13,276 @@ struct TileMetrics
     bool enablesOpponentThreat;
 };
 
-class Metrics
+/**
+ * Bounded cache for tile metrics, keyed by position, move and player.
+ * The cache is set associative; every set holds WAYS entries and evicts with the clock (second chance) policy.
+ */
+class MetricsCache
 {
+public:
+    /**
+     * Number of entries per set
+     */
+    static constexpr size_t WAYS = 4;
+
+    /**
+     * Hit/miss counters of the cache
+     */
+    struct Stats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t insertions = 0;
+        uint64_t evictions = 0;
+
+        /**
+         * Get the fraction of lookups that were served from the cache.
+         * @return The hit rate between 0 and 1.
+         */
+        double hitRate() const
+        {
+            uint64_t lookups = hits + misses;
+            return lookups == 0 ? 0.0 : static_cast<double>(hits) / lookups;
+        }
+    };
+
+    /**
+     * Constructor for the MetricsCache class.
+     * @param capacity The maximum number of entries, rounded up to a power of two.
+     */
+    explicit MetricsCache(size_t capacity = 1 << 16)
+    {
+        resize(capacity);
+    }
+
+    /**
+     * Resize the cache, this drops all stored entries.
+     * @param capacity The maximum number of entries, rounded up to a power of two.
+     */
+    void resize(size_t capacity)
+    {
+        size_t sets = 1;
+        while (sets * WAYS < capacity)
+        {
+            sets <<= 1;
+        }
+        entries.assign(sets * WAYS, Entry{});
+        clock.assign(sets, 0);
+        setMask = sets - 1;
+    }
+
+    /**
+     * Remove all entries, the statistics are kept.
+     */
+    void clear()
+    {
+        fill(entries.begin(), entries.end(), Entry{});
+        fill(clock.begin(), clock.end(), 0);
+    }
+
+    /**
+     * Look up the metrics of a tile.
+     * @param position The key of the position (see Connect4Board::key).
+     * @param column The column of the tile.
+     * @param player The player the metrics are computed for.
+     * @param row The row of the tile.
+     * @param metrics Receives the cached metrics on a hit.
+     * @return True on a hit, false otherwise.
+     */
+    bool lookup(uint64_t position, int column, Player player, int row, TileMetrics &metrics)
+    {
+        uint32_t tag = makeTag(column, player, row);
+        size_t set = indexOf(position, tag);
+        Entry *ways = &entries[set * WAYS];
+
+        for (size_t way = 0; way < WAYS; ++way)
+        {
+            if (ways[way].tag == tag && ways[way].position == position)
+            {
+                clock[set] |= uint8_t(1u << way);
+                metrics = unpack(ways[way].packed);
+                ++stats.hits;
+                return true;
+            }
+        }
+        ++stats.misses;
+        return false;
+    }
+
+    /**
+     * Store the metrics of a tile, evicting an entry of the set when it is full.
+     * @param position The key of the position (see Connect4Board::key).
+     * @param column The column of the tile.
+     * @param player The player the metrics are computed for.
+     * @param row The row of the tile.
+     * @param metrics The metrics to store.
+     */
+    void insert(uint64_t position, int column, Player player, int row, const TileMetrics &metrics)
+    {
+        uint32_t tag = makeTag(column, player, row);
+        size_t set = indexOf(position, tag);
+        Entry *ways = &entries[set * WAYS];
+
+        uint8_t referenced = clock[set] & 0x0F;
+        size_t hand = clock[set] >> 4;
+        size_t victim = WAYS;
+
+        for (size_t way = 0; way < WAYS; ++way)
+        {
+            if (ways[way].tag == 0)
+            {
+                victim = way;
+                break;
+            }
+        }
+        if (victim == WAYS)
+        {
+            // clock sweep: give every referenced entry a second chance
+            while (referenced & (1u << hand))
+            {
+                referenced &= ~uint8_t(1u << hand);
+                hand = (hand + 1) % WAYS;
+            }
+            victim = hand;
+            hand = (hand + 1) % WAYS;
+            ++stats.evictions;
+        }
+
+        ways[victim] = Entry{position, tag, pack(metrics)};
+        referenced |= uint8_t(1u << victim);
+        clock[set] = uint8_t((hand << 4) | referenced);
+        ++stats.insertions;
+    }
+
+    /**
+     * Get the statistics of the cache.
+     * @return The hit/miss counters.
+     */
+    const Stats &getStats() const
+    {
+        return stats;
+    }
+
+    /**
+     * Reset the statistics of the cache.
+     */
+    void resetStats()
+    {
+        stats = Stats();
+    }
+
+    /**
+     * Get the maximum number of entries.
+     * @return The capacity of the cache.
+     */
+    size_t capacity() const
+    {
+        return entries.size();
+    }
+
+    /**
+     * Print the statistics of the cache.
+     */
+    void printStats() const
+    {
+        cout << "Metrics cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+             << stats.evictions << " evictions, hit rate " << stats.hitRate() * 100.0 << "%" << endl;
+    }
+
+    /**
+     * Pack TileMetrics into 32 bits.
+     * Layout: pressure (8 bits), winOptions (8 bits), preferredWinningRow (8 bits), 4 flags.
+     * The integer fields are stored with an offset of 1 so -1 fits.
+     * @param metrics The metrics to pack.
+     * @return The packed metrics.
+     */
+    static uint32_t pack(const TileMetrics &metrics)
+    {
+        return uint32_t(uint8_t(metrics.pressure + 1)) |
+               uint32_t(uint8_t(metrics.winOptions + 1)) << 8 |
+               uint32_t(uint8_t(metrics.preferredWinningRow + 1)) << 16 |
+               uint32_t(metrics.immediateThreat) << 24 |
+               uint32_t(metrics.minorThreat) << 25 |
+               uint32_t(metrics.winningMove) << 26 |
+               uint32_t(metrics.enablesOpponentThreat) << 27;
+    }
+
+    /**
+     * Unpack TileMetrics packed with pack().
+     * @param packed The packed metrics.
+     * @return The unpacked metrics.
+     */
+    static TileMetrics unpack(uint32_t packed)
+    {
+        return TileMetrics{
+            int(packed & 0xFF) - 1,
+            int((packed >> 8) & 0xFF) - 1,
+            ((packed >> 24) & 1) != 0,
+            ((packed >> 25) & 1) != 0,
+            ((packed >> 26) & 1) != 0,
+            int((packed >> 16) & 0xFF) - 1,
+            ((packed >> 27) & 1) != 0};
+    }
+
+private:
+    /**
+     * A single cache entry, a tag of 0 marks an empty entry.
+     */
+    struct Entry
+    {
+        uint64_t position = 0;
+        uint32_t tag = 0;
+        uint32_t packed = 0;
+    };
+
+    vector<Entry> entries;
+
+    /**
+     * Clock state per set: the low 4 bits are the referenced flags, the high 4 bits the clock hand.
+     */
+    vector<uint8_t> clock;
+
+    size_t setMask = 0;
+
+    Stats stats;
+
+    static_assert(WAYS <= 4, "The clock state only holds 4 referenced flags");
+
+    /**
+     * Combine column, player and row into a non-zero tag.
+     */
+    static uint32_t makeTag(int column, Player player, int row)
+    {
+        return 0x80000000u | uint32_t(uint8_t(column + 1)) | uint32_t(player) << 8 | uint32_t(uint8_t(row + 1)) << 16;
+    }
+
+    /**
+     * Get the set index for a position and tag.
+     */
+    size_t indexOf(uint64_t position, uint32_t tag) const
+    {
+        uint64_t h = position ^ (uint64_t(tag) << 40) ^ tag;
+        // splitmix64 finalizer
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        return static_cast<size_t>(h) & setMask;
+    }
+};
+
+template <typename Board>
+class BasicMetrics
+{
+public:
+    /**
+     * Dimensions and win length of the board the metrics are computed for
+     */
+    static constexpr int ROWS = Board::ROWS;
+    static constexpr int COLS = Board::COLS;
+    static constexpr int WIN = Board::WIN;
+
 private:
     /**
      * Direction vectors for 4 and 8 directions
@@ -32,20 +300,58 @@ private:
         {1, -1} // diagonal down-left
     };
 
+    /**
+     * Count the lines of WIN cells through a tile that hold no opponent discs
+     * @param board The current state of the board
+     * @param opponent The opponent of the current player
+     * @param r_play The row index of the tile
+     * @param column The column index of the tile
+     * @return The number of open lines
+     */
+    static int countOpenLines(
+        const Board &board,
+        Player opponent,
+        int r_play,
+        int column)
+    {
+        const auto &cell = Board::CELLLINES[r_play * COLS + column];
+        uint64_t opp = board.playerBits(opponent);
+
+        int count = 0;
+        for (int i = 0; i < cell.count; ++i)
+        {
+            if (!(cell.lines[i] & opp))
+            {
+                ++count;
+            }
+        }
+        return count;
+    }
+
 public:
+    /**
+     * Per-column results of the layer metrics, stored on the stack
+     */
+    using ColumnValues = array<int, Board::COLS>;
+    using ColumnFlags = array<bool, Board::COLS>;
+
     /**
      * Count the pressure sum for each column
      * @param board The current state of the board
      * @param player The current player
-     * @return A vector of pressure values for each column
+     * @return The pressure values for each column
      */
-    static vector<int> countPressureSum(
-        Connect4Board &board,
+    static ColumnValues countPressureSum(
+        Board &board,
         Player player)
     {
         Player opponent = board.getOponent(player);
 
-        vector<int> pressure(board.COLS, -1);
+        ColumnValues pressure;
+        pressure.fill(-1);
+
+        uint64_t own = board.playerBits(player);
+        uint64_t opp = board.playerBits(opponent);
 
         for (int column = 0; column < board.COLS; ++column)
         {
@@ -56,57 +362,14 @@ public:
                 continue;
             }
 
+            // every line through the tile without opponent discs adds the own discs on it
+            const auto &cell = Board::CELLLINES[r_play * COLS + column];
             int sumTiles = 0;
-            for (int dir = 0; dir < 4; ++dir)
+            for (int i = 0; i < cell.count; ++i)
             {
-                for (int off = 0; off < 4; ++off)
+                if (!(cell.lines[i] & opp))
                 {
-                    int sr = r_play - dr4[dir] * off;
-                    int sc = column - dc4[dir] * off;
-
-                    bool ok = true;
-                    for (int i = 0; i < 4; ++i)
-                    {
-                        int rr = sr + dr4[dir] * i;
-                        int cc = sc + dc4[dir] * i;
-                        if (rr < 0 || rr >= board.ROWS ||
-                            cc < 0 || cc >= board.COLS ||
-                            board.getCell(rr, cc) == opponent)
-                        {
-                            ok = false;
-                            break;
-                        }
-                    }
-                    if (!ok)
-                    {
-                        continue;
-                    }
-                    bool covers = false;
-                    for (int i = 0; i < 4; ++i)
-                    {
-                        if (sr + dr4[dir] * i == r_play && sc + dc4[dir] * i == column)
-                        {
-                            covers = true;
-                            break;
-                        }
-                    }
-                    if (!covers)
-                    {
-                        continue;
-                    }
-                    int ownCount = 0;
-                    for (int i = 0; i < 4; ++i)
-                    {
-                        int rr = sr + dr4[dir] * i;
-                        int cc = sc + dc4[dir] * i;
-                        if (rr == r_play && cc == column)
-                        {
-                            continue;
-                        }
-                        if (board.getCell(rr, cc) == player)
-                            ++ownCount;
-                    }
-                    sumTiles += ownCount;
+                    sumTiles += __builtin_popcountll(cell.lines[i] & own);
                 }
             }
 
@@ -119,15 +382,16 @@ public:
      * Count the number of winning options for each column
      * @param board The current state of the board
      * @param player The current player
-     * @return A vector of win option counts for each column, returning -1 for full columns
+     * @return The win option counts for each column, returning -1 for full columns
      */
-    static vector<int> countWinOptions(
-        Connect4Board &board,
+    static ColumnValues countWinOptions(
+        Board &board,
         Player player)
     {
         Player opponent = board.getOponent(player);
 
-        vector<int> result(board.COLS, -1);
+        ColumnValues result;
+        result.fill(-1);
 
         for (int column = 0; column < board.COLS; ++column)
         {
@@ -138,45 +402,7 @@ public:
                 continue;
             }
 
-            int count = 0;
-            for (int dir = 0; dir < 4; ++dir)
-            {
-                for (int off = 0; off < 4; ++off)
-                {
-                    int sr = r_play - dr4[dir] * off;
-                    int sc = column - dc4[dir] * off;
-
-                    bool valid = true;
-                    for (int k = 0; k < 4; ++k)
-                    {
-                        int rr = sr + dr4[dir] * k;
-                        int cc = sc + dc4[dir] * k;
-                        if (!board.inBoard(rr, cc) || board.getCell(rr, cc) == opponent)
-                        {
-                            valid = false;
-                            break;
-                        }
-                    }
-                    if (!valid)
-                    {
-                        continue;
-                    }
-                    bool covers = false;
-                    for (int k = 0; k < 4; ++k)
-                    {
-                        if (sr + dr4[dir] * k == r_play && sc + dc4[dir] * k == column)
-                        {
-                            covers = true;
-                            break;
-                        }
-                    }
-                    if (!covers)
-                    {
-                        continue;
-                    }
-                    ++count;
-                }
-            }
+            int count = countOpenLines(board, opponent, r_play, column);
 
             result[column] = count;
         }
@@ -188,15 +414,16 @@ public:
      * Compute immediate threats for the current player
      * @param board The current state of the board
      * @param player The current player
-     * @return A vector of booleans indicating immediate threats for each column
+     * @return Booleans indicating immediate threats for each column
      */
-    static vector<bool> computeImmediateThreats(
-        Connect4Board &board,
+    static ColumnFlags computeImmediateThreats(
+        Board &board,
         Player player)
     {
         Player opponent = board.getOponent(player);
 
-        vector<bool> threat(board.COLS, false);
+        ColumnFlags threat;
+        threat.fill(false);
 
         for (int column = 0; column < board.COLS; ++column)
         {
@@ -206,7 +433,7 @@ public:
                 threat[column] = false;
                 continue;
             }
-            Connect4Board copy = board;
+            Board copy = board;
             copy.setCell(row, column, opponent);
             if (copy.checkWin(opponent))
             {
@@ -221,15 +448,16 @@ public:
      * Compute minor threats for the current player
      * @param board The current state of the board
      * @param player The current player
-     * @return A vector of booleans indicating minor threats for each column
+     * @return Booleans indicating minor threats for each column
      */
-    static vector<bool> computeMinorThreats(
-        Connect4Board &board,
+    static ColumnFlags computeMinorThreats(
+        Board &board,
         Player player)
     {
         Player opponent = board.getOponent(player);
 
-        vector<bool> result(board.COLS, false);
+        ColumnFlags result;
+        result.fill(false);
 
         for (int column = 0; column < board.COLS; column++)
         {
@@ -242,7 +470,7 @@ public:
 
             for (int dir = 0; dir < 4 && !isMinor; dir++)
             {
-                for (int off = 0; off < 4 && !isMinor; off++)
+                for (int off = 0; off < WIN && !isMinor; off++)
                 {
                     int sr = r_play - dr4[dir] * off;
                     int sc = column - dc4[dir] * off;
@@ -252,7 +480,7 @@ public:
                     }
                     int countOp = 0, countEmp = 0, countMe = 0;
                     bool covers = false;
-                    for (int k = 0; k < 4; k++)
+                    for (int k = 0; k < WIN; k++)
                     {
                         int rr = sr + dr4[dir] * k,
                             cc = sc + dc4[dir] * k;
@@ -280,7 +508,7 @@ public:
                             countMe++;
                         }
                     }
-                    if (covers && countOp == 2 && countMe == 0 && countEmp == 2)
+                    if (covers && countOp == WIN - 2 && countMe == 0 && countEmp == 2)
                     {
                         isMinor = true;
                     }
@@ -311,13 +539,14 @@ public:
      * Compute winning moves for the current player
      * @param board The current state of the board
      * @param player The current player
-     * @return A vector of booleans indicating winning moves for each column
+     * @return Booleans indicating winning moves for each column
      */
-    static vector<bool> computeWinningMoves(
-        Connect4Board board,
+    static ColumnFlags computeWinningMoves(
+        Board board,
         Player player)
     {
-        vector<bool> result(board.COLS, false);
+        ColumnFlags result;
+        result.fill(false);
 
         for (int column = 0; column < board.COLS; column++)
         {
@@ -346,7 +575,7 @@ public:
                         cc += dc4[dir] * dsign;
                     }
                 }
-                if (count >= 4)
+                if (count >= WIN)
                     win = true;
             }
 
@@ -359,7 +588,9 @@ public:
     }
 
     /**
-     * Get the "pressure" for a single empty cell at (r_play, column)
+     * Get the "pressure" for a single empty cell at (r_play, column):
+     * the own discs within reach to the left, right, below and on both lower diagonals.
+     * Both horizontal directions count, so a cell and its mirror image get the same pressure.
      * @param board The current state of the board
      * @param player The current player
      * @param r_play The row index of the tile to analyze
@@ -367,7 +598,7 @@ public:
      * @return The pressure value, or -1 if (r_play,column) is off-board.
      */
     static int getTilePressure(
-        const Connect4Board &board,
+        const Board &board,
         Player player,
         int r_play,
         Column column)
@@ -380,12 +611,16 @@ public:
         }
         int sum = 0;
 
-        for (int dir = 0; dir < 4; ++dir)
+        for (int dir = 0; dir < 8; ++dir)
         {
-            for (int step = 1; step < 4; ++step)
+            if (dr8[dir] < 0)
+            {
+                continue;
+            }
+            for (int step = 1; step < WIN; ++step)
             {
-                int rr = r_play + dr4[dir] * step;
-                int cc = column + dc4[dir] * step;
+                int rr = r_play + dr8[dir] * step;
+                int cc = column + dc8[dir] * step;
                 if (!board.inBoard(rr, cc))
                 {
                     break;
@@ -417,7 +652,7 @@ public:
      * @return True if the tile is a winning move, false otherwise
      */
     static int getTileWinOptions(
-        const Connect4Board &board,
+        const Board &board,
         Player player,
         int r_play,
         int column)
@@ -429,47 +664,7 @@ public:
             return -1;
         }
 
-        int count = 0;
-
-        for (int dir = 0; dir < 4; ++dir)
-        {
-            for (int off = 0; off < 4; ++off)
-            {
-                int sr = r_play - dr4[dir] * off;
-                int sc = column - dc4[dir] * off;
-
-                bool valid = true;
-                for (int k = 0; k < 4; ++k)
-                {
-                    int rr = sr + dr4[dir] * k;
-                    int cc = sc + dc4[dir] * k;
-                    if (!board.inBoard(rr, cc) || board.getCell(rr, cc) == opponent)
-                    {
-                        valid = false;
-                        break;
-                    }
-                }
-                if (!valid)
-                {
-                    continue;
-                }
-                bool covers = false;
-                for (int k = 0; k < 4; ++k)
-                {
-                    if (sr + dr4[dir] * k == r_play &&
-                        sc + dc4[dir] * k == column)
-                    {
-                        covers = true;
-                        break;
-                    }
-                }
-                if (!covers)
-                {
-                    continue;
-                }
-                ++count;
-            }
-        }
+        int count = countOpenLines(board, opponent, r_play, column);
 
         return count;
     }
@@ -483,7 +678,7 @@ public:
      * @return True if the tile is a threat, false otherwise
      */
     static bool getTileThreat(
-        const Connect4Board &board,
+        const Board &board,
         Player player,
         int r_play,
         Column column)
@@ -496,7 +691,7 @@ public:
             return false;
         }
 
-        Connect4Board copy = board;
+        Board copy = board;
         copy.setCell(r_play, column, opponent);
         return copy.checkWin(opponent);
     }
@@ -510,7 +705,7 @@ public:
      * @return True if the tile is a minor threat, false otherwise
      */
     static bool getTileMinorThreat(
-        const Connect4Board &board,
+        const Board &board,
         Player player,
         int r_play,
         int column)
@@ -525,7 +720,7 @@ public:
 
         for (int dir = 0; dir < 4; ++dir)
         {
-            for (int off = 0; off < 4; ++off)
+            for (int off = 0; off < WIN; ++off)
             {
                 int sr = r_play - dr4[dir] * off;
                 int sc = column - dc4[dir] * off;
@@ -535,7 +730,7 @@ public:
                 int oppCount = 0;
                 bool windowOK = true;
 
-                for (int k = 0; k < 4; ++k)
+                for (int k = 0; k < WIN; ++k)
                 {
                     int rr = sr + dr4[dir] * k;
                     int cc = sc + dc4[dir] * k;
@@ -560,21 +755,25 @@ public:
                         break;
                     }
                 }
-                if (!windowOK || !covers || oppCount != 2)
+                if (!windowOK || !covers || oppCount != WIN - 2)
                 {
                     continue;
                 }
 
-                int r1 = sr + dr4[dir] * 1, c1 = sc + dc4[dir] * 1;
-                int r2 = sr + dr4[dir] * 2, c2 = sc + dc4[dir] * 2;
-                if (board.getCell(r1, c1) == opponent &&
-                    board.getCell(r2, c2) == opponent)
+                // the opponent discs have to fill the inside of the window, leaving both ends open
+                bool inside = true;
+                for (int k = 1; k < WIN - 1; ++k)
                 {
-                    if (coverIndex == 0 || coverIndex == 3)
+                    if (board.getCell(sr + dr4[dir] * k, sc + dc4[dir] * k) != opponent)
                     {
-                        return true;
+                        inside = false;
+                        break;
                     }
                 }
+                if (inside && (coverIndex == 0 || coverIndex == WIN - 1))
+                {
+                    return true;
+                }
             }
         }
 
@@ -590,7 +789,7 @@ public:
      * @return True if the tile is a winning move, false otherwise
      */
     static bool getTileWinningMove(
-        const Connect4Board &board,
+        const Board &board,
         Player player,
         int r_play,
         Column column)
@@ -601,18 +800,29 @@ public:
             return false;
         }
 
-        Connect4Board copy = board;
+        Board copy = board;
         copy.setCell(r_play, column, player);
         return copy.checkWin(player);
     }
 
+    /**
+     * Get the lowest playable row that completes a line of WIN - 1 discs through the tile
+     * Every direction is checked and the lowest row wins, so the result does not depend
+     * on the direction order and a cell and its mirror image get the same row.
+     * @param board The current state of the board
+     * @param row The row index of the tile to analyze
+     * @param col The column index of the tile to analyze
+     * @param player The current player
+     * @return The row index, or -1 if there is none
+     */
     static int getTilePreferredWinningRow(
-        const Connect4Board &board,
+        const Board &board,
         int row,
         Column col,
         Player player)
     {
-        const int requiredToWin = 4;
+        const int requiredToWin = WIN;
+        int preferred = -1;
 
         for (int d = 0; d < 4; ++d)
         {
@@ -620,7 +830,8 @@ public:
             int dc = DIRECTIONS[d][1];
 
             int count = 1;
-            vector<pair<int, int>> positions;
+            array<pair<int, int>, 2> positions;
+            int positionCount = 0;
 
             for (int i = 0; i < requiredToWin; ++i)
             {
@@ -637,7 +848,7 @@ public:
                 }
                 else if (cell == Player::EMPTY)
                 {
-                    positions.push_back({r, c});
+                    positions[positionCount++] = {r, c};
                     break;
                 }
                 else
@@ -661,7 +872,7 @@ public:
                 }
                 else if (cell == Player::EMPTY)
                 {
-                    positions.push_back({r, c});
+                    positions[positionCount++] = {r, c};
                     break;
                 }
                 else
@@ -670,60 +881,42 @@ public:
                 }
             }
 
-            if (count == 3)
+            if (count == WIN - 1)
             {
-                for (auto &pos : positions)
+                for (int i = 0; i < positionCount; ++i)
                 {
-                    int r = pos.first;
-                    int c = pos.second;
+                    int r = positions[i].first;
+                    int c = positions[i].second;
 
-                    if (board.getCell(r + 1, c) != Player::EMPTY || r == board.ROWS - 1)
+                    if (r == board.ROWS - 1 || board.getCell(r + 1, c) != Player::EMPTY)
                     {
-                        return r;
+                        preferred = max(preferred, r);
                     }
                 }
             }
         }
 
-        return -1;
+        return preferred;
     }
 
+    /**
+     * Check if playing the given column lets the opponent win on the next move
+     * @param board The current state of the board
+     * @param move The column the player plays
+     * @param botPlayer The player making the move
+     * @return True if the opponent can win immediately after the move, false otherwise
+     */
     static bool getTileEnablesOpponentThreat(
-        const Connect4Board &board,
+        const Board &board,
         Column move,
         Player botPlayer)
     {
-        Player opponent = board.getOponent(botPlayer);
-        Connect4Board simBoard = board;
-
-        int row = simBoard.findRow(move);
-        if (row < 0)
+        if (!board.columnHasSpace(move))
         {
             return false;
         }
 
-        simBoard.setCell(row, move, botPlayer);
-
-        vector<Column> replyMoves = simBoard.getPossibleMoves();
-        for (Column reply : replyMoves)
-        {
-            int r = simBoard.findRow(reply);
-            if (r < 0)
-            {
-                continue;
-            }
-            simBoard.setCell(r, reply, opponent);
-            bool isThreat = getTileThreat(simBoard, opponent, r, reply);
-
-            simBoard.setCell(r, reply, Player::EMPTY); // undo
-
-            if (isThreat)
-            {
-                return true; // the bot move enables an immediate threat
-            }
-        }
-
-        return false;
+        return !(board.nonLosingColumns(botPlayer) & (1u << move));
     }
 
     /**
@@ -735,14 +928,30 @@ public:
      * @return A TileMetrics object containing various metrics for the tile
      */
     static TileMetrics generateMetricsForTile(
-        Connect4Board &board,
+        Board &board,
         Player player,
         int r_play,
         Column column,
         bool debug = false)
     {
+        BoundsCheck::check(0, column, board.ROWS, board.COLS, "Metrics::generateMetricsForTile: column out of range");
+
         TileMetrics metrics = {-1, -1, false, false, false, -1, false};
 
+        uint64_t position = 0;
+        if (useCache)
+        {
+            position = board.key();
+            if (cache().lookup(position, column, player, r_play, metrics))
+            {
+                if (debug)
+                {
+                    printTileMetrics(board, player, r_play, column, metrics);
+                }
+                return metrics;
+            }
+        }
+
         // Get the pressure for the tile
         metrics.pressure = getTilePressure(board, player, r_play, column);
 
@@ -764,35 +973,75 @@ public:
         // Get if the tile enables an opponent threat
         metrics.enablesOpponentThreat = getTileEnablesOpponentThreat(board, column, player);
 
+        if (useCache)
+        {
+            cache().insert(position, column, player, r_play, metrics);
+        }
+
         if (debug)
         {
-            cout << "Metrics for tile (" << board.ROWS - r_play << ", " << Connect4Board::colToChar(column) << "): "
-                 << "Owner: " << (player == Connect4Board::BOT ? "BOT" : "USER")
-                 << ", Pressure: " << metrics.pressure
-                 << ", Win Options: " << metrics.winOptions
-                 << ", Immediate Threat: " << (metrics.immediateThreat ? "Yes" : "No")
-                 << ", Minor Threat: " << (metrics.minorThreat ? "Yes" : "No")
-                 << ", Winning Move: " << (metrics.winningMove ? "Yes" : "No")
-                 << ", Preferred Winning Row: " << metrics.preferredWinningRow
-                 << endl;
+            printTileMetrics(board, player, r_play, column, metrics);
         }
 
         return metrics;
     }
 
-    static array<TileMetrics, 7> generateMetricsForLayer(
-        Connect4Board &board,
+    /**
+     * Print the metrics of a tile.
+     * @param board The current state of the board
+     * @param player The current player
+     * @param r_play The row index of the tile
+     * @param column The column index of the tile
+     * @param metrics The metrics of the tile
+     */
+    static void printTileMetrics(
+        const Board &board,
+        Player player,
+        int r_play,
+        Column column,
+        const TileMetrics &metrics)
+    {
+        cout << "Metrics for tile (" << board.ROWS - r_play << ", " << Board::colToChar(column) << "): "
+             << "Owner: " << (player == Board::BOT ? "BOT" : "USER")
+             << ", Pressure: " << metrics.pressure
+             << ", Win Options: " << metrics.winOptions
+             << ", Immediate Threat: " << (metrics.immediateThreat ? "Yes" : "No")
+             << ", Minor Threat: " << (metrics.minorThreat ? "Yes" : "No")
+             << ", Winning Move: " << (metrics.winningMove ? "Yes" : "No")
+             << ", Preferred Winning Row: " << metrics.preferredWinningRow
+             << endl;
+    }
+
+    /**
+     * If true, generateMetricsForTile memoizes its results in the metrics cache
+     */
+    static inline bool useCache = true;
+
+    /**
+     * Get the metrics cache of the calling thread.
+     * Every thread owns its own cache, so lookups never need a lock.
+     * @return The metrics cache.
+     */
+    static MetricsCache &cache()
+    {
+        static thread_local MetricsCache instance;
+        return instance;
+    }
+
+    static array<TileMetrics, COLS> generateMetricsForLayer(
+        Board &board,
         Player player)
     {
-        vector<int> pressure = countPressureSum(board, player);
-        vector<int> winOptions = countWinOptions(board, player);
-        vector<bool> threats = computeImmediateThreats(board, player);
-        vector<bool> minorThreats = computeMinorThreats(board, player);
-        vector<bool> winMoves = computeWinningMoves(board, player);
+        TRACE_SCOPE("Metrics::generateMetricsForLayer");
+        ColumnValues pressure = countPressureSum(board, player);
+        ColumnValues winOptions = countWinOptions(board, player);
+        ColumnFlags threats = computeImmediateThreats(board, player);
+        ColumnFlags minorThreats = computeMinorThreats(board, player);
+        ColumnFlags winMoves = computeWinningMoves(board, player);
 
-        array<TileMetrics, 7> metrics;
+        array<TileMetrics, COLS> metrics;
 
-        for (int col = 0; col < 7; ++col)
+        for (int col = 0; col < COLS; ++col)
         {
             metrics[col] = TileMetrics{
                 pressure[col],
@@ -808,4 +1057,10 @@ public:
         return metrics;
     }
 };
+
+/**
+ * Metrics for the classic 6 x 7 board
+ */
+using Metrics = BasicMetrics<Connect4Board>;
+
 #endif // METRICS_H
@@ -23,6 +23,20 @@ public:
         history.emplace_back(player, column, moveNumber);
     }
 
+    /**
+     * Forget the last recorded move.
+     * @return False if no move was recorded.
+     */
+    bool undoMove()
+    {
+        if (history.empty())
+        {
+            return false;
+        }
+        history.pop_back();
+        return true;
+    }
+
     void clear()
     {
         history.clear();
@@ -33,6 +47,27 @@ public:
         return history;
     }
 
+    /**
+     * Append the recorded game to a binary game log.
+     * @param log The log.
+     * @param level The level of the bot, GameLog::NOLEVEL if none.
+     * @param result The outcome of the game.
+     */
+    void save(GameLogWriter &log, uint8_t level, GameLog::Result result) const
+    {
+        vector<Column> columns;
+        columns.reserve(history.size());
+        for (size_t i = 0; i < history.size(); ++i)
+        {
+            if (i > 0 && history[i].player == history[i - 1].player)
+            {
+                throw runtime_error("Cannot log a game where a player moved twice in a row");
+            }
+            columns.push_back(history[i].column);
+        }
+        log.append(history.empty() ? Player::EMPTY : history.front().player, level, result, columns);
+    }
+
     void print() const
     {
         for (size_t i = 0; i < history.size(); ++i)
@@ -0,0 +1,176 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include "include.h"
+
+/**
+ * Pool allocator for objects of type T.
+ * Memory is carved out of large slabs and recycled through free lists, so creating and deleting
+ * objects does not touch the heap once the pool is warm.
+ * Every thread allocates from its own free list; blocks move in batches between the threads and a shared
+ * free list, so objects may be deleted on a different thread than the one that created them.
+ */
+template <typename T>
+class NodePool
+{
+public:
+    /**
+     * Number of blocks allocated at once when the pool runs dry
+     */
+    static constexpr size_t SLABBLOCKS = 4096;
+
+    /**
+     * Number of blocks moved between a thread and the shared free list at once
+     */
+    static constexpr size_t BATCH = 256;
+
+    /**
+     * Get a block big enough for one T.
+     * @return Pointer to uninitialized memory.
+     */
+    static void *allocate()
+    {
+        Local &l = local();
+        if (!l.head)
+        {
+            refill(l);
+        }
+        FreeBlock *block = l.head;
+        l.head = block->next;
+        --l.count;
+        return block;
+    }
+
+    /**
+     * Return a block obtained from allocate().
+     * @param p The block to return.
+     */
+    static void deallocate(void *p)
+    {
+        if (!p)
+        {
+            return;
+        }
+        Local &l = local();
+        FreeBlock *block = static_cast<FreeBlock *>(p);
+        block->next = l.head;
+        l.head = block;
+        if (++l.count > 2 * BATCH)
+        {
+            release(l, BATCH);
+        }
+    }
+
+    /**
+     * Get the number of bytes reserved from the heap by the pool.
+     * @return The reserved bytes.
+     */
+    static size_t reservedBytes()
+    {
+        Shared &s = shared();
+        lock_guard<mutex> guard(s.lock);
+        return s.slabs.size() * SLABBLOCKS * BLOCKSIZE;
+    }
+
+    /**
+     * Size of a single block
+     */
+    static constexpr size_t BLOCKSIZE = (max(sizeof(T), sizeof(void *)) + alignof(max_align_t) - 1) / alignof(max_align_t) * alignof(max_align_t);
+
+private:
+    struct FreeBlock
+    {
+        FreeBlock *next;
+    };
+
+    struct Shared
+    {
+        mutex lock;
+        FreeBlock *head = nullptr;
+        size_t count = 0;
+        vector<void *> slabs;
+    };
+
+    struct Local
+    {
+        FreeBlock *head = nullptr;
+        size_t count = 0;
+
+        ~Local()
+        {
+            if (count > 0)
+            {
+                release(*this, count);
+            }
+        }
+    };
+
+    /**
+     * Never destroyed: the shared reclaimer may be created before the pool and then still frees nodes during
+     * static destruction, and threads return their free lists when they exit. The slabs go with the process.
+     */
+    static Shared &shared()
+    {
+        static Shared *instance = new Shared;
+        return *instance;
+    }
+
+    static Local &local()
+    {
+        static thread_local Local instance;
+        return instance;
+    }
+
+    /**
+     * Take a batch of blocks from the shared free list, allocating a new slab if it is empty.
+     */
+    static void refill(Local &l)
+    {
+        Shared &s = shared();
+        lock_guard<mutex> guard(s.lock);
+
+        if (!s.head)
+        {
+            char *slab = static_cast<char *>(::operator new(SLABBLOCKS * BLOCKSIZE));
+            s.slabs.push_back(slab);
+            for (size_t i = SLABBLOCKS; i-- > 0;)
+            {
+                FreeBlock *block = reinterpret_cast<FreeBlock *>(slab + i * BLOCKSIZE);
+                block->next = s.head;
+                s.head = block;
+            }
+            s.count += SLABBLOCKS;
+        }
+
+        for (size_t i = 0; i < BATCH && s.head; ++i)
+        {
+            FreeBlock *block = s.head;
+            s.head = block->next;
+            --s.count;
+            block->next = l.head;
+            l.head = block;
+            ++l.count;
+        }
+    }
+
+    /**
+     * Move blocks from a thread back to the shared free list.
+     */
+    static void release(Local &l, size_t amount)
+    {
+        Shared &s = shared();
+        lock_guard<mutex> guard(s.lock);
+
+        for (size_t i = 0; i < amount && l.head; ++i)
+        {
+            FreeBlock *block = l.head;
+            l.head = block->next;
+            --l.count;
+            block->next = s.head;
+            s.head = block;
+            ++s.count;
+        }
+    }
+};
+
+#endif // NODE_POOL_H
@@ -0,0 +1,171 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include "include.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Hardware performance counters of the calling thread, read through Linux perf_event_open.
+ * Every event is opened on its own, so an event the CPU or the VM does not support only drops that event.
+ * On other systems, or when perf_event_paranoid forbids it, no event is available and callers fall back to wall-clock time.
+ */
+class PerfCounters
+{
+public:
+    /**
+     * The counted events
+     */
+    enum Event
+    {
+        CYCLES = 0,
+        INSTRUCTIONS = 1,
+        L1DMISSES = 2,
+        LLCMISSES = 3,
+        BRANCHMISSES = 4,
+        EVENTS = 5
+    };
+
+    /**
+     * A reading of all events, only valid events hold a count.
+     */
+    struct Values
+    {
+        array<double, EVENTS> counts{};
+        array<bool, EVENTS> valid{};
+
+        Values operator-(const Values &other) const
+        {
+            Values d = *this;
+            for (int e = 0; e < EVENTS; ++e)
+            {
+                d.counts[e] -= other.counts[e];
+            }
+            return d;
+        }
+
+        Values &operator+=(const Values &other)
+        {
+            for (int e = 0; e < EVENTS; ++e)
+            {
+                counts[e] += other.counts[e];
+                valid[e] = other.valid[e];
+            }
+            return *this;
+        }
+    };
+
+    /**
+     * Open the counters for the calling thread, user space only.
+     */
+    PerfCounters()
+    {
+        fds.fill(-1);
+#ifdef __linux__
+        const pair<uint32_t, uint64_t> config[EVENTS] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        };
+        for (int e = 0; e < EVENTS; ++e)
+        {
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = config[e].first;
+            attr.config = config[e].second;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds[e] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+#endif
+    }
+
+    ~PerfCounters()
+    {
+#ifdef __linux__
+        for (int fd : fds)
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    /**
+     * Check if at least one event could be opened.
+     * @return True if counters are available.
+     */
+    bool available() const
+    {
+        for (int e = 0; e < EVENTS; ++e)
+        {
+            if (fds[e] >= 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Check if a single event could be opened.
+     * @param e The event.
+     * @return True if the event is counted.
+     */
+    bool available(Event e) const
+    {
+        return fds[e] >= 0;
+    }
+
+    /**
+     * Read all events, scaled up when the kernel had to multiplex them.
+     * @return The current counts.
+     */
+    Values read() const
+    {
+        Values v;
+#ifdef __linux__
+        for (int e = 0; e < EVENTS; ++e)
+        {
+            uint64_t data[3];
+            if (fds[e] < 0 || ::read(fds[e], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)))
+            {
+                continue;
+            }
+            double scale = data[2] > 0 ? static_cast<double>(data[1]) / data[2] : 1.0;
+            v.counts[e] = data[0] * scale;
+            v.valid[e] = true;
+        }
+#endif
+        return v;
+    }
+
+    /**
+     * Get the short name of an event.
+     * @param e The event.
+     * @return The name.
+     */
+    static const char *name(int e)
+    {
+        static constexpr const char *names[EVENTS] = {"cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"};
+        return names[e];
+    }
+
+private:
+    array<int, EVENTS> fds;
+};
+
+#endif // PERF_COUNTERS_H
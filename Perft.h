@@ -0,0 +1,117 @@
+#ifndef PERFT_H
+#define PERFT_H
+
+#include "include.h"
+
+/**
+ * Perft (performance test): counts the positions reachable in an exact number of moves.
+ * A move that wins ends the game, so it counts as a leaf at its own depth but is not extended.
+ * The counts only depend on the rules, so every board implementation has to reproduce them exactly.
+ */
+class Perft
+{
+public:
+    /**
+     * Known perft values of the classic 6 x 7 board from the empty position, indexed by depth.
+     */
+    static constexpr uint64_t CLASSIC[] = {
+        1,
+        7,
+        49,
+        343,
+        2401,
+        16807,
+        117649,
+        823536,
+        5673234,
+        39394572,
+        268031646,
+    };
+
+    /**
+     * Count the leaf positions at the given depth.
+     * @param board The position to start from, restored before returning.
+     * @param player The player to move.
+     * @param depth The number of moves to play.
+     * @return The number of leaf positions.
+     */
+    template <typename Board>
+    static uint64_t count(Board &board, Player player, int depth)
+    {
+        if (depth == 0)
+        {
+            return 1;
+        }
+
+        uint32_t columns = board.possibleColumns();
+        if (depth == 1)
+        {
+            return __builtin_popcount(columns);
+        }
+
+        uint64_t nodes = 0;
+        Player opponent = board.getOponent(player);
+        for (int c = 0; c < Board::COLS; ++c)
+        {
+            if (!(columns & (1u << c)))
+            {
+                continue;
+            }
+            int row = board.findRow(c);
+            bool won = board.dropDisc(static_cast<Column>(c), player);
+            if (!won)
+            {
+                nodes += count(board, opponent, depth - 1);
+            }
+            board.setCell(row, c, Player::EMPTY);
+        }
+        return nodes;
+    }
+
+    /**
+     * Count the leaf positions at the given depth, split per first move.
+     * @param board The position to start from, restored before returning.
+     * @param player The player to move.
+     * @param depth The number of moves to play, at least 1.
+     * @return The count below every possible first move.
+     */
+    template <typename Board>
+    static vector<pair<Column, uint64_t>> divide(Board &board, Player player, int depth)
+    {
+        vector<pair<Column, uint64_t>> result;
+        for (Column column : board.getPossibleMoves())
+        {
+            int row = board.findRow(column);
+            bool won = board.dropDisc(column, player);
+            uint64_t nodes = 1;
+            if (depth > 1)
+            {
+                nodes = won ? 0 : count(board, board.getOponent(player), depth - 1);
+            }
+            board.setCell(row, column, Player::EMPTY);
+            result.push_back({column, nodes});
+        }
+        return result;
+    }
+
+    /**
+     * Get the known perft value of a position, if it is in the table.
+     * @param board The position.
+     * @param depth The depth.
+     * @param expected Receives the known value.
+     * @return True if the value is known, false otherwise.
+     */
+    template <typename Board>
+    static bool known(const Board &board, int depth, uint64_t &expected)
+    {
+        constexpr bool classic = Board::ROWS == 6 && Board::COLS == 7 && Board::WIN == 4;
+        if (!classic || board.occupied() != 0 || depth < 0 || depth >= static_cast<int>(size(CLASSIC)))
+        {
+            return false;
+        }
+        expected = CLASSIC[depth];
+        return true;
+    }
+};
+
+#endif // PERFT_H
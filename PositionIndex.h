@@ -0,0 +1,321 @@
+#ifndef POSITION_INDEX_H
+#define POSITION_INDEX_H
+
+#include "include.h"
+#include <unordered_map>
+
+/**
+ * Experience book built from game logs: for every position reached in the logged games, how often it occurred and the
+ * wins, draws and losses that followed every next move, from the view of the player making that move.
+ *
+ * Positions are stored by canonical key: the first player's discs plus the occupied cells (see Connect4Board::key),
+ * mirrored left to right if that gives a smaller key, so a position and its mirror image share one record.
+ * Moves are stored in the orientation of the canonical key.
+ *
+ * Layout: header "C4PI", version, rows, columns, padding, record count (uint64), then the records sorted by key.
+ */
+class PositionIndex
+{
+public:
+    static constexpr int ROWS = Connect4Board::ROWS;
+    static constexpr int COLS = Connect4Board::COLS;
+    static constexpr char MAGIC[4] = {'C', '4', 'P', 'I'};
+    static constexpr uint8_t VERSION = 1;
+    static constexpr size_t HEADERSIZE = 16;
+
+    /**
+     * Results after a move, from the view of the player who made it
+     */
+    struct MoveStats
+    {
+        uint32_t wins = 0;
+        uint32_t draws = 0;
+        uint32_t losses = 0;
+
+        uint32_t games() const
+        {
+            return wins + draws + losses;
+        }
+
+        /**
+         * Expected result, 1 for a win, 0.5 for a draw.
+         */
+        double score() const
+        {
+            return games() ? (wins + 0.5 * draws) / games() : 0.0;
+        }
+    };
+
+    /**
+     * A position on disk
+     */
+    struct Record
+    {
+        uint64_t key = 0;
+        uint32_t visits = 0;
+        array<MoveStats, COLS> moves{};
+    };
+    static_assert(is_trivially_copyable<Record>::value, "records are written and mapped as raw bytes");
+
+    /**
+     * Where a position is found in the index
+     */
+    struct Canonical
+    {
+        uint64_t key;
+
+        /**
+         * True if the stored position is the mirror image, columns have to be mirrored
+         */
+        bool mirrored;
+
+        /**
+         * True if the position is its own mirror image, a column and its mirror share their statistics
+         */
+        bool symmetric;
+
+        /**
+         * Map a column of the position to the column in the index.
+         */
+        Column toIndex(Column column) const
+        {
+            Column mirror = Connect4Board::mirrorColumn(column);
+            if (symmetric)
+            {
+                return min(column, mirror);
+            }
+            return mirrored ? mirror : column;
+        }
+    };
+
+    /**
+     * Canonical key of a position.
+     * @param firstPlayerBits The discs of the player who moved first.
+     * @param occupied The occupied cells.
+     */
+    static Canonical canonical(uint64_t firstPlayerBits, uint64_t occupied)
+    {
+        uint64_t key = firstPlayerBits + occupied + Connect4Board::BOTTOMMASK;
+        uint64_t mirror = Connect4Board::mirrorBits(key);
+        return {min(key, mirror), mirror < key, mirror == key};
+    }
+
+    /**
+     * Constructor for the PositionIndex class, maps the index into memory.
+     * @param path The index file.
+     */
+    explicit PositionIndex(const string &path) : file(path, MappedFile::RANDOM)
+    {
+        const uint8_t *data = file.data();
+        if (file.size() < HEADERSIZE || memcmp(data, MAGIC, sizeof(MAGIC)) != 0)
+        {
+            throw runtime_error("Position index " + path + ": not a position index");
+        }
+        if (data[4] != VERSION || data[5] != ROWS || data[6] != COLS)
+        {
+            throw runtime_error("Position index " + path + ": unsupported version or board size");
+        }
+        memcpy(&count, data + 8, sizeof(count));
+        if (file.size() != HEADERSIZE + count * sizeof(Record))
+        {
+            throw runtime_error("Position index " + path + ": truncated");
+        }
+        records = reinterpret_cast<const Record *>(data + HEADERSIZE);
+    }
+
+    /**
+     * Get the number of positions.
+     * @return The number of positions.
+     */
+    size_t size() const
+    {
+        return count;
+    }
+
+    /**
+     * Find a position by canonical key.
+     * @param key The canonical key.
+     * @return The record, nullptr if the position is not in the index.
+     */
+    const Record *find(uint64_t key) const
+    {
+        const Record *it = lower_bound(records, records + count, key, [](const Record &r, uint64_t k)
+                                       { return r.key < k; });
+        return (it != records + count && it->key == key) ? it : nullptr;
+    }
+
+    /**
+     * Look up a position, with the moves in the orientation of the board.
+     * @param board The position.
+     * @param firstPlayer The player who moved first in the game.
+     * @param record Receives the visits and move statistics.
+     * @return False if the position is not in the index.
+     */
+    bool lookup(const Connect4Board &board, Player firstPlayer, Record &record) const
+    {
+        Canonical c = canonical(board.playerBits(firstPlayer), board.occupied());
+        const Record *found = find(c.key);
+        if (!found)
+        {
+            return false;
+        }
+        record.key = found->key;
+        record.visits = found->visits;
+        for (int column = 0; column < COLS; ++column)
+        {
+            record.moves[column] = found->moves[c.toIndex(static_cast<Column>(column))];
+        }
+        return true;
+    }
+
+    /**
+     * Get the playable move with the best expected result.
+     * @param board The position.
+     * @param firstPlayer The player who moved first in the game.
+     * @param minGames The number of finished games a move needs to be considered.
+     * @return The move, Column::INVALID if the position is unknown or no move was played often enough.
+     */
+    Column bestMove(const Connect4Board &board, Player firstPlayer, uint32_t minGames) const
+    {
+        Record record;
+        if (!lookup(board, firstPlayer, record))
+        {
+            return Column::INVALID;
+        }
+        uint32_t playable = board.possibleColumns();
+        Column best = Column::INVALID;
+        for (int column = 0; column < COLS; ++column)
+        {
+            const MoveStats &m = record.moves[column];
+            if (!(playable & (1u << column)) || m.games() < max(minGames, 1u))
+            {
+                continue;
+            }
+            if (best == Column::INVALID || m.score() > record.moves[best].score() ||
+                (m.score() == record.moves[best].score() && m.games() > record.moves[best].games()))
+            {
+                best = static_cast<Column>(column);
+            }
+        }
+        return best;
+    }
+
+private:
+    MappedFile file;
+    const Record *records = nullptr;
+    uint64_t count = 0;
+};
+
+/**
+ * Builds a position index by replaying logged games.
+ */
+class PositionIndexBuilder
+{
+public:
+    /**
+     * Constructor for the PositionIndexBuilder class.
+     * @param maxPly_ Only positions with fewer discs are indexed, ROWS * COLS for all.
+     */
+    explicit PositionIndexBuilder(int maxPly_ = Connect4Board::ROWS * Connect4Board::COLS) : MAXPLY(maxPly_)
+    {
+    }
+
+    /**
+     * Replay a game and count its positions, unfinished games only count visits.
+     * @param game The game.
+     * @return False if the game contains an illegal move, positions before it are counted.
+     */
+    bool add(const GameLogReader::Game &game)
+    {
+        Connect4Board board;
+        Player first = game.firstPlayer();
+        if (first != Player::BOT && first != Player::USER)
+        {
+            return game.moves() == 0;
+        }
+        GameLog::Result result = game.result();
+        for (size_t i = 0; i < game.moves(); ++i)
+        {
+            Column column = game.column(i);
+            Player player = game.player(i);
+            if (column >= Connect4Board::COLS || board.findRow(column) < 0)
+            {
+                return false;
+            }
+            if (static_cast<int>(i) < MAXPLY)
+            {
+                PositionIndex::Canonical c = PositionIndex::canonical(board.playerBits(first), board.occupied());
+                PositionIndex::Record &record = positions[c.key];
+                record.key = c.key;
+                ++record.visits;
+                PositionIndex::MoveStats &m = record.moves[c.toIndex(column)];
+                if (result == GameLog::DRAW)
+                {
+                    ++m.draws;
+                }
+                else if (result == static_cast<GameLog::Result>(player))
+                {
+                    ++m.wins;
+                }
+                else if (result != GameLog::UNFINISHED)
+                {
+                    ++m.losses;
+                }
+            }
+            if (board.dropDisc(column, player) && i + 1 < game.moves())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Get the number of distinct positions seen.
+     * @return The number of positions.
+     */
+    size_t size() const
+    {
+        return positions.size();
+    }
+
+    /**
+     * Write the index.
+     * @param path The index file.
+     * @param minVisits Positions visited less often are left out.
+     * @return The number of positions written.
+     */
+    size_t write(const string &path, uint32_t minVisits = 1) const
+    {
+        vector<PositionIndex::Record> sorted;
+        sorted.reserve(positions.size());
+        for (const auto &entry : positions)
+        {
+            if (entry.second.visits >= minVisits)
+            {
+                sorted.push_back(entry.second);
+            }
+        }
+        sort(sorted.begin(), sorted.end(), [](const PositionIndex::Record &a, const PositionIndex::Record &b)
+             { return a.key < b.key; });
+
+        ofstream ofs(path, ios::binary | ios::trunc);
+        uint8_t header[PositionIndex::HEADERSIZE] = {'C', '4', 'P', 'I', PositionIndex::VERSION, PositionIndex::ROWS, PositionIndex::COLS, 0};
+        uint64_t count = sorted.size();
+        memcpy(header + 8, &count, sizeof(count));
+        ofs.write(reinterpret_cast<const char *>(header), sizeof(header));
+        ofs.write(reinterpret_cast<const char *>(sorted.data()), static_cast<streamsize>(sorted.size() * sizeof(PositionIndex::Record)));
+        ofs.close();
+        if (ofs.fail())
+        {
+            throw runtime_error("Cannot write position index " + path);
+        }
+        return sorted.size();
+    }
+
+private:
+    int MAXPLY;
+    unordered_map<uint64_t, PositionIndex::Record> positions;
+};
+
+#endif // POSITION_INDEX_H
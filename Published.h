@@ -0,0 +1,187 @@
+#ifndef PUBLISHED_H
+#define PUBLISHED_H
+
+#include "include.h"
+#include <thread>
+
+/**
+ * Immutable value published by a writer and read by any number of threads without locks.
+ *
+ * Every publish() installs a new copy of the value; readers pin the copy that was current when they started and keep
+ * it until their Reader goes out of scope. Replaced copies are freed by a later publish() once no reader that may hold
+ * them is left (epoch-based reclamation): a reader announces the global epoch in a free slot before loading the value,
+ * a replaced copy is tagged with the epoch it was replaced in and freed when every announced epoch is newer.
+ * Readers only use atomics. Writers are serialized by a mutex that readers never touch.
+ * @tparam T The value type.
+ */
+template <typename T>
+class Published
+{
+public:
+    /**
+     * Number of readers that can hold a value at the same time, further readers spin until a slot is free
+     */
+    static constexpr size_t READERS = 64;
+
+    /**
+     * Pinned copy of the value, valid until the reader is destroyed
+     */
+    class Reader
+    {
+    public:
+        explicit Reader(const Published &published_) : published(published_)
+        {
+            uint64_t epoch = published.epoch.load();
+            size_t i = hash<thread::id>()(this_thread::get_id()) % READERS;
+            while (true)
+            {
+                uint64_t idle = IDLE;
+                if (published.slots[i].epoch.compare_exchange_strong(idle, epoch))
+                {
+                    break;
+                }
+                i = (i + 1) % READERS;
+            }
+            slot = i;
+            value = published.current.load();
+        }
+
+        ~Reader()
+        {
+            published.slots[slot].epoch.store(IDLE);
+        }
+
+        Reader(const Reader &) = delete;
+        Reader &operator=(const Reader &) = delete;
+
+        /**
+         * Check if a value was published.
+         */
+        explicit operator bool() const
+        {
+            return value != nullptr;
+        }
+
+        const T &operator*() const
+        {
+            return *value;
+        }
+
+        const T *operator->() const
+        {
+            return value;
+        }
+
+    private:
+        const Published &published;
+        size_t slot = 0;
+        const T *value = nullptr;
+    };
+
+    Published() = default;
+
+    /**
+     * Free the current and all replaced values, no reader may be left.
+     */
+    ~Published()
+    {
+        delete current.load();
+        for (const auto &entry : retired)
+        {
+            delete entry.second;
+        }
+    }
+
+    Published(const Published &) = delete;
+    Published &operator=(const Published &) = delete;
+
+    /**
+     * Replace the value, readers that already hold the old one keep it.
+     * @param value The new value.
+     */
+    void publish(T value)
+    {
+        lock_guard<mutex> guard(writeLock);
+        const T *old = current.exchange(new T(std::move(value)));
+        uint64_t replacedIn = epoch.fetch_add(1);
+        if (old)
+        {
+            retired.push_back({replacedIn, old});
+        }
+        reclaim();
+    }
+
+    /**
+     * Pin the current value.
+     * @return The reader, empty if nothing was published yet.
+     */
+    Reader read() const
+    {
+        return Reader(*this);
+    }
+
+    /**
+     * Get the number of values published so far.
+     * @return The number of publish() calls.
+     */
+    uint64_t version() const
+    {
+        return epoch.load() - 1;
+    }
+
+    /**
+     * Get the number of replaced values that are still pinned by a reader.
+     * @return The values waiting to be freed.
+     */
+    size_t retiredCount() const
+    {
+        lock_guard<mutex> guard(writeLock);
+        return retired.size();
+    }
+
+private:
+    static constexpr uint64_t IDLE = 0;
+
+    struct alignas(64) Slot
+    {
+        atomic<uint64_t> epoch{IDLE};
+    };
+
+    atomic<const T *> current{nullptr};
+    atomic<uint64_t> epoch{1};
+    mutable array<Slot, READERS> slots;
+
+    mutable mutex writeLock;
+    vector<pair<uint64_t, const T *>> retired;
+
+    /**
+     * Free the replaced values no reader can hold anymore.
+     */
+    void reclaim()
+    {
+        uint64_t oldest = numeric_limits<uint64_t>::max();
+        for (const Slot &slot : slots)
+        {
+            uint64_t announced = slot.epoch.load();
+            if (announced != IDLE)
+            {
+                oldest = min(oldest, announced);
+            }
+        }
+        size_t kept = 0;
+        for (const auto &entry : retired)
+        {
+            if (entry.first < oldest)
+            {
+                delete entry.second;
+            }
+            else
+            {
+                retired[kept++] = entry;
+            }
+        }
+        retired.resize(kept);
+    }
+};
+
+#endif // PUBLISHED_H
@@ -0,0 +1,212 @@
+#ifndef RECLAIMER_H
+#define RECLAIMER_H
+
+#include "include.h"
+#include <condition_variable>
+#include <thread>
+
+/**
+ * Deferred deletion of detached subtrees.
+ * Subtrees handed to retire() are freed by a background thread in slices, so dropping a large part of the tree
+ * costs the caller next to nothing. The nodes waiting to be freed are capped: a caller that pushes the backlog over
+ * the cap frees slices itself until it is below the cap again. Idle callers can free slices with collect().
+ * @tparam Node The node type, deleted with delete after its children were taken over.
+ */
+template <typename Node>
+class Reclaimer
+{
+public:
+    /**
+     * Number of nodes freed at once before the lock is taken again and other threads get a turn
+     */
+    static constexpr size_t SLICE = 4096;
+
+    /**
+     * Get the reclaimer shared by all trees of this node type.
+     * @return The reclaimer, its thread is started on the first retire().
+     */
+    static Reclaimer &shared()
+    {
+        static Reclaimer instance;
+        return instance;
+    }
+
+    /**
+     * Let the background thread free all retired subtrees and join it.
+     * Nothing is freed on the calling thread: the shared reclaimer is destroyed during static destruction,
+     * after the thread_local node pool and node counts of that thread are gone.
+     */
+    ~Reclaimer()
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        workAvailable.notify_all();
+        if (worker.joinable())
+        {
+            // work() only returns once the queue is empty
+            worker.join();
+        }
+    }
+
+    Reclaimer(const Reclaimer &) = delete;
+    Reclaimer &operator=(const Reclaimer &) = delete;
+
+    /**
+     * Hand detached subtrees over, they must not be referenced anymore.
+     * @param roots The roots of the subtrees.
+     * @param nodes The number of nodes in the subtrees, counts towards the cap.
+     */
+    template <typename Roots>
+    void retire(const Roots &roots, int64_t nodes)
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            for (Node *root : roots)
+            {
+                if (root)
+                {
+                    queue.push_back(root);
+                }
+            }
+            if (!worker.joinable() && !stopping)
+            {
+                worker = thread([this]
+                                { work(); });
+            }
+        }
+        outstanding.fetch_add(nodes, memory_order_relaxed);
+        workAvailable.notify_one();
+
+        while (outstanding.load(memory_order_relaxed) > CAP.load(memory_order_relaxed) && collect(SLICE) > 0)
+        {
+        }
+    }
+
+    /**
+     * Hand a detached subtree over.
+     * @param root The root of the subtree.
+     * @param nodes The number of nodes in the subtree.
+     */
+    void retire(Node *root, int64_t nodes)
+    {
+        retire(initializer_list<Node *>{root}, nodes);
+    }
+
+    /**
+     * Free retired nodes on the calling thread.
+     * @param budget The maximum number of nodes to free.
+     * @return The number of nodes freed, 0 if nothing is waiting.
+     */
+    size_t collect(size_t budget)
+    {
+        vector<Node *> stack;
+        size_t count = 0;
+        while (count < budget)
+        {
+            if (stack.empty())
+            {
+                lock_guard<mutex> guard(lock);
+                if (queue.empty())
+                {
+                    break;
+                }
+                stack.push_back(queue.back());
+                queue.pop_back();
+            }
+            Node *node = stack.back();
+            stack.pop_back();
+            for (Node *child : node->children)
+            {
+                stack.push_back(child);
+            }
+            node->children.clear();
+            delete node;
+            ++count;
+        }
+        if (!stack.empty())
+        {
+            // every node left on the stack is the root of a subtree of its own
+            lock_guard<mutex> guard(lock);
+            queue.insert(queue.end(), stack.begin(), stack.end());
+        }
+        outstanding.fetch_sub(static_cast<int64_t>(count), memory_order_relaxed);
+        freedNodes.fetch_add(count, memory_order_relaxed);
+        return count;
+    }
+
+    /**
+     * Free every retired node that is not being freed by the background thread right now.
+     */
+    void drain()
+    {
+        while (collect(SLICE) > 0)
+        {
+        }
+    }
+
+    /**
+     * Set the cap on nodes waiting to be freed.
+     * @param nodes The cap, retire() frees nodes itself above it.
+     */
+    void setCap(int64_t nodes)
+    {
+        CAP.store(nodes, memory_order_relaxed);
+    }
+
+    /**
+     * Get the number of nodes waiting to be freed.
+     * @return The retired nodes not freed yet.
+     */
+    int64_t pending() const
+    {
+        return max<int64_t>(0, outstanding.load(memory_order_relaxed));
+    }
+
+    /**
+     * Get the number of nodes freed so far.
+     * @return The freed nodes.
+     */
+    uint64_t freed() const
+    {
+        return freedNodes.load(memory_order_relaxed);
+    }
+
+private:
+    atomic<int64_t> CAP{1 << 20};
+
+    mutex lock;
+    condition_variable workAvailable;
+    vector<Node *> queue;
+    bool stopping = false;
+    thread worker;
+
+    atomic<int64_t> outstanding{0};
+    atomic<uint64_t> freedNodes{0};
+
+    Reclaimer() = default;
+
+    /**
+     * Background thread, frees slices and yields between them so a running search keeps its core.
+     */
+    void work()
+    {
+        while (true)
+        {
+            {
+                unique_lock<mutex> guard(lock);
+                workAvailable.wait(guard, [this]
+                                   { return stopping || !queue.empty(); });
+                if (queue.empty())
+                {
+                    return;
+                }
+            }
+            collect(SLICE);
+            this_thread::yield();
+        }
+    }
+};
+
+#endif // RECLAIMER_H
@@ -0,0 +1,326 @@
+#ifndef SEARCH_STATS_H
+#define SEARCH_STATS_H
+
+#include "include.h"
+#include <atomic>
+#include <chrono>
+
+/**
+ * Counter that is only written by its owning thread but may be read by others.
+ * Relaxed load + store compiles to a plain increment, no locked instruction is needed.
+ */
+class RelaxedCounter
+{
+public:
+    RelaxedCounter() = default;
+    RelaxedCounter(const RelaxedCounter &other) : value(other.load()) {}
+    RelaxedCounter &operator=(const RelaxedCounter &other)
+    {
+        value.store(other.load(), memory_order_relaxed);
+        return *this;
+    }
+
+    void operator++()
+    {
+        add(1);
+    }
+
+    void operator+=(uint64_t amount)
+    {
+        add(amount);
+    }
+
+    void add(uint64_t amount)
+    {
+        value.store(value.load(memory_order_relaxed) + amount, memory_order_relaxed);
+    }
+
+    uint64_t load() const
+    {
+        return value.load(memory_order_relaxed);
+    }
+
+private:
+    atomic<uint64_t> value{0};
+};
+
+/**
+ * Counters for tree building and move selection.
+ */
+struct SearchCounters
+{
+    /**
+     * Number of tree levels tracked separately, deeper levels share the last slot
+     */
+    static constexpr int MAXLEVELS = 64;
+
+    /**
+     * Phases of a move that are timed
+     */
+    enum Phase
+    {
+        PLAYMOVE = 0,
+        MOVEROOTUP = 1,
+        GROW = 2,
+        TODOT = 3,
+        DOTTOSVG = 4,
+        BESTMOVE = 5,
+        PHASES = 6
+    };
+
+    uint64_t nodesCreated = 0;
+    uint64_t expansions = 0;
+    uint64_t prunedOppCanWin = 0;
+    uint64_t prunedHasWin = 0;
+    uint64_t prunedBestChild = 0;
+    uint64_t fallbackNodes = 0;
+    uint64_t mirroredNodes = 0;
+    uint64_t metricEvaluations = 0;
+    array<uint64_t, MAXLEVELS> nodesPerLevel{};
+    array<uint64_t, MAXLEVELS> expansionsPerLevel{};
+    array<uint64_t, PHASES> phaseNanos{};
+    array<uint64_t, PHASES> phaseCalls{};
+
+    /**
+     * Get the name of a phase.
+     * @param phase The phase.
+     * @return The name of the phase.
+     */
+    static const char *phaseName(int phase)
+    {
+        static constexpr const char *names[PHASES] = {"playMove", "moveRootUp", "grow", "toDot", "dotToSvg", "getBestMove"};
+        return names[phase];
+    }
+
+    /**
+     * Clamp a tree level to the tracked levels.
+     * @param level The level of a node.
+     * @return The slot for the level.
+     */
+    static int levelSlot(int level)
+    {
+        return level < 0 ? 0 : (level >= MAXLEVELS ? MAXLEVELS - 1 : level);
+    }
+
+    /**
+     * Get the difference between two snapshots of the same counters.
+     * @param before The earlier snapshot.
+     * @return The counts accumulated since before.
+     */
+    SearchCounters since(const SearchCounters &before) const
+    {
+        SearchCounters d;
+        d.nodesCreated = nodesCreated - before.nodesCreated;
+        d.expansions = expansions - before.expansions;
+        d.prunedOppCanWin = prunedOppCanWin - before.prunedOppCanWin;
+        d.prunedHasWin = prunedHasWin - before.prunedHasWin;
+        d.prunedBestChild = prunedBestChild - before.prunedBestChild;
+        d.fallbackNodes = fallbackNodes - before.fallbackNodes;
+        d.mirroredNodes = mirroredNodes - before.mirroredNodes;
+        d.metricEvaluations = metricEvaluations - before.metricEvaluations;
+        for (int i = 0; i < MAXLEVELS; ++i)
+        {
+            d.nodesPerLevel[i] = nodesPerLevel[i] - before.nodesPerLevel[i];
+            d.expansionsPerLevel[i] = expansionsPerLevel[i] - before.expansionsPerLevel[i];
+        }
+        for (int i = 0; i < PHASES; ++i)
+        {
+            d.phaseNanos[i] = phaseNanos[i] - before.phaseNanos[i];
+            d.phaseCalls[i] = phaseCalls[i] - before.phaseCalls[i];
+        }
+        return d;
+    }
+
+    /**
+     * Print a report of the counters.
+     * @param os The stream to print to.
+     */
+    void print(ostream &os = cout) const
+    {
+        uint64_t candidates = nodesCreated + prunedOppCanWin;
+        double growSeconds = phaseNanos[GROW] * 1e-9;
+
+        os << "Nodes created: " << nodesCreated << " (" << fallbackNodes << " fallback, " << mirroredNodes << " mirrored)"
+           << ", expansions: " << expansions
+           << ", metric evaluations: " << metricEvaluations << "\n";
+        if (growSeconds > 0)
+        {
+            os << "Nodes/sec while growing: " << static_cast<uint64_t>(nodesCreated / growSeconds) << "\n";
+        }
+        if (candidates > 0)
+        {
+            os << "Pruned: oppCanWin " << prunedOppCanWin << " (" << 100.0 * prunedOppCanWin / candidates << "%)"
+               << ", hasWin " << prunedHasWin << " (" << 100.0 * prunedHasWin / candidates << "%)"
+               << ", bestChild " << prunedBestChild << " (" << 100.0 * prunedBestChild / candidates << "%)\n";
+        }
+        os << "Branching factor per level:";
+        for (int level = 0; level + 1 < MAXLEVELS; ++level)
+        {
+            if (expansionsPerLevel[level] > 0)
+            {
+                os << " L" << level << "=" << static_cast<double>(nodesPerLevel[level + 1]) / expansionsPerLevel[level];
+            }
+        }
+        os << "\n";
+        os << "Wall time per phase:";
+        for (int phase = 0; phase < PHASES; ++phase)
+        {
+            if (phaseCalls[phase] > 0)
+            {
+                os << " " << phaseName(phase) << "=" << phaseNanos[phase] * 1e-6 << "ms";
+            }
+        }
+        os << endl;
+    }
+};
+
+/**
+ * Per-thread search counters, aggregated on read.
+ * Every thread only writes its own counters, so counting never takes a lock or a locked instruction.
+ */
+class SearchStats
+{
+public:
+    /**
+     * The counters of a single thread.
+     */
+    struct Slot
+    {
+        RelaxedCounter nodesCreated;
+        RelaxedCounter expansions;
+        RelaxedCounter prunedOppCanWin;
+        RelaxedCounter prunedHasWin;
+        RelaxedCounter prunedBestChild;
+        RelaxedCounter fallbackNodes;
+        RelaxedCounter mirroredNodes;
+        RelaxedCounter metricEvaluations;
+        array<RelaxedCounter, SearchCounters::MAXLEVELS> nodesPerLevel;
+        array<RelaxedCounter, SearchCounters::MAXLEVELS> expansionsPerLevel;
+        array<RelaxedCounter, SearchCounters::PHASES> phaseNanos;
+        array<RelaxedCounter, SearchCounters::PHASES> phaseCalls;
+
+        /**
+         * Add the counts of this slot to a snapshot.
+         */
+        void addTo(SearchCounters &c) const
+        {
+            c.nodesCreated += nodesCreated.load();
+            c.expansions += expansions.load();
+            c.prunedOppCanWin += prunedOppCanWin.load();
+            c.prunedHasWin += prunedHasWin.load();
+            c.prunedBestChild += prunedBestChild.load();
+            c.fallbackNodes += fallbackNodes.load();
+            c.mirroredNodes += mirroredNodes.load();
+            c.metricEvaluations += metricEvaluations.load();
+            for (int i = 0; i < SearchCounters::MAXLEVELS; ++i)
+            {
+                c.nodesPerLevel[i] += nodesPerLevel[i].load();
+                c.expansionsPerLevel[i] += expansionsPerLevel[i].load();
+            }
+            for (int i = 0; i < SearchCounters::PHASES; ++i)
+            {
+                c.phaseNanos[i] += phaseNanos[i].load();
+                c.phaseCalls[i] += phaseCalls[i].load();
+            }
+        }
+    };
+
+    /**
+     * Get the counters of the calling thread, for counting.
+     * @return The slot of the calling thread.
+     */
+    static Slot &local()
+    {
+        static thread_local Registration registration;
+        return registration.slot;
+    }
+
+    /**
+     * Get a snapshot of the counters of the calling thread.
+     * @return The counters of the calling thread.
+     */
+    static SearchCounters snapshot()
+    {
+        SearchCounters c;
+        local().addTo(c);
+        return c;
+    }
+
+    /**
+     * Get the sum of the counters of all threads, including threads that have exited.
+     * @return The aggregated counters.
+     */
+    static SearchCounters aggregate()
+    {
+        Registry &r = registry();
+        lock_guard<mutex> guard(r.lock);
+        SearchCounters c = r.retired;
+        for (const Slot *slot : r.slots)
+        {
+            slot->addTo(c);
+        }
+        return c;
+    }
+
+    /**
+     * Times a phase of a move for as long as it is in scope.
+     */
+    class PhaseTimer
+    {
+    public:
+        explicit PhaseTimer(SearchCounters::Phase phase_)
+            : phase(phase_), start(chrono::steady_clock::now())
+        {
+        }
+
+        ~PhaseTimer()
+        {
+            Slot &slot = local();
+            slot.phaseNanos[phase] += static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+            ++slot.phaseCalls[phase];
+        }
+
+    private:
+        SearchCounters::Phase phase;
+        chrono::steady_clock::time_point start;
+    };
+
+private:
+    struct Registry
+    {
+        mutex lock;
+        vector<const Slot *> slots;
+        SearchCounters retired;
+    };
+
+    static Registry &registry()
+    {
+        static Registry instance;
+        return instance;
+    }
+
+    /**
+     * Registers the slot of a thread for aggregation, and keeps its counts when the thread exits.
+     */
+    struct Registration
+    {
+        Slot slot;
+
+        Registration()
+        {
+            Registry &r = registry();
+            lock_guard<mutex> guard(r.lock);
+            r.slots.push_back(&slot);
+        }
+
+        ~Registration()
+        {
+            Registry &r = registry();
+            lock_guard<mutex> guard(r.lock);
+            slot.addTo(r.retired);
+            r.slots.erase(find(r.slots.begin(), r.slots.end(), &slot));
+        }
+    };
+};
+
+#endif // SEARCH_STATS_H
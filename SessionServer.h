@@ -0,0 +1,527 @@
+#ifndef SESSION_SERVER_H
+#define SESSION_SERVER_H
+
+#include "include.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+/**
+ * Hosts many independent games (sessions) in one process.
+ *
+ * Engine work of all sessions runs on one shared worker pool; the commands of a session run one after another, in the
+ * order they arrived, different sessions run in parallel. Read-only resources are shared: the opening book is mapped
+ * once, sessions with the default settings load their initial tree from one tree snapshot, and every worker keeps its
+ * metrics cache and node pool warm across sessions.
+ *
+ * One command per line, replies are single lines; replies of a session start with its id, they may interleave with
+ * replies of other sessions:
+ *
+ *   new [depth <d>] [level <easy|medium|hard>] [pruning <0|1>] [first <user|bot>]
+ *                            -> session <id> [bot <column>]
+ *   play <id> <column>       -> <id> played <column> bot <column|none> result <ongoing|userwin|botwin|draw> time <us>
+ *   best <id>                -> <id> best <column>              (answered right away from the published position)
+ *   undo <id>                -> <id> undone moves <n>           (takes back the last user move and the bot's reply)
+ *   close <id>               -> <id> closed
+ *   stats                    -> stats sessions <n> created <n> moves <n> pending <n>
+ *   quit                        closes the connection
+ *
+ * Malformed commands reply "error <message>", failed session commands "<id> error <message>". new rejects depths above
+ * the configured maximum with "error invalid depth <d>". Sessions belong to the client that opened them, they are closed
+ * when it quits or disconnects.
+ */
+class SessionServer
+{
+public:
+    /**
+     * Settings of the server and the defaults of new sessions
+     */
+    struct Config
+    {
+        size_t threads = 0;                 // workers, 0 for one per hardware thread
+        int depth = 4;                      // tree depth of new sessions
+        int maxDepth = 0;                   // deepest tree a client may request, 0 for depth
+        Level level = Level::HARD;          // bot level of new sessions
+        bool advancedPruning = true;        // pruning of new sessions
+        size_t takebacks = 2;               // moves undo takes back without rebuilding the tree
+        const PositionIndex *book = nullptr; // opening book shared by all sessions, nullptr for none
+        string treeSnapshot;                // initial tree of sessions with the default settings, empty to build every tree
+        string dotDir;                      // if not empty, every session exports its tree to <dotDir>/session-<id>.dot/.svg
+    };
+
+    /**
+     * Where the replies for a client go
+     */
+    using Reply = function<void(const string &)>;
+
+    /**
+     * The ids of the sessions a client opened and did not close yet
+     */
+    using Owned = unordered_set<uint64_t>;
+
+    /**
+     * Constructor for the SessionServer class, builds the tree snapshot if one is configured.
+     * @param config_ The settings.
+     */
+    explicit SessionServer(const Config &config_) : config(config_), pool(config_.threads)
+    {
+        if (!config.treeSnapshot.empty())
+        {
+            Connect4Board board;
+            GameTheorie warmup(board, Player::USER, config.depth, config.level, config.advancedPruning, false, config.treeSnapshot);
+        }
+    }
+
+    /**
+     * Wait for the work of all sessions.
+     */
+    ~SessionServer()
+    {
+        pool.wait();
+    }
+
+    SessionServer(const SessionServer &) = delete;
+    SessionServer &operator=(const SessionServer &) = delete;
+
+    /**
+     * Execute a command, session work is queued and replied to from a worker.
+     * @param line The command.
+     * @param reply Receives the replies, called from any thread, one call at a time per session.
+     * @param owned The sessions of the client, new adds to them and close removes from them.
+     * @return False if the command was quit, true otherwise.
+     */
+    bool execute(const string &line, const Reply &reply, Owned &owned)
+    {
+        stringstream ss(line);
+        string command;
+        if (!(ss >> command))
+        {
+            return true;
+        }
+        try
+        {
+            if (command == "quit")
+            {
+                return false;
+            }
+            else if (command == "new")
+            {
+                create(ss, reply, owned);
+            }
+            else if (command == "play" || command == "best" || command == "undo" || command == "close")
+            {
+                uint64_t id = 0;
+                if (!(ss >> id))
+                {
+                    reply("error missing session id");
+                    return true;
+                }
+                shared_ptr<Session> session = find(id);
+                if (!session)
+                {
+                    reply("error unknown session " + to_string(id));
+                }
+                else if (command == "play")
+                {
+                    string column;
+                    ss >> column;
+                    play(session, column, reply);
+                }
+                else if (command == "best")
+                {
+                    best(session, reply);
+                }
+                else if (command == "undo")
+                {
+                    undo(session, reply);
+                }
+                else
+                {
+                    owned.erase(id);
+                    close(session, reply);
+                }
+            }
+            else if (command == "stats")
+            {
+                reply("stats sessions " + to_string(size()) + " created " + to_string(created.load()) + " moves " +
+                      to_string(moves.load()) + " pending " + to_string(Reclaimer<TreeNode>::shared().pending()));
+            }
+            else
+            {
+                reply("error unknown command " + command);
+            }
+        }
+        catch (const exception &e)
+        {
+            reply(string("error ") + e.what());
+        }
+        return true;
+    }
+
+    /**
+     * Close the sessions a client left open, e.g. when it disconnected, without replying.
+     * @param owned The sessions of the client, empty afterwards.
+     */
+    void disconnect(Owned &owned)
+    {
+        Reply ignore = [](const string &) {};
+        for (uint64_t id : owned)
+        {
+            shared_ptr<Session> session = find(id);
+            if (session)
+            {
+                close(session, ignore);
+            }
+        }
+        owned.clear();
+    }
+
+    /**
+     * Read and execute commands until quit or end of input, close the sessions, then wait for the queued work.
+     * @param in The stream commands are read from.
+     * @param out The stream replies are written to.
+     */
+    void serve(istream &in, ostream &out)
+    {
+        mutex outLock;
+        Reply reply = [&](const string &message)
+        {
+            lock_guard<mutex> guard(outLock);
+            out << message << endl;
+        };
+        Owned owned;
+        string line;
+        while (getline(in, line) && execute(line, reply, owned))
+        {
+        }
+        disconnect(owned);
+        pool.wait();
+    }
+
+    /**
+     * Get the number of open sessions.
+     * @return The number of sessions.
+     */
+    size_t size() const
+    {
+        lock_guard<mutex> guard(sessionsLock);
+        return sessions.size();
+    }
+
+    /**
+     * Get the number of workers.
+     * @return The number of workers.
+     */
+    size_t threads() const
+    {
+        return pool.size();
+    }
+
+private:
+    /**
+     * A game, its board and tree are only touched by the task running for it
+     */
+    struct Session
+    {
+        uint64_t id = 0;
+        Connect4Board board;
+        Level level = Level::HARD;
+        Player first = Player::USER;
+        bool over = false;
+
+        /**
+         * The game, shared with best queries that read its published position
+         */
+        shared_ptr<GameTheorie> brain;
+
+        mutex lock;
+        deque<function<void()>> tasks;
+        bool running = false;
+    };
+
+    Config config;
+    ThreadPool pool;
+
+    mutable mutex sessionsLock;
+    unordered_map<uint64_t, shared_ptr<Session>> sessions;
+    atomic<uint64_t> nextId{1};
+    atomic<uint64_t> created{0};
+    atomic<uint64_t> moves{0};
+
+    shared_ptr<Session> find(uint64_t id) const
+    {
+        lock_guard<mutex> guard(sessionsLock);
+        auto it = sessions.find(id);
+        return it == sessions.end() ? nullptr : it->second;
+    }
+
+    /**
+     * Queue a task for a session, tasks of a session run one at a time in order.
+     */
+    void post(const shared_ptr<Session> &session, function<void()> task)
+    {
+        bool start = false;
+        {
+            lock_guard<mutex> guard(session->lock);
+            session->tasks.push_back(std::move(task));
+            start = !session->running;
+            session->running = true;
+        }
+        if (start)
+        {
+            pool.submit([this, session]
+                        { runNext(session); });
+        }
+    }
+
+    /**
+     * Run the next task of a session, then queue the session again so other sessions get their turn.
+     */
+    void runNext(const shared_ptr<Session> &session)
+    {
+        function<void()> task;
+        {
+            lock_guard<mutex> guard(session->lock);
+            task = std::move(session->tasks.front());
+            session->tasks.pop_front();
+        }
+        task();
+        bool more = false;
+        {
+            lock_guard<mutex> guard(session->lock);
+            more = !session->tasks.empty();
+            session->running = more;
+        }
+        if (more)
+        {
+            pool.submit([this, session]
+                        { runNext(session); });
+        }
+    }
+
+    /**
+     * Run a task for a session, an exception is replied as a session error.
+     */
+    void guarded(const shared_ptr<Session> &session, const Reply &reply, const function<void()> &task)
+    {
+        try
+        {
+            task();
+        }
+        catch (const exception &e)
+        {
+            reply(to_string(session->id) + " error " + e.what());
+        }
+    }
+
+    /**
+     * Get the game of a session, from the task running for it.
+     */
+    static GameTheorie &brainOf(const shared_ptr<Session> &session)
+    {
+        if (!session->brain)
+        {
+            throw runtime_error("session did not start");
+        }
+        return *session->brain;
+    }
+
+    static Column parseColumn(const string &column)
+    {
+        if (column.size() != 1)
+        {
+            throw invalid_argument("invalid column " + column);
+        }
+        return Connect4Board::charToColumn(column[0]);
+    }
+
+    void create(stringstream &ss, const Reply &reply, Owned &owned)
+    {
+        int depth = config.depth;
+        int maxDepth = config.maxDepth > 0 ? config.maxDepth : config.depth;
+        Level level = config.level;
+        bool advancedPruning = config.advancedPruning;
+        Player first = Player::USER;
+        string name;
+        string value;
+        while (ss >> name >> value)
+        {
+            if (name == "depth")
+            {
+                depth = stoi(value);
+                // every tree is built on the shared pool, a deep one would starve the other sessions
+                if (depth < 1 || depth > maxDepth)
+                {
+                    throw invalid_argument("invalid depth " + value);
+                }
+            }
+            else if (name == "level")
+            {
+                level = value == "easy" ? Level::EASY : value == "medium" ? Level::MEDIUM : Level::HARD;
+            }
+            else if (name == "pruning")
+            {
+                advancedPruning = value == "1" || value == "true";
+            }
+            else if (name == "first")
+            {
+                first = value == "bot" ? Player::BOT : Player::USER;
+            }
+            else
+            {
+                throw invalid_argument("unknown option " + name);
+            }
+        }
+
+        shared_ptr<Session> session = make_shared<Session>();
+        session->id = nextId.fetch_add(1);
+        session->level = level;
+        session->first = first;
+        {
+            lock_guard<mutex> guard(sessionsLock);
+            sessions[session->id] = session;
+        }
+        owned.insert(session->id);
+        // only trees with the settings of the snapshot can use it
+        bool defaults = depth == config.depth && advancedPruning == config.advancedPruning && first == Player::USER;
+        string snapshot = defaults ? config.treeSnapshot : "";
+
+        post(session, [this, session, reply, depth, level, advancedPruning, first, snapshot]
+             { guarded(session, reply, [&]
+                       {
+                shared_ptr<GameTheorie> brain = make_shared<GameTheorie>(session->board, first, depth, level, advancedPruning, false, snapshot);
+                brain->setTakebacks(config.takebacks);
+                if (config.book)
+                {
+                    brain->setBook(config.book);
+                }
+                if (!config.dotDir.empty())
+                {
+                    brain->getTree()->EXPORTDOT = true;
+                    brain->getTree()->DOTFILE = config.dotDir + "/session-" + to_string(session->id);
+                }
+                string message = "session " + to_string(session->id);
+                if (first == Player::BOT)
+                {
+                    Column column = brain->getBestMove(level);
+                    brain->playMove(column, Player::BOT);
+                    message += string(" bot ") + Connect4Board::colToChar(column);
+                }
+                {
+                    lock_guard<mutex> guard(session->lock);
+                    session->brain = brain;
+                }
+                created.fetch_add(1, memory_order_relaxed);
+                reply(message); }); });
+    }
+
+    void play(const shared_ptr<Session> &session, const string &columnName, const Reply &reply)
+    {
+        Column column = parseColumn(columnName);
+        post(session, [this, session, reply, column]
+             { guarded(session, reply, [&]
+                       {
+                auto start = chrono::steady_clock::now();
+                GameTheorie &brain = brainOf(session);
+                if (session->over)
+                {
+                    throw runtime_error("game is over");
+                }
+                if (column >= Connect4Board::COLS || session->board.findRow(column) < 0)
+                {
+                    throw invalid_argument(string("illegal move ") + Connect4Board::colToChar(column));
+                }
+                string result = "ongoing";
+                string bot = "none";
+                if (brain.playMove(column, Player::USER))
+                {
+                    result = "userwin";
+                }
+                else if (session->board.full())
+                {
+                    result = "draw";
+                }
+                else
+                {
+                    Column answer = brain.getBestMove(session->level);
+                    bot = Connect4Board::colToChar(answer);
+                    if (brain.playMove(answer, Player::BOT))
+                    {
+                        result = "botwin";
+                    }
+                    else if (session->board.full())
+                    {
+                        result = "draw";
+                    }
+                }
+                session->over = result != "ongoing";
+                moves.fetch_add(1, memory_order_relaxed);
+                auto us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+                reply(to_string(session->id) + " played " + Connect4Board::colToChar(column) + " bot " + bot + " result " + result +
+                      " time " + to_string(us)); }); });
+    }
+
+    /**
+     * Answered on the calling thread from the position the session published last, without waiting for its queue.
+     */
+    void best(const shared_ptr<Session> &session, const Reply &reply)
+    {
+        shared_ptr<GameTheorie> brain;
+        {
+            lock_guard<mutex> guard(session->lock);
+            brain = session->brain;
+        }
+        if (!brain)
+        {
+            reply(to_string(session->id) + " error session is starting");
+            return;
+        }
+        reply(to_string(session->id) + " best " + Connect4Board::colToChar(brain->queryBestMove(session->level)));
+    }
+
+    void undo(const shared_ptr<Session> &session, const Reply &reply)
+    {
+        post(session, [this, session, reply]
+             { guarded(session, reply, [&]
+                       {
+                GameTheorie &brain = brainOf(session);
+                // the bot's opening move stays
+                size_t kept = session->first == Player::BOT ? 1 : 0;
+                size_t undone = 0;
+                // the bot's reply, unless the user's move ended the game, then the user's move
+                if (brain.readPosition()->currentPlayer == Player::USER && brain.readPosition()->moves > kept)
+                {
+                    brain.undoMove();
+                    ++undone;
+                }
+                if (brain.readPosition()->moves > kept)
+                {
+                    brain.undoMove();
+                    ++undone;
+                }
+                session->over = false;
+                reply(to_string(session->id) + " undone moves " + to_string(undone)); }); });
+    }
+
+    void close(const shared_ptr<Session> &session, const Reply &reply)
+    {
+        {
+            lock_guard<mutex> guard(sessionsLock);
+            sessions.erase(session->id);
+        }
+        post(session, [session, reply]
+             {
+            shared_ptr<GameTheorie> brain;
+            {
+                lock_guard<mutex> guard(session->lock);
+                brain.swap(session->brain);
+            }
+            brain.reset();
+            reply(to_string(session->id) + " closed"); });
+    }
+};
+
+#endif // SESSION_SERVER_H
@@ -0,0 +1,511 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include "include.h"
+
+/**
+ * Exact solver: negamax with alpha-beta pruning, a transposition table and a node budget.
+ * Works on raw bitboards of the board type: the discs of the player to move and the occupied cells.
+ *
+ * Scores are from the view of the player to move: 0 is a draw, a positive score is a win, a negative score a loss.
+ * The earlier the win, the higher the score: winning with your k-th disc (counted over the whole game) scores CELLS / 2 + 1 - k.
+ * @tparam Board The board type, e.g. Connect4Board.
+ */
+template <typename Board>
+class BasicSolver
+{
+public:
+    static constexpr int ROWS = Board::ROWS;
+    static constexpr int COLS = Board::COLS;
+    static constexpr int WIN = Board::WIN;
+    static constexpr int CELLS = ROWS * COLS;
+
+    /**
+     * Transposition table file: a header, then one record per used entry (8 byte key, 1 byte value)
+     */
+    static constexpr char MAGIC[4] = {'C', '4', 'T', 'T'};
+    static constexpr uint8_t VERSION = 1;
+
+    /**
+     * Nodes between two calls of the progress callback
+     */
+    static constexpr uint64_t PROGRESSNODES = uint64_t(1) << 20;
+
+    /**
+     * Bounds of the score, a player needs at least WIN discs to win
+     */
+    static constexpr int MINSCORE = -CELLS / 2 + (WIN - 1);
+    static constexpr int MAXSCORE = (CELLS + 1) / 2 - (WIN - 1);
+
+    /**
+     * Result of solving a position
+     */
+    struct Result
+    {
+        /**
+         * Exact within the window of the solve, at or below alpha an upper bound, at or above beta a lower bound
+         */
+        int score = 0;
+        Column bestMove = Column::INVALID;
+        uint64_t nodes = 0;
+
+        /**
+         * False if the node budget ran out, the score and move are then only a guess
+         */
+        bool exact = true;
+    };
+
+    /**
+     * Constructor for the Solver class.
+     * @param ttEntries The number of transposition table entries, rounded up to a power of two.
+     */
+    explicit BasicSolver(size_t ttEntries = size_t(1) << 20)
+    {
+        size_t size = 1;
+        while (size < ttEntries)
+        {
+            size <<= 1;
+        }
+        table.resize(size);
+    }
+
+    /**
+     * Forget all positions in the transposition table.
+     */
+    void clear()
+    {
+        fill(table.begin(), table.end(), Entry{});
+    }
+
+    /**
+     * Write the used transposition table entries to a file, through a temporary file that replaces it at the end.
+     * @param path The file.
+     * @return The number of entries written.
+     */
+    size_t saveTable(const string &path) const
+    {
+        TableHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.rows = ROWS;
+        header.cols = COLS;
+        header.win = WIN;
+        for (const Entry &entry : table)
+        {
+            header.entries += entry.value != 0;
+        }
+
+        string temporary = path + ".tmp";
+        ofstream ofs(temporary, ios::binary | ios::trunc);
+        ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        vector<char> buffer;
+        buffer.reserve(RECORDSIZE * 65536);
+        for (const Entry &entry : table)
+        {
+            if (entry.value == 0)
+            {
+                continue;
+            }
+            buffer.insert(buffer.end(), reinterpret_cast<const char *>(&entry.key), reinterpret_cast<const char *>(&entry.key) + sizeof(entry.key));
+            buffer.push_back(static_cast<char>(entry.value));
+            if (buffer.size() == buffer.capacity())
+            {
+                ofs.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+                buffer.clear();
+            }
+        }
+        ofs.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+        ofs.close();
+        if (ofs.fail() || rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            remove(temporary.c_str());
+            throw runtime_error("Cannot write transposition table " + path);
+        }
+        return header.entries;
+    }
+
+    /**
+     * Fill the transposition table from a file written by saveTable, the table sizes may differ.
+     * Entries only hold bounds that are valid in every search, so a table can be loaded for any position.
+     * @param path The file.
+     * @return The number of entries read, 0 if the file does not exist or is for another board.
+     */
+    size_t loadTable(const string &path)
+    {
+        ifstream ifs(path, ios::binary);
+        TableHeader header;
+        if (!ifs.read(reinterpret_cast<char *>(&header), sizeof(header)) || memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+            header.version != VERSION || header.rows != ROWS || header.cols != COLS || header.win != WIN)
+        {
+            return 0;
+        }
+        vector<char> buffer(RECORDSIZE * 65536);
+        size_t read = 0;
+        while (read < header.entries && ifs)
+        {
+            size_t records = min<uint64_t>(header.entries - read, 65536);
+            if (!ifs.read(buffer.data(), static_cast<streamsize>(records * RECORDSIZE)))
+            {
+                break;
+            }
+            for (size_t i = 0; i < records; ++i)
+            {
+                Entry entry;
+                memcpy(&entry.key, buffer.data() + i * RECORDSIZE, sizeof(entry.key));
+                entry.value = static_cast<int8_t>(buffer[i * RECORDSIZE + sizeof(entry.key)]);
+                table[entry.key & (table.size() - 1)] = entry;
+            }
+            read += records;
+        }
+        return read;
+    }
+
+    /**
+     * Call a function every PROGRESSNODES nodes during a solve, e.g. to checkpoint the transposition table.
+     * @param callback The function, empty for none.
+     */
+    void setProgress(function<void()> callback)
+    {
+        progress = std::move(callback);
+    }
+
+    /**
+     * Solve a position and find the best move.
+     * With a window, only scores within (alpha, beta) are exact: a score at or below alpha only shows the position is
+     * no better, one at or above beta that it is no worse. The best move is then only meaningful for an exact score.
+     * @param board The position, must not be won already.
+     * @param toMove The player to move.
+     * @param nodeBudget The maximum number of nodes searched, 0 for no limit.
+     * @param alpha The lower end of the window.
+     * @param beta The upper end of the window.
+     * @return The score and best move.
+     */
+    Result solve(const Board &board, Player toMove, uint64_t nodeBudget = 0, int alpha = MINSCORE - 1, int beta = MAXSCORE + 1)
+    {
+        nodes = 0;
+        budget = nodeBudget;
+        aborted = false;
+        nextCheck = budget ? min(budget, PROGRESSNODES) : PROGRESSNODES;
+
+        uint64_t current = board.playerBits(toMove);
+        uint64_t mask = board.occupied();
+        int moves = __builtin_popcountll(mask);
+
+        Result result;
+        uint64_t possible = playable(mask);
+        if (!possible)
+        {
+            // the position itself is the only node looked at
+            result.nodes = nodes = 1;
+            return result;
+        }
+
+        // immediate win
+        uint64_t wins = Board::winningCells(current, mask) & possible;
+        if (wins)
+        {
+            result.score = (CELLS + 1 - moves) / 2;
+            result.bestMove = firstInOrder(Board::toColumnMask(wins));
+            result.nodes = nodes = 1;
+            return result;
+        }
+
+        // evaluate every move, the first move in center-first order wins ties;
+        // later moves only need to show whether they beat the best so far
+        int best = numeric_limits<int>::min();
+        for (int i = 0; i < COLS && alpha < beta; ++i)
+        {
+            int c = ORDER[i];
+            uint64_t move = possible & Board::columnMask(c);
+            if (!move)
+            {
+                continue;
+            }
+            int score = -evaluate(current ^ mask, mask | move, moves + 1, -beta, -alpha);
+            if (aborted)
+            {
+                break;
+            }
+            if (score > best)
+            {
+                best = score;
+                result.bestMove = static_cast<Column>(c);
+            }
+            alpha = std::max(alpha, score);
+        }
+
+        if (aborted)
+        {
+            // fall back to a move that does not lose right away
+            result.bestMove = firstInOrder(Board::toColumnMask(nonLosing(current, mask)));
+            if (result.bestMove == Column::INVALID)
+            {
+                result.bestMove = columnOf(possible & (~possible + 1));
+            }
+            result.score = 0;
+            result.exact = false;
+        }
+        else
+        {
+            result.score = best;
+        }
+        result.nodes = nodes;
+        return result;
+    }
+
+    /**
+     * Get the number of nodes searched by the last solve.
+     * @return The number of nodes.
+     */
+    uint64_t getNodes() const
+    {
+        return nodes;
+    }
+
+private:
+    /**
+     * Transposition table entry, stores an upper bound of the score
+     */
+    struct Entry
+    {
+        uint64_t key = 0;
+        int8_t value = 0;
+    };
+
+    struct TableHeader
+    {
+        char magic[4];
+        uint8_t version;
+        uint8_t rows;
+        uint8_t cols;
+        uint8_t win;
+        uint64_t entries;
+    };
+
+    static constexpr size_t RECORDSIZE = sizeof(uint64_t) + 1;
+
+    /**
+     * Columns ordered from the center out, central moves are searched first
+     */
+    static constexpr array<int, COLS> ORDER = []
+    {
+        array<int, COLS> order{};
+        for (int i = 0; i < COLS; ++i)
+        {
+            order[i] = COLS / 2 + (1 - 2 * (i % 2)) * (i + 1) / 2;
+        }
+        return order;
+    }();
+
+    vector<Entry> table;
+    uint64_t nodes = 0;
+    uint64_t budget = 0;
+    bool aborted = false;
+    uint64_t nextCheck = 0;
+    function<void()> progress;
+
+    static uint64_t playable(uint64_t mask)
+    {
+        return (mask + Board::BOTTOMMASK) & Board::BOARDMASK;
+    }
+
+    static Column columnOf(uint64_t cell)
+    {
+        return static_cast<Column>(__builtin_ctzll(cell) / Board::COLBITS);
+    }
+
+    /**
+     * Get the first of a set of columns in center-first order.
+     * @return The column, Column::INVALID for an empty set.
+     */
+    static Column firstInOrder(uint32_t columns)
+    {
+        for (int c : ORDER)
+        {
+            if (columns & (1u << c))
+            {
+                return static_cast<Column>(c);
+            }
+        }
+        return Column::INVALID;
+    }
+
+    /**
+     * Playable cells that do not hand the opponent an immediate win, see Board::nonLosingColumns.
+     */
+    static uint64_t nonLosing(uint64_t current, uint64_t mask)
+    {
+        uint64_t possible = playable(mask);
+        uint64_t opponentWin = Board::winningCells(current ^ mask, mask);
+        uint64_t forced = possible & opponentWin;
+        if (forced)
+        {
+            if (forced & (forced - 1))
+            {
+                return 0;
+            }
+            possible = forced;
+        }
+        return possible & ~(opponentWin >> 1);
+    }
+
+    /**
+     * Stop at the node budget and call the progress callback, one check covers both until the node count reaches nextCheck.
+     * @return True if the search has to stop.
+     */
+    bool checkNodes()
+    {
+        if (aborted || (budget && nodes >= budget))
+        {
+            aborted = true;
+            nextCheck = 0;
+            return true;
+        }
+        if (progress)
+        {
+            progress();
+        }
+        nextCheck = nodes + PROGRESSNODES;
+        if (budget)
+        {
+            nextCheck = min(nextCheck, budget);
+        }
+        return false;
+    }
+
+    /**
+     * Score of a position through a sequence of null-window searches, exact within (alpha, beta), otherwise a bound
+     * on the side of the window it lies on. The player to move must not have an immediate win.
+     */
+    int evaluate(uint64_t current, uint64_t mask, int moves, int alpha, int beta)
+    {
+        uint64_t wins = Board::winningCells(current, mask) & playable(mask);
+        if (wins)
+        {
+            return (CELLS + 1 - moves) / 2;
+        }
+
+        int min = std::max(-(CELLS - moves) / 2, alpha);
+        int max = std::min((CELLS + 1 - moves) / 2, beta);
+        while (min < max && !aborted)
+        {
+            int med = min + (max - min) / 2;
+            if (med <= 0 && min / 2 < med)
+            {
+                med = min / 2;
+            }
+            else if (med >= 0 && max / 2 > med)
+            {
+                med = max / 2;
+            }
+            int r = negamax(current, mask, moves, med, med + 1);
+            if (r <= med)
+            {
+                max = r;
+            }
+            else
+            {
+                min = r;
+            }
+        }
+        return min;
+    }
+
+    /**
+     * Alpha-beta search, the player to move must not have an immediate win.
+     * @return The score if it lies within (alpha, beta), otherwise a bound on the side of the window it lies on.
+     */
+    int negamax(uint64_t current, uint64_t mask, int moves, int alpha, int beta)
+    {
+        if (nodes >= nextCheck && checkNodes())
+        {
+            return alpha;
+        }
+        ++nodes;
+
+        uint64_t next = nonLosing(current, mask);
+        if (!next)
+        {
+            return -(CELLS - moves) / 2;
+        }
+        if (moves >= CELLS - 2)
+        {
+            return 0;
+        }
+
+        int min = -(CELLS - 2 - moves) / 2;
+        if (alpha < min)
+        {
+            alpha = min;
+            if (alpha >= beta)
+            {
+                return alpha;
+            }
+        }
+
+        uint64_t key = current + mask;
+        Entry &entry = table[key & (table.size() - 1)];
+        int max = (CELLS - 1 - moves) / 2;
+        if (entry.key == key && entry.value)
+        {
+            max = entry.value + MINSCORE - 1;
+        }
+        if (beta > max)
+        {
+            beta = max;
+            if (alpha >= beta)
+            {
+                return beta;
+            }
+        }
+
+        // order moves by the number of winning cells they create, center first on ties
+        StaticVector<pair<int, uint64_t>, COLS> ordered;
+        for (int i = COLS - 1; i >= 0; --i)
+        {
+            uint64_t move = next & Board::columnMask(ORDER[i]);
+            if (!move)
+            {
+                continue;
+            }
+            int score = __builtin_popcountll(Board::winningCells(current | move, mask | move));
+            auto it = ordered.end();
+            ordered.push_back({score, move});
+            // insertion sort, stable for equal scores so later (more central) columns stay in front
+            for (; it != ordered.begin() && (it - 1)->first <= score; --it)
+            {
+                *it = *(it - 1);
+            }
+            *it = {score, move};
+        }
+
+        for (const auto &candidate : ordered)
+        {
+            int score = -negamax(current ^ mask, mask | candidate.second, moves + 1, -beta, -alpha);
+            if (aborted)
+            {
+                return alpha;
+            }
+            if (score >= beta)
+            {
+                return score;
+            }
+            if (score > alpha)
+            {
+                alpha = score;
+            }
+        }
+
+        entry.key = key;
+        entry.value = static_cast<int8_t>(alpha - MINSCORE + 1);
+        return alpha;
+    }
+};
+
+/**
+ * Solver for the classic 6 x 7 board
+ */
+using Solver = BasicSolver<Connect4Board>;
+
+#endif // SOLVER_H
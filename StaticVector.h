@@ -0,0 +1,94 @@
+#ifndef STATIC_VECTOR_H
+#define STATIC_VECTOR_H
+
+#include "include.h"
+
+/**
+ * Vector with a fixed capacity that lives entirely inside the object, so it never allocates.
+ * Used for the small lists in the hot paths (possible moves, children of a node).
+ */
+template <typename T, size_t N>
+class StaticVector
+{
+public:
+    using value_type = T;
+    using iterator = T *;
+    using const_iterator = const T *;
+
+    StaticVector() = default;
+
+    StaticVector(initializer_list<T> values)
+    {
+        for (const T &value : values)
+        {
+            push_back(value);
+        }
+    }
+
+    /**
+     * Append a value at the end.
+     * @param value The value to append.
+     */
+    void push_back(const T &value)
+    {
+        if (count >= N)
+        {
+            throw length_error("StaticVector::push_back: capacity exceeded");
+        }
+        items[count++] = value;
+    }
+
+    /**
+     * Remove the last value.
+     */
+    void pop_back()
+    {
+        --count;
+    }
+
+    /**
+     * Remove the value at the given position, keeping the order of the others.
+     * @param pos The position to remove.
+     * @return Iterator to the value that followed the removed one.
+     */
+    iterator erase(iterator pos)
+    {
+        for (iterator it = pos; it + 1 != end(); ++it)
+        {
+            *it = *(it + 1);
+        }
+        --count;
+        return pos;
+    }
+
+    /**
+     * Remove all values.
+     */
+    void clear()
+    {
+        count = 0;
+    }
+
+    size_t size() const { return count; }
+    static constexpr size_t capacity() { return N; }
+    bool empty() const { return count == 0; }
+
+    T &operator[](size_t i) { return items[i]; }
+    const T &operator[](size_t i) const { return items[i]; }
+
+    T &front() { return items[0]; }
+    const T &front() const { return items[0]; }
+    T &back() { return items[count - 1]; }
+    const T &back() const { return items[count - 1]; }
+
+    iterator begin() { return items.data(); }
+    iterator end() { return items.data() + count; }
+    const_iterator begin() const { return items.data(); }
+    const_iterator end() const { return items.data() + count; }
+
+private:
+    array<T, N> items{};
+    size_t count = 0;
+};
+
+#endif // STATIC_VECTOR_H
@@ -0,0 +1,142 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "include.h"
+#include <condition_variable>
+#include <thread>
+
+/**
+ * Fixed set of worker threads running queued tasks.
+ * Every worker keeps its thread-local state (metrics cache, node pool, counters) warm across tasks.
+ */
+class ThreadPool
+{
+public:
+    /**
+     * Constructor for the ThreadPool class.
+     * @param threads The number of workers, 0 uses one per hardware thread.
+     */
+    explicit ThreadPool(size_t threads = 0)
+    {
+        if (threads == 0)
+        {
+            threads = max(1u, thread::hardware_concurrency());
+        }
+        workers.reserve(threads);
+        for (size_t i = 0; i < threads; ++i)
+        {
+            workers.emplace_back([this]
+                                 { work(); });
+        }
+    }
+
+    /**
+     * Finish all queued tasks and join the workers.
+     */
+    ~ThreadPool()
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        taskAvailable.notify_all();
+        for (thread &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * Queue a task.
+     * @param task The task, exceptions it throws are rethrown by wait().
+     */
+    void submit(function<void()> task)
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            tasks.push(std::move(task));
+            ++pending;
+        }
+        taskAvailable.notify_one();
+    }
+
+    /**
+     * Block until every submitted task has finished.
+     * Rethrows the first exception thrown by a task since the last wait().
+     */
+    void wait()
+    {
+        unique_lock<mutex> guard(lock);
+        allDone.wait(guard, [this]
+                     { return pending == 0; });
+        if (failure)
+        {
+            exception_ptr e = failure;
+            failure = nullptr;
+            rethrow_exception(e);
+        }
+    }
+
+    /**
+     * Get the number of workers.
+     * @return The number of workers.
+     */
+    size_t size() const
+    {
+        return workers.size();
+    }
+
+private:
+    vector<thread> workers;
+    queue<function<void()>> tasks;
+    mutex lock;
+    condition_variable taskAvailable;
+    condition_variable allDone;
+    size_t pending = 0;
+    bool stopping = false;
+    exception_ptr failure;
+
+    void work()
+    {
+        while (true)
+        {
+            function<void()> task;
+            {
+                unique_lock<mutex> guard(lock);
+                taskAvailable.wait(guard, [this]
+                                   { return stopping || !tasks.empty(); });
+                if (tasks.empty())
+                {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+
+            exception_ptr error;
+            try
+            {
+                task();
+            }
+            catch (...)
+            {
+                error = current_exception();
+            }
+
+            lock_guard<mutex> guard(lock);
+            if (error && !failure)
+            {
+                failure = error;
+            }
+            if (--pending == 0)
+            {
+                allDone.notify_all();
+            }
+        }
+    }
+};
+
+#endif // THREAD_POOL_H
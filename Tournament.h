@@ -0,0 +1,421 @@
+#ifndef TOURNAMENT_H
+#define TOURNAMENT_H
+
+#include "include.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <random>
+
+/**
+ * A player in a headless match.
+ * Every engine keeps its own board and sees itself as Player::BOT, its opponent as Player::USER.
+ */
+class Engine
+{
+public:
+    virtual ~Engine() = default;
+
+    /**
+     * Choose a move in the current position.
+     * @return The column to play.
+     */
+    virtual Column bestMove() = 0;
+
+    /**
+     * Apply a move to the engine's position.
+     * @param column The column played.
+     * @param own True if the engine played it, false if the opponent did.
+     */
+    virtual void play(Column column, bool own) = 0;
+};
+
+/**
+ * Engine backed by a GameTheorie, without DOT export.
+ */
+class GameTheorieEngine : public Engine
+{
+public:
+    /**
+     * Constructor for the GameTheorieEngine class.
+     * @param engineStarts True if the engine makes the first move.
+     * @param level_ The level used by getBestMove.
+     * @param depth The depth of the game tree.
+     * @param advancedPruning Whether the tree is pruned to the best bot move.
+     */
+    GameTheorieEngine(bool engineStarts, Level level_, int depth, bool advancedPruning)
+        : level(level_), brain(board, engineStarts ? Player::BOT : Player::USER, depth, level_, advancedPruning, false)
+    {
+    }
+
+    Column bestMove() override
+    {
+        return brain.getBestMove(level);
+    }
+
+    void play(Column column, bool own) override
+    {
+        brain.playMove(column, own ? Player::BOT : Player::USER);
+    }
+
+private:
+    Connect4Board board;
+    Level level;
+    GameTheorie brain;
+};
+
+/**
+ * A named engine configuration, creates a fresh engine for every game.
+ */
+struct EngineConfig
+{
+    string name;
+    function<unique_ptr<Engine>(bool engineStarts)> create;
+
+    /**
+     * Parse an engine specification.
+     * "level:depth:pruning", e.g. "hard:7:1", is a GameTheorie with that level, tree depth and advanced pruning on (1) or off (0).
+     * @param spec The specification.
+     * @return The configuration.
+     */
+    static EngineConfig parse(const string &spec)
+    {
+        vector<string> parts;
+        stringstream ss(spec);
+        string part;
+        while (getline(ss, part, ':'))
+        {
+            parts.push_back(part);
+        }
+        if (parts.size() != 3)
+        {
+            throw invalid_argument("Invalid engine specification: " + spec);
+        }
+
+        Level level;
+        if (parts[0] == "easy")
+        {
+            level = Level::EASY;
+        }
+        else if (parts[0] == "medium")
+        {
+            level = Level::MEDIUM;
+        }
+        else if (parts[0] == "hard")
+        {
+            level = Level::HARD;
+        }
+        else
+        {
+            throw invalid_argument("Invalid engine level: " + parts[0]);
+        }
+        int depth = stoi(parts[1]);
+        bool advancedPruning = parts[2] == "1";
+
+        return {spec, [level, depth, advancedPruning](bool engineStarts)
+                { return unique_ptr<Engine>(new GameTheorieEngine(engineStarts, level, depth, advancedPruning)); }};
+    }
+};
+
+/**
+ * Round robin between engine configurations, played on a thread pool.
+ * Every opening is played twice with the colours swapped; results only depend on the seed, not on the number of threads.
+ */
+class Tournament
+{
+public:
+    /**
+     * Win, draw and loss counts from the view of one engine
+     */
+    struct Score
+    {
+        int wins = 0;
+        int draws = 0;
+        int losses = 0;
+    };
+
+    /**
+     * Move statistics of one engine over all its games
+     */
+    struct EngineStats
+    {
+        int games = 0;
+        int errors = 0;
+        uint64_t nodes = 0;
+        vector<double> latencies;
+
+        double averageLatency() const
+        {
+            double sum = 0;
+            for (double l : latencies)
+            {
+                sum += l;
+            }
+            return latencies.empty() ? 0.0 : sum / latencies.size();
+        }
+
+        double percentileLatency(double p) const
+        {
+            if (latencies.empty())
+            {
+                return 0.0;
+            }
+            vector<double> sorted = latencies;
+            size_t k = min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()));
+            nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+            return sorted[k];
+        }
+    };
+
+    /**
+     * Constructor for the Tournament class.
+     * @param engines_ The engine configurations, every pair plays.
+     * @param gamesPerPair The games per pair, rounded up to an even number.
+     * @param openingMoves_ The number of random moves played before the engines take over.
+     * @param seed_ The seed of the openings.
+     */
+    Tournament(vector<EngineConfig> engines_, int gamesPerPair, int openingMoves_, uint32_t seed_)
+        : engines(std::move(engines_)), GAMESPERPAIR((gamesPerPair + 1) / 2 * 2), OPENINGMOVES(openingMoves_), SEED(seed_),
+          scores(engines.size(), vector<Score>(engines.size())), stats(engines.size())
+    {
+    }
+
+    /**
+     * Play all games.
+     * @param pool The workers, every game runs on a single worker.
+     */
+    void run(ThreadPool &pool)
+    {
+        auto start = chrono::steady_clock::now();
+        for (size_t a = 0; a < engines.size(); ++a)
+        {
+            for (size_t b = a + 1; b < engines.size(); ++b)
+            {
+                for (int game = 0; game < GAMESPERPAIR; ++game)
+                {
+                    pool.submit([this, a, b, game]
+                                { playGame(a, b, game); });
+                }
+            }
+        }
+        pool.wait();
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+
+    /**
+     * Print the W/D/L matrix, throughput and per-engine move statistics.
+     * @param os The stream to print to.
+     */
+    void print(ostream &os = cout) const
+    {
+        os << "W/D/L of the row engine against the column engine\n";
+        os << left << setw(16) << "";
+        for (size_t b = 0; b < engines.size(); ++b)
+        {
+            os << setw(16) << engines[b].name;
+        }
+        os << "\n";
+        for (size_t a = 0; a < engines.size(); ++a)
+        {
+            os << setw(16) << engines[a].name;
+            for (size_t b = 0; b < engines.size(); ++b)
+            {
+                const Score &s = scores[a][b];
+                os << setw(16) << (a == b ? string("-") : to_string(s.wins) + "/" + to_string(s.draws) + "/" + to_string(s.losses));
+            }
+            os << "\n";
+        }
+        os << right << "\n";
+
+        os << games << " games in " << seconds << " s, " << (seconds > 0 ? games / seconds : 0.0) << " games/sec\n\n";
+
+        os << left << setw(16) << "engine" << right << setw(8) << "games" << setw(10) << "moves" << setw(14) << "avg ms/move"
+           << setw(14) << "p99 ms/move" << setw(14) << "nodes/move" << setw(8) << "errors" << "\n";
+        for (size_t e = 0; e < engines.size(); ++e)
+        {
+            const EngineStats &s = stats[e];
+            size_t moves = s.latencies.size();
+            os << left << setw(16) << engines[e].name << right << setw(8) << s.games << setw(10) << moves
+               << setw(14) << s.averageLatency() << setw(14) << s.percentileLatency(0.99)
+               << setw(14) << (moves ? static_cast<double>(s.nodes) / moves : 0.0) << setw(8) << s.errors << "\n";
+        }
+        os << flush;
+    }
+
+    /**
+     * Append every finished game to a game log, the first mover is stored as Player::USER.
+     * @param log_ The log, nullptr to stop logging. Must outlive run().
+     */
+    void setGameLog(GameLogWriter *log_)
+    {
+        log = log_;
+    }
+
+    /**
+     * Get the score of one engine against another.
+     * @param a The engine.
+     * @param b The opponent.
+     * @return The W/D/L of a against b.
+     */
+    const Score &score(size_t a, size_t b) const
+    {
+        return scores[a][b];
+    }
+
+    /**
+     * Get the move statistics of an engine.
+     * @param e The engine.
+     * @return The statistics.
+     */
+    const EngineStats &engineStats(size_t e) const
+    {
+        return stats[e];
+    }
+
+private:
+    vector<EngineConfig> engines;
+    int GAMESPERPAIR;
+    int OPENINGMOVES;
+    uint32_t SEED;
+
+    mutex lock;
+    vector<vector<Score>> scores;
+    vector<EngineStats> stats;
+    int games = 0;
+    double seconds = 0.0;
+    GameLogWriter *log = nullptr;
+
+    /**
+     * Random opening without winning moves, shared by the two games of a colour-swapped pair.
+     */
+    vector<Column> opening(size_t a, size_t b, int game) const
+    {
+        mt19937 rng(SEED ^ static_cast<uint32_t>((a * 1000003 + b) * 1000003 + game / 2));
+        Connect4Board board;
+        Player player = Player::USER;
+        vector<Column> moves;
+        for (int i = 0; i < OPENINGMOVES; ++i)
+        {
+            uint32_t options = board.possibleColumns() & ~board.winningColumns(player);
+            if (!options)
+            {
+                break;
+            }
+            Column column;
+            do
+            {
+                column = static_cast<Column>(rng() % Connect4Board::COLS);
+            } while (!(options & (1u << column)));
+            board.dropDisc(column, player);
+            moves.push_back(column);
+            player = board.getOponent(player);
+        }
+        return moves;
+    }
+
+    void playGame(size_t a, size_t b, int game)
+    {
+        // even games: engine a moves first
+        array<size_t, 2> side = (game % 2 == 0) ? array<size_t, 2>{a, b} : array<size_t, 2>{b, a};
+        array<unique_ptr<Engine>, 2> players = {engines[side[0]].create(true), engines[side[1]].create(false)};
+        array<EngineStats, 2> local;
+
+        Connect4Board board;
+        array<Player, 2> colour = {Player::USER, Player::BOT};
+        int turn = 0;
+        int winner = -1;
+        vector<Column> moves = opening(a, b, game);
+
+        for (Column column : moves)
+        {
+            players[turn]->play(column, true);
+            players[1 - turn]->play(column, false);
+            board.dropDisc(column, colour[turn]);
+            turn = 1 - turn;
+        }
+
+        // time and nodes spent by an engine since its last move, including following the opponent's move
+        array<double, 2> pendingMs = {0.0, 0.0};
+        array<uint64_t, 2> pendingNodes = {0, 0};
+
+        while (!board.full())
+        {
+            auto start = chrono::steady_clock::now();
+            uint64_t nodes = SearchStats::snapshot().nodesCreated;
+            Column column = Column::INVALID;
+            try
+            {
+                column = players[turn]->bestMove();
+                if (column < 0 || column >= Connect4Board::COLS || board.findRow(column) < 0)
+                {
+                    throw runtime_error("illegal move");
+                }
+                players[turn]->play(column, true);
+            }
+            catch (const exception &)
+            {
+                // an engine that fails loses the game
+                ++local[turn].errors;
+                winner = 1 - turn;
+                break;
+            }
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            local[turn].latencies.push_back(pendingMs[turn] + ms);
+            local[turn].nodes += pendingNodes[turn] + SearchStats::snapshot().nodesCreated - nodes;
+            pendingMs[turn] = 0.0;
+            pendingNodes[turn] = 0;
+            moves.push_back(column);
+
+            if (board.dropDisc(column, colour[turn]))
+            {
+                winner = turn;
+                break;
+            }
+
+            int other = 1 - turn;
+            start = chrono::steady_clock::now();
+            nodes = SearchStats::snapshot().nodesCreated;
+            try
+            {
+                players[other]->play(column, false);
+            }
+            catch (const exception &)
+            {
+                ++local[other].errors;
+                winner = turn;
+                break;
+            }
+            pendingMs[other] += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            pendingNodes[other] += SearchStats::snapshot().nodesCreated - nodes;
+            turn = other;
+        }
+
+        lock_guard<mutex> guard(lock);
+        ++games;
+        for (int s = 0; s < 2; ++s)
+        {
+            EngineStats &total = stats[side[s]];
+            ++total.games;
+            total.errors += local[s].errors;
+            total.nodes += local[s].nodes;
+            total.latencies.insert(total.latencies.end(), local[s].latencies.begin(), local[s].latencies.end());
+        }
+        if (winner < 0)
+        {
+            ++scores[side[0]][side[1]].draws;
+            ++scores[side[1]][side[0]].draws;
+        }
+        else
+        {
+            ++scores[side[winner]][side[1 - winner]].wins;
+            ++scores[side[1 - winner]][side[winner]].losses;
+        }
+        if (log)
+        {
+            log->append(colour[0], GameLog::NOLEVEL, winner < 0 ? GameLog::DRAW : static_cast<GameLog::Result>(colour[winner]), moves);
+        }
+    }
+};
+
+#endif // TOURNAMENT_H
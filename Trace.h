@@ -0,0 +1,220 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "include.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+/**
+ * Compile-time switch for trace spans, off by default.
+ * Build with -DCONNECT4_TRACE=1 to record spans, otherwise TRACE_SCOPE compiles to nothing.
+ */
+#ifndef CONNECT4_TRACE
+#define CONNECT4_TRACE 0
+#endif
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#if CONNECT4_TRACE
+#define TRACE_SCOPE(name) Trace::Span TRACE_CONCAT(traceSpan, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) \
+    do                    \
+    {                     \
+    } while (0)
+#endif
+
+/**
+ * Timeline of scoped spans, exported as Chrome trace-event JSON (chrome://tracing, Perfetto).
+ * Every thread records into its own ring buffer without locks; when a buffer is full the oldest spans are overwritten.
+ * Only registering a thread and dumping take a lock.
+ */
+class Trace
+{
+public:
+    /**
+     * True if spans are recorded in this build
+     */
+    static constexpr bool ENABLED = CONNECT4_TRACE;
+
+    /**
+     * Number of spans kept per thread
+     */
+    static constexpr size_t CAPACITY = 1 << 15;
+
+    /**
+     * Records the time between its construction and destruction as a span.
+     */
+    class Span
+    {
+    public:
+        /**
+         * @param name_ The name of the span, must be a string literal (only the pointer is stored).
+         */
+        explicit Span(const char *name_) : name(name_), begin(now())
+        {
+        }
+
+        ~Span()
+        {
+            local().record(name, begin, now() - begin);
+        }
+
+        Span(const Span &) = delete;
+        Span &operator=(const Span &) = delete;
+
+    private:
+        const char *name;
+        uint64_t begin;
+    };
+
+    /**
+     * Write all recorded spans of all threads as Chrome trace-event JSON.
+     * Threads may keep recording while the trace is written.
+     * @param filename The output file.
+     * @return The number of spans written.
+     */
+    static size_t dump(const string &filename = "trace.json")
+    {
+        ofstream ofs(filename);
+        ofs << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+        size_t written = 0;
+        bool first = true;
+
+        Registry &r = registry();
+        lock_guard<mutex> guard(r.lock);
+        for (const shared_ptr<Buffer> &buffer : r.buffers)
+        {
+            ofs << (first ? "" : ",\n")
+                << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->tid
+                << ", \"args\": {\"name\": \"thread " << buffer->tid << "\"}}";
+            first = false;
+
+            for (const Event &e : buffer->read())
+            {
+                ofs << ",\n  {\"name\": \"" << e.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->tid
+                    << ", \"ts\": " << e.begin / 1000.0 << ", \"dur\": " << e.duration / 1000.0 << "}";
+                ++written;
+            }
+        }
+        ofs << "\n]}\n";
+        return written;
+    }
+
+    /**
+     * Drop the spans recorded so far.
+     * Must not be called while other threads are recording.
+     */
+    static void clear()
+    {
+        Registry &r = registry();
+        lock_guard<mutex> guard(r.lock);
+        for (const shared_ptr<Buffer> &buffer : r.buffers)
+        {
+            buffer->head.store(0, memory_order_release);
+        }
+    }
+
+private:
+    struct Event
+    {
+        const char *name;
+        uint64_t begin;
+        uint64_t duration;
+    };
+
+    /**
+     * Single-producer ring buffer of one thread.
+     * Slots are atomics so a concurrent dump never reads a torn value, spans it could have seen half-overwritten are dropped.
+     */
+    struct Buffer
+    {
+        struct Slot
+        {
+            atomic<const char *> name{nullptr};
+            atomic<uint64_t> begin{0};
+            atomic<uint64_t> duration{0};
+        };
+
+        unique_ptr<Slot[]> slots{new Slot[CAPACITY]};
+        atomic<uint64_t> head{0};
+        int tid = 0;
+
+        void record(const char *name, uint64_t begin, uint64_t duration)
+        {
+            uint64_t h = head.load(memory_order_relaxed);
+            Slot &slot = slots[h % CAPACITY];
+            slot.name.store(name, memory_order_relaxed);
+            slot.begin.store(begin, memory_order_relaxed);
+            slot.duration.store(duration, memory_order_relaxed);
+            head.store(h + 1, memory_order_release);
+        }
+
+        vector<Event> read() const
+        {
+            uint64_t end = head.load(memory_order_acquire);
+            uint64_t start = end > CAPACITY ? end - CAPACITY : 0;
+            vector<Event> events;
+            events.reserve(end - start);
+            for (uint64_t i = start; i < end; ++i)
+            {
+                const Slot &slot = slots[i % CAPACITY];
+                events.push_back({slot.name.load(memory_order_relaxed), slot.begin.load(memory_order_relaxed), slot.duration.load(memory_order_relaxed)});
+            }
+
+            // spans the writer may have overwritten while they were copied are unreliable, including the slot of
+            // index after, which a record that has not published its head yet may be writing
+            atomic_thread_fence(memory_order_acquire);
+            uint64_t after = head.load(memory_order_relaxed);
+            uint64_t valid = after + 1 > CAPACITY ? after + 1 - CAPACITY : 0;
+            if (valid > start)
+            {
+                events.erase(events.begin(), events.begin() + min<uint64_t>(valid - start, events.size()));
+            }
+            return events;
+        }
+    };
+
+    struct Registry
+    {
+        mutex lock;
+        vector<shared_ptr<Buffer>> buffers;
+    };
+
+    static Registry &registry()
+    {
+        static Registry instance;
+        return instance;
+    }
+
+    /**
+     * Get the buffer of the calling thread, registered on first use.
+     * The registry shares ownership, so spans of finished threads are still dumped.
+     */
+    static Buffer &local()
+    {
+        static thread_local shared_ptr<Buffer> buffer = []
+        {
+            auto b = make_shared<Buffer>();
+            Registry &r = registry();
+            lock_guard<mutex> guard(r.lock);
+            b->tid = static_cast<int>(r.buffers.size()) + 1;
+            r.buffers.push_back(b);
+            return b;
+        }();
+        return *buffer;
+    }
+
+    /**
+     * Nanoseconds since the first span of the process.
+     */
+    static uint64_t now()
+    {
+        static const chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+        return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - epoch).count());
+    }
+};
+
+#endif // TRACE_H
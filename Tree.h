@@ -2,22 +2,122 @@
 #define TREE_H
 
 #include "include.h"
+#include <deque>
 
-class TreeNode;
-inline void deleteSubtree(TreeNode *node);
+template <typename Board>
+class BasicTreeNode;
+template <typename Board>
+inline void deleteSubtree(BasicTreeNode<Board> *node);
+template <typename Board>
+class BasicExpansionCursor;
 
-class TreeNode
+/**
+ * Memory footprint of a game tree, kept up to date by every tree operation that adds or removes nodes.
+ */
+struct TreeMemory
+{
+    /**
+     * Bytes taken by a single node
+     */
+    size_t nodeBytes = 0;
+
+    int64_t nodes = 0;
+    int64_t peakNodes = 0;
+
+    /**
+     * Nodes on every level, only filled in by Tree::printMemory because it has to walk the tree
+     */
+    array<int64_t, SearchCounters::MAXLEVELS> nodesPerLevel{};
+
+    /**
+     * Nodes the last moveRootUp detached from the tree and handed to the reclaimer
+     */
+    int64_t lastReclaimed = 0;
+    int64_t totalReclaimed = 0;
+
+    /**
+     * Nodes of a tree loaded from a snapshot that are still only in the mapped file
+     */
+    int64_t mappedNodes = 0;
+
+    /**
+     * Nodes of previous roots and their other branches, kept so moves can be taken back (not part of nodes)
+     */
+    int64_t historyNodes = 0;
+
+    size_t bytes() const
+    {
+        return static_cast<size_t>(nodes) * nodeBytes;
+    }
+
+    size_t peakBytes() const
+    {
+        return static_cast<size_t>(peakNodes) * nodeBytes;
+    }
+
+    /**
+     * Print the footprint.
+     * @param os The stream to print to.
+     */
+    void print(ostream &os = cout) const
+    {
+        os << "Tree: " << nodes << " nodes, " << bytes() / 1024.0 << " KiB (peak " << peakNodes << " nodes, " << peakBytes() / 1024.0 << " KiB)\n";
+        os << "Bytes per level:";
+        for (int level = 0; level < SearchCounters::MAXLEVELS; ++level)
+        {
+            if (nodesPerLevel[level] != 0)
+            {
+                os << " L" << level << "=" << nodesPerLevel[level] * static_cast<int64_t>(nodeBytes);
+            }
+        }
+        os << "\n";
+        os << "moveRootUp: released " << lastReclaimed << " nodes (total " << totalReclaimed << ")" << endl;
+        if (mappedNodes != 0)
+        {
+            os << "Snapshot: " << mappedNodes << " nodes mapped, not yet promoted" << endl;
+        }
+        if (historyNodes != 0)
+        {
+            os << "History: " << historyNodes << " nodes kept for takebacks" << endl;
+        }
+    }
+};
+
+/**
+ * Node of the game tree for a board type.
+ * @tparam Board The board the tree is built for, e.g. Connect4Board.
+ */
+template <typename Board>
+class BasicTreeNode
 {
 public:
+    /**
+     * Fixed-capacity list of children, a node has at most one child per column.
+     */
+    using ChildList = StaticVector<BasicTreeNode *, Board::COLS>;
+
     Column move;
-    string label;
+    const char *label;
     int level;
     Player owner;
     TileMetrics metrics;
     int id;
-    static int nextId;
+    static inline atomic<int> nextId{0};
     int row;
-    vector<TreeNode *> children;
+    ChildList children;
+
+    /**
+     * True if this node mirrors a sibling in a left-right symmetric position.
+     * Its subtree is the mirror image of the sibling's, so it is only expanded once it becomes the root;
+     * until then scores are backed up to it from the sibling (see GameTheorie::backUp).
+     */
+    bool mirrored = false;
+
+    /**
+     * Number of nodes in the subtree of this node, itself included.
+     * Kept up to date by the expansion cursor and the tree, so moving the root does not walk the kept subtree.
+     */
+    uint32_t subtreeNodes = 1;
 
     /**
      * Constructor for TreeNode
@@ -28,16 +128,70 @@ public:
      * @param metrics_ The metrics associated with this node.
      * @param row_ The row where the move is made (default -1).
      */
-    TreeNode(Column move_ = Column::INVALID, const string label_ = "", int level_ = 0, Player owner_ = Player::EMPTY, TileMetrics metrics_ = {0, 0, false, false, false}, int row_ = -1)
-        : move(move_), label(label_), level(level_), owner(owner_), metrics(metrics_), id(nextId++), row(row_), children()
+    BasicTreeNode(Column move_ = Column::INVALID, const char *label_ = "", int level_ = 0, Player owner_ = Player::EMPTY, TileMetrics metrics_ = {0, 0, false, false, false, -1, false}, int row_ = -1)
+        : move(move_), label(label_), level(level_), owner(owner_), metrics(metrics_), id(nextId.fetch_add(1, memory_order_relaxed)), row(row_), children()
+    {
+        LiveNodes &l = live();
+        ++l.nodes;
+        ++l.perLevel[SearchCounters::levelSlot(level)];
+    }
+
+    ~BasicTreeNode()
     {
+        LiveNodes &l = live();
+        --l.nodes;
+        --l.perLevel[SearchCounters::levelSlot(level)];
+    }
+
+    BasicTreeNode(const BasicTreeNode &) = delete;
+    BasicTreeNode &operator=(const BasicTreeNode &) = delete;
+
+    /**
+     * Number of nodes alive on a thread, in total and per level
+     */
+    struct LiveNodes
+    {
+        int64_t nodes = 0;
+        array<int64_t, SearchCounters::MAXLEVELS> perLevel{};
+    };
+
+    /**
+     * Get the nodes created and not yet deleted by the calling thread.
+     * @return The live node counts of the calling thread.
+     */
+    static LiveNodes &live()
+    {
+        static thread_local LiveNodes instance;
+        return instance;
+    }
+
+    /**
+     * Nodes are allocated from a pool, so growing the tree does not hit the heap for every node.
+     */
+    static void *operator new(size_t size)
+    {
+        if (size != sizeof(BasicTreeNode))
+        {
+            return ::operator new(size);
+        }
+        return NodePool<BasicTreeNode>::allocate();
+    }
+
+    static void operator delete(void *p, size_t size)
+    {
+        if (size != sizeof(BasicTreeNode))
+        {
+            ::operator delete(p);
+            return;
+        }
+        NodePool<BasicTreeNode>::deallocate(p);
     }
 
     /**
      * Add an existing TreeNode as child
      * @param child The child node to add.
      */
-    void addChild(TreeNode *child)
+    void addChild(BasicTreeNode *child)
     {
         if (child)
         {
@@ -54,27 +208,37 @@ public:
         int depth = 0,
         bool root = false) const
     {
-        if (root)
-        {
-            cout << "Root Node: " << label << endl;
-        }
-        else
+        // explicit stack, children are pushed in reverse to print them in order
+        vector<pair<const BasicTreeNode *, int>> stack = {{this, depth}};
+        while (!stack.empty())
         {
-            for (int i = 0; i < depth; ++i)
+            const BasicTreeNode *node = stack.back().first;
+            int d = stack.back().second;
+            stack.pop_back();
+            if (root && node == this)
             {
-                cout << "  ";
-                cout << "Node " << id << ": " << label
-                     << " W=" << (metrics.winningMove ? "1" : "0") << " T=" << (metrics.immediateThreat ? "1" : "0") << " t=" << (metrics.minorThreat ? "1" : "0") << " p=" << metrics.pressure << " w=" << metrics.winOptions << endl;
+                cout << "Root Node: " << label << endl;
+            }
+            else
+            {
+                for (int i = 0; i < d; ++i)
+                {
+                    cout << "  ";
+                    cout << "Node " << node->id << ": " << node->label
+                         << " W=" << (node->metrics.winningMove ? "1" : "0") << " T=" << (node->metrics.immediateThreat ? "1" : "0") << " t=" << (node->metrics.minorThreat ? "1" : "0") << " p=" << node->metrics.pressure << " w=" << node->metrics.winOptions << endl;
+                }
+            }
+            for (size_t i = node->children.size(); i-- > 0;)
+            {
+                stack.push_back({node->children[i], d + 1});
             }
-        }
-        for (const auto *child : children)
-        {
-            child->print(depth + 1);
         }
     }
 
     /**
      * Add a layer of child nodes to this node.
+     * Nodes without children are expanded, nodes with children pass the layer on to them, down to the given depth.
+     * Runs an expansion cursor to completion, see BasicExpansionCursor to expand in time slices.
      * @param board The current state of the game board.
      * @param depth The remaining depth to explore.
      * @param currentLayer The current layer of the tree.
@@ -83,34 +247,39 @@ public:
      * @return True if the layer was added successfully, false otherwise.
      */
     bool addLayer(
-        Connect4Board &board,
+        Board &board,
         int depth,
         int currentLayer,
         bool advancedPruning = true,
         Player startingPlayer = Player::EMPTY)
     {
-        Player player = board.getOponent(owner);
-        Player opponent = owner;
+        BasicExpansionCursor<Board> cursor(this, board, depth, currentLayer, advancedPruning, startingPlayer);
+        cursor.run();
+        return true;
+    }
 
-        if (depth <= 0 || board.full() || metrics.winningMove)
-        {
-            return true;
-        }
-        if (!children.empty())
-        {
-            for (TreeNode *child : children)
-            {
-                int r_child = board.findRow(child->move);
-                board.dropDisc(child->move, player);
-                child->addLayer(board, depth - 1, child->level, advancedPruning);
-                board.setCell(r_child, child->move, Player::EMPTY);
-            }
-            return true;
-        }
+    /**
+     * Create the children of this node, without descending into them.
+     * @param board The position of this node.
+     * @param currentLayer The layer of this node, the children are on the next one.
+     * @param advancedPruning Whether to use advanced pruning techniques.
+     * @param startingPlayer The player who started the game (used for pruning).
+     */
+    void expand(
+        Board &board,
+        int currentLayer,
+        bool advancedPruning,
+        Player startingPlayer)
+    {
+        Player player = board.getOponent(owner);
+        SearchStats::Slot &stats = SearchStats::local();
+        ++stats.expansions;
+        ++stats.expansionsPerLevel[SearchCounters::levelSlot(currentLayer)];
 
-        vector<Column> moves = board.getPossibleMoves();
-        vector<TreeNode *> candidateChildren;
+        typename Board::MoveList moves = board.getPossibleMoves();
+        ChildList candidateChildren;
         bool hasWin = false;
+        uint32_t nonLosing = board.nonLosingColumns(player);
 
         // calculate possible children
         for (Column column : moves)
@@ -120,46 +289,29 @@ public:
             {
                 continue;
             }
-            TileMetrics tileMetrics = Metrics::generateMetricsForTile(board, player, r_play, column);
+            TileMetrics tileMetrics = BasicMetrics<Board>::generateMetricsForTile(board, player, r_play, column);
+            ++stats.metricEvaluations;
 
-            board.setCell(r_play, column, player);
-
-            bool oppCanWin = false;
-            for (Column oppCol : board.getPossibleMoves())
-            {
-                int r_opp = board.findRow(oppCol);
-                if (r_opp < 0)
-                {
-                    continue;
-                }
-                board.setCell(r_opp, oppCol, opponent);
-                if (board.checkWin(opponent))
-                {
-                    oppCanWin = true;
-                }
-                board.setCell(r_opp, oppCol, Player::EMPTY);
-                if (oppCanWin)
-                {
-                    break;
-                }
-            }
+            // a winning move ends the game, the cell it opens for the opponent does not matter
+            bool oppCanWin = !tileMetrics.winningMove && !(nonLosing & (1u << column));
 
             if (oppCanWin && player == Player::BOT)
             {
-                board.setCell(r_play, column, Player::EMPTY);
+                ++stats.prunedOppCanWin;
                 continue;
             }
 
-            TreeNode *child = new TreeNode(
+            BasicTreeNode *child = new BasicTreeNode(
                 column,
-                Connect4Board::colToChar(column),
+                Board::columnLabel(column),
                 currentLayer + 1,
                 player,
                 tileMetrics,
                 board.ROWS - r_play);
 
             candidateChildren.push_back(child);
-            board.setCell(r_play, column, Player::EMPTY);
+            ++stats.nodesCreated;
+            ++stats.nodesPerLevel[SearchCounters::levelSlot(currentLayer + 1)];
 
             if (tileMetrics.winningMove && player == Player::BOT)
             {
@@ -176,6 +328,7 @@ public:
                 {
                     deleteSubtree(*it);
                     it = candidateChildren.erase(it);
+                    ++stats.prunedHasWin;
                 }
                 else
                 {
@@ -188,7 +341,7 @@ public:
         if (advancedPruning && player == Player::BOT)
         {
 
-            TreeNode *bestChild = selectBestBotChild(candidateChildren, startingPlayer);
+            BasicTreeNode *bestChild = selectBestBotChild(candidateChildren, startingPlayer);
 
             if (!bestChild && !candidateChildren.empty())
             {
@@ -206,45 +359,75 @@ public:
                 {
                     deleteSubtree(*it);
                     it = candidateChildren.erase(it);
+                    ++stats.prunedBestChild;
                 }
             }
         }
 
         if (candidateChildren.empty())
         {
-            vector<Column> fallbackMoves = board.getPossibleMoves();
+            typename Board::MoveList fallbackMoves = board.getPossibleMoves();
             if (!fallbackMoves.empty())
             {
                 Column fallbackCol = fallbackMoves.front();
                 int r_play = board.findRow(fallbackCol);
                 if (r_play >= 0)
                 {
-                    TileMetrics tileMetrics = Metrics::generateMetricsForTile(board, board.getOponent(player), r_play, fallbackCol);
-                    TreeNode *fallback = new TreeNode(
+                    TileMetrics tileMetrics = BasicMetrics<Board>::generateMetricsForTile(board, board.getOponent(player), r_play, fallbackCol);
+                    ++stats.metricEvaluations;
+                    BasicTreeNode *fallback = new BasicTreeNode(
                         fallbackCol,
-                        Connect4Board::colToChar(fallbackCol),
+                        Board::columnLabel(fallbackCol),
                         currentLayer + 1,
                         board.getOponent(player),
                         tileMetrics,
                         board.ROWS - r_play);
                     candidateChildren.push_back(fallback);
+                    ++stats.nodesCreated;
+                    ++stats.fallbackNodes;
+                    ++stats.nodesPerLevel[SearchCounters::levelSlot(currentLayer + 1)];
                 }
             }
         }
 
-        for (TreeNode *child : candidateChildren)
+        if (board.isSymmetric())
+        {
+            markMirroredChildren(candidateChildren);
+        }
+
+        for (BasicTreeNode *child : candidateChildren)
         {
             children.push_back(child);
-            int row = board.findRow(child->move);
-            board.setCell(row, child->move, player);
-            if (!child->metrics.winningMove)
+            if (child->mirrored)
             {
-                child->addLayer(board, depth - 1, child->level, advancedPruning);
+                ++stats.mirroredNodes;
             }
-            board.setCell(row, child->move, Player::EMPTY);
         }
+    }
 
-        return true;
+    /**
+     * Mark the children of a symmetric position that mirror a sibling on the left half of the board.
+     * Their metrics are computed as usual, only their subtrees are skipped.
+     * @param candidates The children of a left-right symmetric position.
+     */
+    static void markMirroredChildren(ChildList &candidates)
+    {
+        for (BasicTreeNode *child : candidates)
+        {
+            Column twin = Board::mirrorColumn(child->move);
+            if (twin >= child->move)
+            {
+                continue;
+            }
+            for (BasicTreeNode *other : candidates)
+            {
+                if (other->move == twin)
+                {
+                    child->mirrored = true;
+                    break;
+                }
+            }
+        }
     }
 
     /**
@@ -252,7 +435,7 @@ public:
      * @param child The child node to remove.
      * @return True if the child was removed successfully, false otherwise.
      */
-    bool removeChild(TreeNode *child)
+    bool removeChild(BasicTreeNode *child)
     {
         auto it = find(children.begin(), children.end(), child);
         if (it != children.end())
@@ -272,12 +455,12 @@ public:
     {
         for (size_t i = 0; i < children.size();)
         {
-            TreeNode *child = children[i];
+            BasicTreeNode *child = children[i];
 
             if (child->move != col)
             {
                 children.erase(children.begin() + i);
-
+                subtreeNodes -= child->subtreeNodes;
                 deleteSubtree(child);
             }
             else
@@ -298,6 +481,7 @@ public:
         {
             if (child->move == column)
             {
+                subtreeNodes -= child->subtreeNodes;
                 deleteSubtree(child);
                 removeChild(child);
             }
@@ -321,20 +505,20 @@ public:
      * @param startingPlayer The player who is making the move.
      * @return The best child node for the bot player.
      */
-    TreeNode *selectBestBotChild(
-        const std::vector<TreeNode *> &candidates,
+    BasicTreeNode *selectBestBotChild(
+        const ChildList &candidates,
         Player startingPlayer)
     {
         bool botPrefersOddWin = (startingPlayer == Player::BOT);
-        TreeNode *bestChild = nullptr;
-        TreeNode *threatChild = nullptr;
-        TreeNode *minorThreatChild = nullptr;
+        BasicTreeNode *bestChild = nullptr;
+        BasicTreeNode *threatChild = nullptr;
+        BasicTreeNode *minorThreatChild = nullptr;
 
         int bestScore = -1;
         int pressure = -1;
         bool enablesOpponentThreatFound = false;
 
-        for (TreeNode *child : candidates)
+        for (BasicTreeNode *child : candidates)
         {
             if (!child)
             {
@@ -437,45 +621,377 @@ public:
  * Delete the entire subtree rooted at the given node.
  * @param node The root of the subtree to delete.
  */
-inline void deleteSubtree(TreeNode *node)
+template <typename Board>
+inline void deleteSubtree(BasicTreeNode<Board> *node)
 {
     if (!node)
     {
         return;
     }
-    for (TreeNode *child : node->children)
+    if (node->children.empty())
     {
-        deleteSubtree(child);
+        delete node;
+        return;
+    }
+    vector<BasicTreeNode<Board> *> stack = {node};
+    while (!stack.empty())
+    {
+        BasicTreeNode<Board> *current = stack.back();
+        stack.pop_back();
+        for (BasicTreeNode<Board> *child : current->children)
+        {
+            stack.push_back(child);
+        }
+        current->children.clear();
+        delete current;
     }
-    node->children.clear();
-    delete node;
 }
 
-int TreeNode::nextId = 0;
+/**
+ * Resumable depth-first expansion of a subtree, the iterative form of TreeNode::addLayer.
+ * The path from the start node to the current node is kept on an explicit stack, so the expansion can be stopped
+ * after any number of nodes and resumed later. The cursor works on its own copy of the board, the caller's board is
+ * never touched. The nodes below the start node must not be changed or deleted while the cursor is not done.
+ * @tparam Board The board the tree is built for, e.g. Connect4Board.
+ */
+template <typename Board>
+class BasicExpansionCursor
+{
+public:
+    using Node = BasicTreeNode<Board>;
+
+    /**
+     * Constructor for the ExpansionCursor class.
+     * @param start The node to expand from.
+     * @param board_ The position of the start node.
+     * @param depth The number of layers to explore below the start node.
+     * @param currentLayer The layer of the start node.
+     * @param advancedPruning_ Whether to use advanced pruning techniques.
+     * @param startingPlayer The player who started the game, used for pruning at the start node.
+     */
+    BasicExpansionCursor(Node *start, const Board &board_, int depth, int currentLayer, bool advancedPruning_ = true, Player startingPlayer = Player::EMPTY)
+        : board(board_), advancedPruning(advancedPruning_)
+    {
+        visit(start, depth, currentLayer, startingPlayer);
+    }
+
+    /**
+     * Continue the expansion.
+     * @param budget The maximum number of nodes to visit.
+     * @return True if the expansion is finished.
+     */
+    bool step(size_t budget)
+    {
+        while (!stack.empty() && budget > 0)
+        {
+            Frame &frame = stack.back();
+            Node *node = frame.node;
+            // take back the disc of the child visited last
+            if (frame.row >= 0)
+            {
+                board.setCell(frame.row, node->children[frame.next - 1]->move, Player::EMPTY);
+                frame.row = -1;
+            }
+            while (frame.next < node->children.size() && node->children[frame.next]->mirrored)
+            {
+                ++frame.next;
+            }
+            if (frame.next == node->children.size())
+            {
+                stack.pop_back();
+                continue;
+            }
+
+            Node *child = node->children[frame.next++];
+            int row = board.findRow(child->move);
+            if (row < 0)
+            {
+                // not an index check: children exist only for columns with space, so the tree and the board disagree
+                throw logic_error(string("ExpansionCursor::step: column ") + Board::colToChar(child->move) + " of a child is full");
+            }
+            board.setCell(row, child->move, board.getOponent(node->owner));
+            frame.row = row;
+            int depth = frame.depth;
+            visit(child, depth - 1, child->level, Player::EMPTY);
+            --budget;
+        }
+        return stack.empty();
+    }
+
+    /**
+     * Finish the expansion.
+     */
+    void run()
+    {
+        while (!step(numeric_limits<size_t>::max()))
+        {
+        }
+    }
+
+    /**
+     * Check if the expansion is finished.
+     * @return True if every node was visited.
+     */
+    bool done() const
+    {
+        return stack.empty();
+    }
+
+    /**
+     * Get the number of nodes visited so far.
+     * @return The number of nodes.
+     */
+    uint64_t visited() const
+    {
+        return visits;
+    }
+
+private:
+    /**
+     * A node on the current path, with the next child to visit and the row of the disc placed for the last one
+     */
+    struct Frame
+    {
+        Node *node;
+        int depth;
+        size_t next;
+        int row;
+    };
+
+    Board board;
+    bool advancedPruning;
+    // every frame below the top placed a disc, so the path is at most one node per cell plus the start node
+    StaticVector<Frame, Board::ROWS * Board::COLS + 1> stack;
+    uint64_t visits = 0;
+
+    void visit(Node *node, int depth, int currentLayer, Player startingPlayer)
+    {
+        ++visits;
+        if (depth <= 0 || board.full() || node->metrics.winningMove)
+        {
+            return;
+        }
+        if (node->children.empty())
+        {
+            node->expand(board, currentLayer, advancedPruning, startingPlayer);
+            // the frames are the path from the start node, the counts above it are the caller's
+            uint32_t added = static_cast<uint32_t>(node->children.size());
+            node->subtreeNodes += added;
+            for (Frame &frame : stack)
+            {
+                frame.node->subtreeNodes += added;
+            }
+        }
+        stack.push_back({node, depth, 0, -1});
+    }
+};
 
-class Tree
+/**
+ * Game tree for a board type.
+ * @tparam Board The board the tree is built for, e.g. Connect4Board.
+ */
+template <typename Board>
+class BasicTree
 {
 public:
-    TreeNode *ROOT;
+    using Node = BasicTreeNode<Board>;
+    using Snapshot = BasicTreeSnapshot<Board>;
+    using ExpansionCursor = BasicExpansionCursor<Board>;
+
+    Node *ROOT;
     int layers = 0;
     int DEPTH = 0;
     bool ADVANCEDPRUNING = true;
     Player STARTINGPLAYER = Player::EMPTY;
 
-    Tree(Connect4Board &board,
+    /**
+     * If true, updateTree exports the tree to DOTFILE.dot and DOTFILE.svg after every move
+     */
+    bool EXPORTDOT = true;
+
+    /**
+     * Path of the exported tree without extension, every tree that exports needs its own when trees run side by side
+     */
+    string DOTFILE = "tree";
+
+    /**
+     * Number of previous roots kept by moveRootUp, so moveRootBack can take that many moves back without rebuilding
+     */
+    size_t HISTORY = 0;
+
+    /**
+     * Constructor for the Tree class, builds the tree or loads it from a snapshot.
+     * A loaded tree only creates the root and its children; the deeper nodes are read from the mapped snapshot
+     * and promoted to nodes when the tree first changes (see promote).
+     * @param board The position the tree starts from.
+     * @param startingPlayer The player who makes the first move.
+     * @param depth The depth of the tree.
+     * @param advancedPruning Whether the tree is pruned to the best bot move.
+     * @param snapshot Snapshot file used if it holds the same tree, otherwise the tree is built and saved to it. Empty to always build.
+     */
+    BasicTree(Board &board,
          Player startingPlayer,
-         int depth, bool advancedPruning = true) : DEPTH(depth), ADVANCEDPRUNING(advancedPruning), STARTINGPLAYER(startingPlayer)
+         int depth, bool advancedPruning = true, const string &snapshot = "") : DEPTH(depth), ADVANCEDPRUNING(advancedPruning), STARTINGPLAYER(startingPlayer), GROWNDEPTH(depth), EXPANDEDDEPTH(depth)
     {
+        MEMORY.nodeBytes = NodePool<Node>::BLOCKSIZE;
+        typename Snapshot::Config config;
+        config.boardKey = board.key();
+        config.depth = depth;
+        config.advancedPruning = advancedPruning;
+        config.startingPlayer = static_cast<uint8_t>(startingPlayer);
 
-        ROOT = new TreeNode(Column::A, "Root", 0, board.getOponent(startingPlayer), TileMetrics{-1, -1, false, false, false, -1, false});
-        ROOT->addLayer(board, depth, 0, advancedPruning);
+        if (!snapshot.empty())
+        {
+            TRACE_SCOPE("Tree::load");
+            SNAPSHOT = Snapshot::open(snapshot, config);
+            if (SNAPSHOT)
+            {
+                accounted([&]
+                          {
+                    ROOT = SNAPSHOT->node(0);
+                    const typename Snapshot::PackedNode &root = SNAPSHOT->at(0);
+                    for (uint32_t i = root.firstChild; i < root.firstChild + root.childCount; ++i)
+                    {
+                        Node *child = SNAPSHOT->node(i);
+                        ROOT->children.push_back(child);
+                        ++ROOT->subtreeNodes;
+                        pending.push_back({child, i});
+                    } });
+                MEMORY.mappedNodes = static_cast<int64_t>(SNAPSHOT->size()) - MEMORY.nodes;
+                return;
+            }
+        }
+
+        {
+            TRACE_SCOPE("Tree::build");
+            accounted([&]
+                      {
+                ROOT = new Node(Column::A, "Root", 0, board.getOponent(startingPlayer), TileMetrics{-1, -1, false, false, false, -1, false});
+                ROOT->addLayer(board, depth, 0, advancedPruning); });
+        }
+        if (!snapshot.empty())
+        {
+            TRACE_SCOPE("Tree::save");
+            Snapshot::save(ROOT, config, snapshot);
+        }
+    }
+
+    /**
+     * Check if part of the tree is still read from a snapshot.
+     * @return True until the tree is promoted.
+     */
+    bool isMapped() const
+    {
+        return SNAPSHOT != nullptr;
+    }
+
+    /**
+     * Create the nodes that are still in the snapshot, every operation that changes or walks the whole tree calls this first.
+     * @param keep Only the subtree of the root child in this column is needed, the others are dropped; Column::INVALID for all.
+     */
+    void promote(Column keep = Column::INVALID)
+    {
+        if (!SNAPSHOT)
+        {
+            return;
+        }
+        TRACE_SCOPE("Tree::promote");
+        accounted([&]
+                  {
+            for (const auto &entry : pending)
+            {
+                if (keep == Column::INVALID || entry.first->move == keep)
+                {
+                    SNAPSHOT->expand(entry.first, entry.second);
+                    countSubtrees(entry.first);
+                    ROOT->subtreeNodes += entry.first->subtreeNodes - 1;
+                }
+            } });
+        pending.clear();
+        SNAPSHOT.reset();
+        MEMORY.mappedNodes = 0;
+    }
+
+    /**
+     * Get the memory footprint of the tree.
+     * @return The footprint, updated by every tree operation.
+     */
+    const TreeMemory &memory() const
+    {
+        return MEMORY;
+    }
+
+    /**
+     * Print the memory footprint of the tree, the memory reserved by the node pool and the reclaimer backlog.
+     * Walks the tree for the nodes per level.
+     */
+    void printMemory() const
+    {
+        TreeMemory memory = MEMORY;
+        memory.nodesPerLevel = countLevels();
+        memory.print();
+        cout << "Node pool: " << NodePool<Node>::reservedBytes() / 1024.0 << " KiB reserved" << endl;
+        const Reclaimer<Node> &reclaimer = Reclaimer<Node>::shared();
+        cout << "Reclaimer: " << reclaimer.pending() << " nodes pending, " << reclaimer.freed() << " freed" << endl;
+    }
+
+    /**
+     * Set the subtree counts of a subtree whose nodes were created without them, e.g. from a snapshot.
+     * @param node The root of the subtree.
+     */
+    static void countSubtrees(Node *node)
+    {
+        // breadth first, so every node comes after its parent and the counts add up from the back
+        vector<Node *> order = {node};
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            for (Node *child : order[i]->children)
+            {
+                order.push_back(child);
+            }
+        }
+        for (size_t i = order.size(); i-- > 0;)
+        {
+            order[i]->subtreeNodes = 1;
+            for (const Node *child : order[i]->children)
+            {
+                order[i]->subtreeNodes += child->subtreeNodes;
+            }
+        }
+    }
+
+    /**
+     * Count the nodes reachable from a node.
+     * @param node The root of the subtree.
+     * @return The number of nodes in the subtree.
+     */
+    static int64_t countNodes(const Node *node)
+    {
+        if (!node)
+        {
+            return 0;
+        }
+        int64_t count = 0;
+        vector<const Node *> stack = {node};
+        while (!stack.empty())
+        {
+            const Node *current = stack.back();
+            stack.pop_back();
+            ++count;
+            for (const Node *child : current->children)
+            {
+                stack.push_back(child);
+            }
+        }
+        return count;
     }
 
     /**
      * Print the tree structure.
      */
-    void print() const
+    void print()
     {
+        promote();
         if (ROOT)
         {
             ROOT->print(0, true);
@@ -486,8 +1002,11 @@ public:
      * Export the tree structure to a Graphviz DOT file.
      * @param filename The name of the output DOT file, default is "tree.dot".
      */
-    void toDot(const string &filename = "tree.dot") const
+    void toDot(const string &filename = "tree.dot")
     {
+        TRACE_SCOPE("Tree::toDot");
+        SearchStats::PhaseTimer timer(SearchCounters::TODOT);
+        promote();
         ofstream ofs(filename);
         ofs << "digraph G {\n"
                "  rankdir=LR;\n"
@@ -496,8 +1015,7 @@ public:
 
         if (ROOT)
         {
-            string dfs_ = dfs(ROOT, true);
-            ofs << dfs_;
+            writeDot(ROOT, ofs, true);
         }
         ofs << "}\n";
         ofs.close();
@@ -510,10 +1028,55 @@ public:
      * @return The DOT representation of the subtree.
      */
     string dfs(
-        const TreeNode *node,
+        const Node *node,
+        bool root = false) const
+    {
+        ostringstream os;
+        writeDot(node, os, root);
+        return os.str();
+    }
+
+    /**
+     * Write the DOT representation of a subtree, depth first with an explicit stack.
+     * Every edge is written right before the subtree it leads to.
+     * @param node The root of the subtree.
+     * @param os The stream to write to.
+     * @param root Whether this is the root node.
+     */
+    void writeDot(
+        const Node *node,
+        ostream &os,
         bool root = false) const
     {
+        // a node and the parent whose edge leads to it, nullptr for the start node
+        vector<pair<const Node *, const Node *>> stack = {{node, nullptr}};
+        while (!stack.empty())
+        {
+            const Node *current = stack.back().first;
+            const Node *parent = stack.back().second;
+            stack.pop_back();
+            if (parent)
+            {
+                os << "  node" << parent->id << " -> node" << current->id << ";\n";
+            }
+            os << dotNode(current, root && !parent);
+            for (size_t i = current->children.size(); i-- > 0;)
+            {
+                stack.push_back({current->children[i], current});
+            }
+        }
+    }
 
+    /**
+     * Get the DOT statement of a single node.
+     * @param node The node.
+     * @param root Whether this is the root node.
+     * @return The node statement.
+     */
+    string dotNode(
+        const Node *node,
+        bool root) const
+    {
         bool displayMetrics = true; // Set to false to disable metrics display
         string color;
         switch (node->owner)
@@ -550,7 +1113,7 @@ public:
         {
             if (displayMetrics)
             {
-                ofs += "  node" + to_string(node->id) + " [label=\"" + to_string(node->level) + ") " + Connect4Board::colToChar(node->move) + to_string(node->row) +
+                ofs += "  node" + to_string(node->id) + " [label=\"" + to_string(node->level) + ") " + Board::colToChar(node->move) + to_string(node->row) +
                        " W=" + (node->metrics.winningMove ? "1" : "0") +
                        " T=" + (node->metrics.immediateThreat ? "1" : "0") +
                        " t=" + (node->metrics.minorThreat ? "1" : "0") +
@@ -560,19 +1123,12 @@ public:
             }
             else
             {
-                ofs += "  node" + to_string(node->id) + " [label=\"" + to_string(node->level) + ") " + Connect4Board::colToChar(node->move) + to_string(node->row) + ": " + to_string(node->id) +
+                ofs += "  node" + to_string(node->id) + " [label=\"" + to_string(node->level) + ") " + Board::colToChar(node->move) + to_string(node->row) + ": " + to_string(node->id) +
                        "\", fillcolor=\"" + color + "\"];\n";
             }
         }
-        for (const TreeNode *child : node->children)
-        {
-            ofs += "  node" + to_string(node->id) + " -> node" + to_string(child->id) + ";\n";
-            string dfsChild = dfs(child, false);
-            ofs += dfsChild;
-        }
-
         return ofs;
-    };
+    }
 
     /**
      * Emit edges from the current node to its children.
@@ -580,17 +1136,26 @@ public:
      * @param ofs The output stream to write the edges to.
      */
     void emitEdges(
-        const TreeNode *node,
+        const Node *node,
         ofstream &ofs) const
     {
         if (!node)
         {
             return;
         }
-        for (const TreeNode *child : node->children)
+        vector<const Node *> stack = {node};
+        while (!stack.empty())
         {
-            ofs << "  node" << node->id << " -> node" << child->id << ";\n";
-            emitEdges(child, ofs);
+            const Node *current = stack.back();
+            stack.pop_back();
+            for (const Node *child : current->children)
+            {
+                ofs << "  node" << current->id << " -> node" << child->id << ";\n";
+            }
+            for (size_t i = current->children.size(); i-- > 0;)
+            {
+                stack.push_back(current->children[i]);
+            }
         }
     }
 
@@ -603,6 +1168,8 @@ public:
         const string &dotFile = "tree.dot",
         const string &svgFile = "tree.svg") const
     {
+        TRACE_SCOPE("Tree::dotToSvg");
+        SearchStats::PhaseTimer timer(SearchCounters::DOTTOSVG);
         string command = "dot -Tsvg " + dotFile + " -o " + svgFile;
         int ret = system(command.c_str());
         if (ret != 0)
@@ -618,11 +1185,138 @@ public:
      * @param levels The number of levels to grow (default is 1).
      */
     void grow(
-        Connect4Board &currentBoard,
+        Board &currentBoard,
         int levels = 1)
     {
-        ROOT->addLayer(currentBoard, levels, layers);
-        layers++;
+        startGrow(currentBoard, levels);
+        growStep(numeric_limits<size_t>::max());
+    }
+
+    /**
+     * Start growing the tree in slices, the tree is grown by calling growStep until it returns true.
+     * The tree stays usable between the slices: every node is either fully expanded or not at all.
+     * A grow that is still running is cancelled.
+     * @param currentBoard The current state of the Connect 4 board, copied.
+     * @param levels The number of levels to grow (default is 1).
+     */
+    void startGrow(
+        const Board &currentBoard,
+        int levels = 1)
+    {
+        cancelGrow();
+        promote();
+        // the cursor expands the root right away if it has no children
+        accounted([&]
+                  { GROWTH = make_shared<ExpansionCursor>(ROOT, currentBoard, levels, layers, ADVANCEDPRUNING); });
+        GROWTHLEVELS = levels;
+        EXPANDEDDEPTH = max(EXPANDEDDEPTH, levels);
+    }
+
+    /**
+     * Continue growing the tree.
+     * @param budget The maximum number of nodes to visit in this slice.
+     * @return True if the grow is finished (or none was started).
+     */
+    bool growStep(size_t budget)
+    {
+        if (!GROWTH)
+        {
+            return true;
+        }
+        TRACE_SCOPE("Tree::grow");
+        SearchStats::PhaseTimer timer(SearchCounters::GROW);
+        bool done = false;
+        accounted([&]
+                  { done = GROWTH->step(budget); });
+        if (done)
+        {
+            GROWTH.reset();
+            layers++;
+            GROWNDEPTH = max(GROWNDEPTH, GROWTHLEVELS);
+        }
+        return done;
+    }
+
+    /**
+     * Get the number of plies below the root that are fully grown.
+     * Lines that end earlier (a win, a full board) count as grown.
+     * @return The plies every grow since the root was set has covered.
+     */
+    int grownDepth() const
+    {
+        return GROWNDEPTH;
+    }
+
+    /**
+     * Cut the tree back to a number of plies below the root, deeper nodes are handed to the reclaimer.
+     * @param depth The plies to keep.
+     */
+    void trim(int depth)
+    {
+        if (EXPANDEDDEPTH <= depth)
+        {
+            return;
+        }
+        TRACE_SCOPE("Tree::trim");
+        cancelGrow();
+        promote();
+        // breadth first down to the cut, so the counts of the kept nodes add up from the back afterwards
+        vector<pair<Node *, int>> order = {{ROOT, 0}};
+        vector<Node *> cut;
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            Node *node = order[i].first;
+            for (Node *child : node->children)
+            {
+                if (order[i].second < depth)
+                {
+                    order.push_back({child, order[i].second + 1});
+                }
+                else
+                {
+                    cut.push_back(child);
+                }
+            }
+            if (order[i].second >= depth)
+            {
+                node->children.clear();
+            }
+        }
+        int64_t kept = ROOT->subtreeNodes;
+        for (size_t i = order.size(); i-- > 0;)
+        {
+            Node *node = order[i].first;
+            node->subtreeNodes = 1;
+            for (const Node *child : node->children)
+            {
+                node->subtreeNodes += child->subtreeNodes;
+            }
+        }
+        int64_t removed = kept - ROOT->subtreeNodes;
+        if (!cut.empty())
+        {
+            Reclaimer<Node>::shared().retire(cut, removed);
+        }
+        MEMORY.nodes -= removed;
+        GROWNDEPTH = min(GROWNDEPTH, depth);
+        EXPANDEDDEPTH = depth;
+    }
+
+    /**
+     * Check if a grow was started and is not finished.
+     * @return True while growStep has work left.
+     */
+    bool growing() const
+    {
+        return GROWTH != nullptr;
+    }
+
+    /**
+     * Stop a running grow, nodes expanded so far stay in the tree and are passed by the next grow.
+     */
+    void cancelGrow()
+    {
+        GROWTH.reset();
     }
 
     /**
@@ -630,32 +1324,138 @@ public:
      * This will replace the current root with the specified node.
      * @param newRoot The new root node to set.
      */
-    void setRoot(TreeNode *newRoot)
+    void setRoot(Node *newRoot)
     {
+        cancelGrow();
+        promote();
         ROOT = newRoot;
     }
 
     /**
      * Move the root node up by removing all branches except the specified column.
      * This will effectively make the child of the current root the new root.
+     * The old root and its other branches are kept for moveRootBack while there are at most HISTORY previous roots,
+     * the oldest beyond that are handed to the reclaimer and freed in the background, so the move returns right away.
+     * If the move was pruned from the tree, the new root is a fresh node that the next grow expands.
      * @param column The column to keep as the new root.
      */
     void moveRootUp(Column column)
     {
-        ROOT->removeAllBranchesExcept(column);
+        TRACE_SCOPE("Tree::moveRootUp");
+        SearchStats::PhaseTimer timer(SearchCounters::MOVEROOTUP);
+        // only the subtree of the played move is needed, unless the others are kept for takebacks
+        cancelGrow();
+        promote(HISTORY > 0 ? Column::INVALID : column);
+        PreviousRoot previous;
+        previous.root = ROOT;
+        previous.layers = layers;
+        previous.grownDepth = GROWNDEPTH;
+        previous.expandedDepth = EXPANDEDDEPTH;
+        accounted([&]
+                  {
+            for (Node *child : ROOT->children)
+            {
+                if (child->move == column)
+                {
+                    previous.played = child;
+                }
+            }
+            if (!previous.played)
+            {
+                Player mover = ROOT->owner == Player::BOT ? Player::USER : Player::BOT;
+                previous.played = new Node(column, Board::columnLabel(column), ROOT->level + 1, mover);
+                previous.fresh = true;
+            }
+            setRoot(previous.played); });
+        GROWNDEPTH = previous.fresh ? 0 : max(0, GROWNDEPTH - 1);
+        EXPANDEDDEPTH = previous.fresh ? 0 : max(0, EXPANDEDDEPTH - 1);
+
+        // the tree only counts what is still reachable, the rest moves to the history
+        previous.nodes = MEMORY.nodes - ROOT->subtreeNodes;
+        previous.playedNodes = ROOT->subtreeNodes;
+        MEMORY.nodes = ROOT->subtreeNodes;
+        previousRoots.push_back(previous);
+        MEMORY.historyNodes += previous.nodes;
 
-        if (ROOT->children.empty())
+        int64_t released = 0;
+        while (previousRoots.size() > HISTORY)
         {
-            throw runtime_error("No children found for the current root. Cannot move root up.");
+            released += forget(previousRoots.front());
+            previousRoots.pop_front();
         }
+        MEMORY.lastReclaimed = released;
+        MEMORY.totalReclaimed += released;
+    }
 
-        for (TreeNode *it : ROOT->children)
+    /**
+     * Take the last moveRootUp back, the previous root becomes the root again with all its branches.
+     * Nodes grown below the played move since are kept.
+     * @return False if no previous root is kept.
+     */
+    bool moveRootBack()
+    {
+        if (previousRoots.empty())
         {
-            if (it->move == column)
-            {
-                setRoot(it);
-            }
+            return false;
+        }
+        TRACE_SCOPE("Tree::moveRootBack");
+        cancelGrow();
+        PreviousRoot previous = previousRoots.back();
+        previousRoots.pop_back();
+        if (previous.fresh)
+        {
+            // the played move was not in the tree, its subtree hangs off nothing
+            Reclaimer<Node>::shared().retire(ROOT, MEMORY.nodes);
+            MEMORY.nodes = 0;
         }
+        else
+        {
+            // nodes grown below the played move since count for the previous root as well
+            previous.root->subtreeNodes += ROOT->subtreeNodes - previous.playedNodes;
+        }
+        // the played move may have been grown deeper or trimmed since
+        GROWNDEPTH = previous.fresh ? previous.grownDepth : min(previous.grownDepth, GROWNDEPTH + 1);
+        EXPANDEDDEPTH = previous.fresh ? previous.expandedDepth : max(previous.expandedDepth, EXPANDEDDEPTH + 1);
+        ROOT = previous.root;
+        layers = previous.layers;
+        MEMORY.nodes += previous.nodes;
+        MEMORY.peakNodes = max(MEMORY.peakNodes, MEMORY.nodes);
+        MEMORY.historyNodes -= previous.nodes;
+        return true;
+    }
+
+    /**
+     * Get the number of moves moveRootBack can take back.
+     * @return The number of previous roots kept.
+     */
+    size_t historySize() const
+    {
+        return previousRoots.size();
+    }
+
+    /**
+     * Detach the whole tree and hand it to the reclaimer, the tree is empty afterwards.
+     */
+    void release()
+    {
+        cancelGrow();
+        while (!previousRoots.empty())
+        {
+            forget(previousRoots.front());
+            previousRoots.pop_front();
+        }
+        // subtrees still in the snapshot have no nodes to free
+        pending.clear();
+        SNAPSHOT.reset();
+        MEMORY.mappedNodes = 0;
+        if (ROOT)
+        {
+            Reclaimer<Node>::shared().retire(ROOT, MEMORY.nodes);
+            ROOT = nullptr;
+        }
+        MEMORY.nodes = 0;
+        GROWNDEPTH = 0;
+        EXPANDEDDEPTH = 0;
     }
 
     /**
@@ -666,23 +1466,172 @@ public:
      * @param debug Whether to enable debug output.
      */
     void updateTree(
-        Connect4Board &board,
+        Board &board,
         Column column,
         bool debug = false)
     {
+        TRACE_SCOPE("Tree::updateTree");
         if (!ROOT)
         {
             throw runtime_error("Tree root is not initialized.");
         }
         if (debug)
         {
-            cout << "Updating tree with root: " << Connect4Board::colToChar(column) << endl;
+            cout << "Updating tree with root: " << Board::colToChar(column) << endl;
         }
         moveRootUp(column);
         grow(board, DEPTH);
-        toDot();
-        dotToSvg();
+        if (EXPORTDOT)
+        {
+            toDot(DOTFILE + ".dot");
+            dotToSvg(DOTFILE + ".dot", DOTFILE + ".svg");
+        }
+    }
+
+private:
+    TreeMemory MEMORY;
+
+    /**
+     * The snapshot the tree was loaded from, until it is promoted
+     */
+    shared_ptr<const Snapshot> SNAPSHOT;
+
+    /**
+     * The running grow and the plies it grows, see startGrow
+     */
+    shared_ptr<ExpansionCursor> GROWTH;
+    int GROWTHLEVELS = 0;
+
+    /**
+     * Plies below the root that are fully grown, see grownDepth
+     */
+    int GROWNDEPTH = 0;
+
+    /**
+     * Plies below the root that a grow may have expanded, cancelled grows included; trim has nothing to cut below them
+     */
+    int EXPANDEDDEPTH = 0;
+
+    /**
+     * Root children whose subtrees are still in the snapshot, with their snapshot index
+     */
+    StaticVector<pair<Node *, uint32_t>, Board::COLS> pending;
+
+    /**
+     * A root replaced by moveRootUp
+     */
+    struct PreviousRoot
+    {
+        Node *root = nullptr;
+
+        /**
+         * The child that became the root, it is the root of the next previous root or the current root
+         */
+        Node *played = nullptr;
+
+        /**
+         * True if the played move was pruned and its node was created by moveRootUp, it is not a child of root
+         */
+        bool fresh = false;
+
+        int layers = 0;
+        int grownDepth = 0;
+        int expandedDepth = 0;
+
+        /**
+         * Nodes of root and its other branches
+         */
+        int64_t nodes = 0;
+
+        /**
+         * Subtree count of the played move when it became the root
+         */
+        uint32_t playedNodes = 0;
+    };
+
+    /**
+     * Previous roots, the last one is the parent of the current root
+     */
+    deque<PreviousRoot> previousRoots;
+
+    /**
+     * Detach the played move from a previous root and hand the rest to the reclaimer.
+     * @param previous The previous root, it must be the oldest.
+     * @return The number of nodes handed over.
+     */
+    int64_t forget(const PreviousRoot &previous)
+    {
+        typename Node::ChildList &children = previous.root->children;
+        for (size_t i = 0; i < children.size(); ++i)
+        {
+            if (children[i] == previous.played)
+            {
+                children.erase(children.begin() + i);
+                break;
+            }
+        }
+        Reclaimer<Node>::shared().retire(previous.root, previous.nodes);
+        MEMORY.historyNodes -= previous.nodes;
+        return previous.nodes;
+    }
+
+    /**
+     * Run an operation on the tree and account for the nodes it creates and deletes on this thread.
+     * @param operation The operation.
+     */
+    template <typename Operation>
+    void accounted(Operation &&operation)
+    {
+        typename Node::LiveNodes before = Node::live();
+        try
+        {
+            operation();
+        }
+        catch (...)
+        {
+            account(before);
+            throw;
+        }
+        account(before);
+    }
+
+    void account(const typename Node::LiveNodes &before)
+    {
+        const typename Node::LiveNodes &after = Node::live();
+        MEMORY.nodes += after.nodes - before.nodes;
+        MEMORY.peakNodes = max(MEMORY.peakNodes, MEMORY.nodes);
+    }
+
+    /**
+     * Count the nodes reachable from the root per level.
+     * @return The number of nodes on every level.
+     */
+    array<int64_t, SearchCounters::MAXLEVELS> countLevels() const
+    {
+        array<int64_t, SearchCounters::MAXLEVELS> levels{};
+        vector<const Node *> stack;
+        if (ROOT)
+        {
+            stack.push_back(ROOT);
+        }
+        while (!stack.empty())
+        {
+            const Node *node = stack.back();
+            stack.pop_back();
+            ++levels[SearchCounters::levelSlot(node->level)];
+            for (const Node *child : node->children)
+            {
+                stack.push_back(child);
+            }
+        }
+        return levels;
     }
 };
 
+/**
+ * Game tree for the classic 6 x 7 board
+ */
+using TreeNode = BasicTreeNode<Connect4Board>;
+using Tree = BasicTree<Connect4Board>;
+
 #endif // TREE_H
\ No newline at end of file
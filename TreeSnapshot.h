@@ -0,0 +1,252 @@
+#ifndef TREE_SNAPSHOT_H
+#define TREE_SNAPSHOT_H
+
+#include "include.h"
+#include <cstring>
+#include <memory>
+
+template <typename Board>
+class BasicTreeNode;
+
+/**
+ * Pointer-free binary snapshot of a game tree, memory-mapped read-only.
+ *
+ * Layout: a header with the board size and the settings the tree was built with, then the nodes in breadth-first order.
+ * The children of a node are stored next to each other and referenced by the index of the first child and their count,
+ * so the file can be used straight from the page cache and shared by every process that maps it.
+ * @tparam Board The board the tree is built for, e.g. Connect4Board.
+ */
+template <typename Board>
+class BasicTreeSnapshot
+{
+public:
+    using Node = BasicTreeNode<Board>;
+
+    static constexpr char MAGIC[4] = {'C', '4', 'T', 'S'};
+    static constexpr uint8_t VERSION = 1;
+
+    /**
+     * What a tree was built from, a snapshot is only used for the same settings
+     */
+    struct Config
+    {
+        uint64_t boardKey;
+        int32_t depth;
+        uint8_t advancedPruning;
+        uint8_t startingPlayer;
+
+        bool operator==(const Config &other) const
+        {
+            return boardKey == other.boardKey && depth == other.depth && advancedPruning == other.advancedPruning &&
+                   startingPlayer == other.startingPlayer;
+        }
+    };
+
+    struct Header
+    {
+        char magic[4];
+        uint8_t version;
+        uint8_t rows;
+        uint8_t cols;
+        uint8_t win;
+        Config config;
+        uint64_t nodes;
+    };
+
+    /**
+     * A node with packed metrics
+     */
+    struct PackedNode
+    {
+        uint32_t firstChild;
+        uint8_t childCount;
+        int8_t move;
+        int8_t row;
+        uint8_t level;
+        uint8_t owner;
+        uint8_t flags;
+        int8_t preferredWinningRow;
+        uint8_t reserved;
+        int16_t pressure;
+        int16_t winOptions;
+    };
+    static_assert(sizeof(PackedNode) == 16, "packed nodes are written as raw bytes");
+
+    enum Flags
+    {
+        WINNINGMOVE = 1,
+        IMMEDIATETHREAT = 2,
+        MINORTHREAT = 4,
+        ENABLESOPPONENTTHREAT = 8,
+        MIRRORED = 16
+    };
+
+    /**
+     * Write a tree.
+     * @param root The root of the tree.
+     * @param config The settings the tree was built with.
+     * @param path The snapshot file, replaced atomically.
+     * @return The number of nodes written.
+     */
+    static size_t save(const Node *root, const Config &config, const string &path)
+    {
+        vector<PackedNode> packed;
+        vector<const Node *> order = {root};
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            const Node *node = order[i];
+            packed.push_back(pack(node, static_cast<uint32_t>(order.size())));
+            for (const Node *child : node->children)
+            {
+                order.push_back(child);
+            }
+        }
+
+        Header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.rows = Board::ROWS;
+        header.cols = Board::COLS;
+        header.win = Board::WIN;
+        header.config = config;
+        header.nodes = packed.size();
+        string temporary = path + ".tmp";
+        ofstream ofs(temporary, ios::binary | ios::trunc);
+        ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char *>(packed.data()), static_cast<streamsize>(packed.size() * sizeof(PackedNode)));
+        ofs.close();
+        if (ofs.fail() || rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            remove(temporary.c_str());
+            throw runtime_error("Cannot write tree snapshot " + path);
+        }
+        return packed.size();
+    }
+
+    /**
+     * Map a snapshot.
+     * @param path The snapshot file.
+     * @param expected The settings of the tree that is needed.
+     * @return The snapshot, nullptr if the file does not exist or holds a different tree.
+     */
+    static shared_ptr<const BasicTreeSnapshot> open(const string &path, const Config &expected)
+    {
+        ifstream probe(path, ios::binary);
+        if (!probe)
+        {
+            return nullptr;
+        }
+        probe.close();
+
+        shared_ptr<BasicTreeSnapshot> snapshot(new BasicTreeSnapshot(path));
+        const uint8_t *data = snapshot->file.data();
+        size_t size = snapshot->file.size();
+        if (size < sizeof(Header))
+        {
+            return nullptr;
+        }
+        Header header;
+        memcpy(&header, data, sizeof(header));
+        if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.rows != Board::ROWS ||
+            header.cols != Board::COLS || header.win != Board::WIN || !(header.config == expected) || header.nodes == 0 ||
+            size != sizeof(Header) + header.nodes * sizeof(PackedNode))
+        {
+            return nullptr;
+        }
+        snapshot->nodes = reinterpret_cast<const PackedNode *>(data + sizeof(Header));
+        snapshot->count = header.nodes;
+        return snapshot;
+    }
+
+    /**
+     * Get the number of nodes.
+     * @return The number of nodes.
+     */
+    size_t size() const
+    {
+        return count;
+    }
+
+    /**
+     * Get a packed node.
+     * @param index The index of the node, 0 is the root.
+     * @return The node.
+     */
+    const PackedNode &at(uint32_t index) const
+    {
+        if (index >= count)
+        {
+            throw out_of_range("Tree snapshot node " + to_string(index));
+        }
+        return nodes[index];
+    }
+
+    /**
+     * Create a node without children.
+     * @param index The index of the node.
+     * @return The node, owned by the caller.
+     */
+    Node *node(uint32_t index) const
+    {
+        const PackedNode &p = at(index);
+        TileMetrics metrics{p.pressure, p.winOptions, (p.flags & IMMEDIATETHREAT) != 0, (p.flags & MINORTHREAT) != 0,
+                            (p.flags & WINNINGMOVE) != 0, p.preferredWinningRow, (p.flags & ENABLESOPPONENTTHREAT) != 0};
+        Column move = static_cast<Column>(p.move);
+        Node *n = new Node(move, index == 0 ? "Root" : Board::columnLabel(move), p.level, static_cast<Player>(p.owner), metrics, p.row);
+        n->mirrored = (p.flags & MIRRORED) != 0;
+        return n;
+    }
+
+    /**
+     * Create the subtree below a node.
+     * @param parent The node created for the index.
+     * @param index The index of the node.
+     */
+    void expand(Node *parent, uint32_t index) const
+    {
+        vector<pair<Node *, uint32_t>> stack = {{parent, index}};
+        while (!stack.empty())
+        {
+            pair<Node *, uint32_t> top = stack.back();
+            stack.pop_back();
+            const PackedNode &p = at(top.second);
+            for (uint32_t i = 0; i < p.childCount; ++i)
+            {
+                Node *child = node(p.firstChild + i);
+                top.first->children.push_back(child);
+                stack.push_back({child, p.firstChild + i});
+            }
+        }
+    }
+
+private:
+    MappedFile file;
+    const PackedNode *nodes = nullptr;
+    size_t count = 0;
+
+    explicit BasicTreeSnapshot(const string &path) : file(path, MappedFile::RANDOM)
+    {
+    }
+
+    static PackedNode pack(const Node *node, uint32_t firstChild)
+    {
+        const TileMetrics &m = node->metrics;
+        PackedNode p{};
+        p.firstChild = node->children.empty() ? 0 : firstChild;
+        p.childCount = static_cast<uint8_t>(node->children.size());
+        p.move = static_cast<int8_t>(node->move);
+        p.row = static_cast<int8_t>(node->row);
+        p.level = static_cast<uint8_t>(node->level);
+        p.owner = static_cast<uint8_t>(node->owner);
+        p.flags = static_cast<uint8_t>((m.winningMove ? WINNINGMOVE : 0) | (m.immediateThreat ? IMMEDIATETHREAT : 0) |
+                                       (m.minorThreat ? MINORTHREAT : 0) | (m.enablesOpponentThreat ? ENABLESOPPONENTTHREAT : 0) |
+                                       (node->mirrored ? MIRRORED : 0));
+        p.preferredWinningRow = static_cast<int8_t>(m.preferredWinningRow);
+        p.pressure = static_cast<int16_t>(m.pressure);
+        p.winOptions = static_cast<int16_t>(m.winOptions);
+        return p;
+    }
+};
+
+#endif // TREE_SNAPSHOT_H
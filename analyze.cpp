@@ -0,0 +1,361 @@
+#include "include.h"
+#include "Solver.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <map>
+
+/**
+ * Analysis settings shared by all workers
+ */
+struct AnalyzeConfig
+{
+    bool useSolver = true;
+    uint64_t budget = 0;
+    size_t ttEntries = size_t(1) << 20;
+    Level level = Level::HARD;
+    int depth = 5;
+    bool advancedPruning = true;
+};
+
+/**
+ * Parse an input line into a position.
+ * A line is either a move string ("DDC", empty for the start position) or "board:" followed by
+ * ROWS x COLS cells row by row from the top, '.' empty, 'X' first player, 'O' second player.
+ * The first player is Player::USER.
+ * @param line The input line.
+ * @param board Receives the position.
+ * @param toMove Receives the player to move.
+ * @return An error message, empty if the line is valid.
+ */
+string parsePosition(const string &line, Connect4Board &board, Player &toMove)
+{
+    const string prefix = "board:";
+    if (line.compare(0, prefix.size(), prefix) == 0)
+    {
+        string cells = line.substr(prefix.size());
+        if (cells.size() != static_cast<size_t>(Connect4Board::ROWS * Connect4Board::COLS))
+        {
+            return "expected " + to_string(Connect4Board::ROWS * Connect4Board::COLS) + " cells";
+        }
+        int first = 0;
+        int second = 0;
+        for (int r = Connect4Board::ROWS - 1; r >= 0; --r)
+        {
+            for (int c = 0; c < Connect4Board::COLS; ++c)
+            {
+                char cell = cells[r * Connect4Board::COLS + c];
+                if (cell == '.')
+                {
+                    continue;
+                }
+                if ((cell != 'X' && cell != 'O') || (r + 1 < Connect4Board::ROWS && board.getCell(r + 1, c) == Player::EMPTY))
+                {
+                    return string("invalid cell ") + cell + " in row " + to_string(r) + " column " + Connect4Board::colToChar(static_cast<Column>(c));
+                }
+                board.setCell(r, c, cell == 'X' ? Player::USER : Player::BOT);
+                ++(cell == 'X' ? first : second);
+            }
+        }
+        if (first != second && first != second + 1)
+        {
+            return "invalid disc counts";
+        }
+        if (board.checkWin(Player::USER) || board.checkWin(Player::BOT))
+        {
+            return "game over";
+        }
+        toMove = first == second ? Player::USER : Player::BOT;
+        return "";
+    }
+
+    toMove = Player::USER;
+    for (size_t i = 0; i < line.size(); ++i)
+    {
+        Column column = Column::INVALID;
+        try
+        {
+            column = Connect4Board::charToColumn(line[i]);
+        }
+        catch (const invalid_argument &)
+        {
+        }
+        if (column == Column::INVALID || column >= Connect4Board::COLS || board.findRow(column) < 0)
+        {
+            return string("illegal move ") + line[i] + " at " + to_string(i + 1);
+        }
+        if (board.dropDisc(column, toMove))
+        {
+            return "game over";
+        }
+        toMove = board.getOponent(toMove);
+    }
+    return "";
+}
+
+/**
+ * Analyze one position.
+ * @return The result line, "<input> bestmove <column> score <s> exact <0|1> nodes <n> time <us>" or "<input> error <message>".
+ * The game tree engine has no game-theoretic score, it reports the heuristic of its move as "eval <e>" in place of "score <s>".
+ */
+string analyzeLine(const string &line, const AnalyzeConfig &config)
+{
+    auto start = chrono::steady_clock::now();
+    Connect4Board board;
+    Player toMove;
+    string error = parsePosition(line, board, toMove);
+    if (error.empty() && board.full())
+    {
+        error = "board full";
+    }
+    if (!error.empty())
+    {
+        return line + " error " + error;
+    }
+
+    Column best;
+    string score; // the solver's "score", the tree's heuristic "eval"
+    bool exact;
+    uint64_t nodes;
+    if (config.useSolver)
+    {
+        // one solver, with its own transposition table, per worker
+        thread_local Solver solver(config.ttEntries);
+        Solver::Result result = solver.solve(board, toMove, config.budget);
+        best = result.bestMove;
+        score = " score " + to_string(result.score);
+        exact = result.exact;
+        nodes = result.nodes;
+    }
+    else
+    {
+        // the player to move is the bot
+        if (toMove == Player::USER)
+        {
+            for (int r = 0; r < Connect4Board::ROWS; ++r)
+            {
+                for (int c = 0; c < Connect4Board::COLS; ++c)
+                {
+                    Player cell = board.getCell(r, c);
+                    if (cell != Player::EMPTY)
+                    {
+                        board.setCell(r, c, board.getOponent(cell));
+                    }
+                }
+            }
+        }
+        uint64_t before = SearchStats::snapshot().nodesCreated;
+        GameTheorie brain(board, Player::BOT, config.depth, config.level, config.advancedPruning, false);
+        best = brain.getBestMove(config.level);
+        TileMetrics metrics = Metrics::generateMetricsForTile(board, Player::BOT, board.findRow(best), best);
+        score = " eval " + to_string(metrics.winningMove ? Solver::MAXSCORE : brain.moveScore(metrics));
+        exact = false;
+        nodes = SearchStats::snapshot().nodesCreated - before;
+    }
+
+    auto us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+    return line + " bestmove " + Connect4Board::colToChar(best) + score + " exact " + to_string(exact) +
+           " nodes " + to_string(nodes) + " time " + to_string(us);
+}
+
+/**
+ * Streams lines through a thread pool and writes the results in input order.
+ * At most WINDOW lines are in flight (queued, analyzing or waiting to be written), so memory stays bounded.
+ */
+class OrderedPipeline
+{
+public:
+    /**
+     * Constructor for the OrderedPipeline class.
+     * @param pool_ The workers.
+     * @param window The maximum number of lines in flight.
+     * @param work_ Turns an input line into an output line, runs on the workers.
+     */
+    OrderedPipeline(ThreadPool &pool_, size_t window, function<string(const string &)> work_)
+        : pool(pool_), WINDOW(window), work(std::move(work_))
+    {
+    }
+
+    /**
+     * Read all lines, analyze them and write the results.
+     * @param in The input.
+     * @param out The output.
+     * @return The number of lines processed.
+     */
+    uint64_t run(istream &in, ostream &out)
+    {
+        thread writer([this, &out]
+                      { write(out); });
+
+        string line;
+        uint64_t sequence = 0;
+        while (getline(in, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            {
+                unique_lock<mutex> guard(lock);
+                spaceAvailable.wait(guard, [this, sequence]
+                                    { return sequence - written < WINDOW; });
+            }
+            pool.submit([this, sequence, line]
+                        {
+                            string result;
+                            try
+                            {
+                                result = work(line);
+                            }
+                            catch (const exception &e)
+                            {
+                                result = line + " error " + e.what();
+                            }
+                            finish(sequence, std::move(result)); });
+            ++sequence;
+        }
+
+        pool.wait();
+        {
+            lock_guard<mutex> guard(lock);
+            inputDone = true;
+            total = sequence;
+        }
+        resultAvailable.notify_one();
+        writer.join();
+        return sequence;
+    }
+
+private:
+    ThreadPool &pool;
+    size_t WINDOW;
+    function<string(const string &)> work;
+
+    mutex lock;
+    condition_variable resultAvailable;
+    condition_variable spaceAvailable;
+    map<uint64_t, string> results;
+    uint64_t written = 0;
+    uint64_t total = 0;
+    bool inputDone = false;
+
+    void finish(uint64_t sequence, string result)
+    {
+        lock_guard<mutex> guard(lock);
+        results.emplace(sequence, std::move(result));
+        if (sequence == written)
+        {
+            resultAvailable.notify_one();
+        }
+    }
+
+    void write(ostream &out)
+    {
+        unique_lock<mutex> guard(lock);
+        while (true)
+        {
+            resultAvailable.wait(guard, [this]
+                                 { return results.count(written) || (inputDone && written == total); });
+            if (!results.count(written))
+            {
+                return;
+            }
+            // take every consecutive result that is ready, write them without holding the lock
+            vector<string> ready;
+            for (auto it = results.begin(); it != results.end() && it->first == written; it = results.erase(it), ++written)
+            {
+                ready.push_back(std::move(it->second));
+            }
+            spaceAvailable.notify_one();
+            guard.unlock();
+            for (const string &line : ready)
+            {
+                out << line << '\n';
+            }
+            guard.lock();
+        }
+    }
+};
+
+int main(int argc, char **argv)
+{
+    // Config
+    AnalyzeConfig config;
+    string inputFile;
+    size_t threads = 0;
+    size_t window = 4096;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--input" && i + 1 < argc)
+        {
+            inputFile = argv[++i];
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            threads = max(0, atoi(argv[++i]));
+        }
+        else if (arg == "--budget" && i + 1 < argc)
+        {
+            config.budget = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--tt-mb" && i + 1 < argc)
+        {
+            config.ttEntries = strtoull(argv[++i], nullptr, 10) * 1024 * 1024 / 16;
+        }
+        else if (arg == "--window" && i + 1 < argc)
+        {
+            window = max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--engine" && i + 1 < argc)
+        {
+            string engine = argv[++i];
+            if (engine == "solver")
+            {
+                config.useSolver = true;
+                continue;
+            }
+            // level:depth:pruning, as in the tournament runner
+            config.useSolver = false;
+            stringstream ss(engine);
+            string level;
+            string depth;
+            string pruning;
+            getline(ss, level, ':');
+            getline(ss, depth, ':');
+            getline(ss, pruning, ':');
+            config.level = level == "easy" ? Level::EASY : (level == "medium" ? Level::MEDIUM : Level::HARD);
+            config.depth = depth.empty() ? config.depth : atoi(depth.c_str());
+            config.advancedPruning = pruning != "0";
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--input file] [--threads n] [--engine solver|level:depth:pruning] [--budget nodes] [--tt-mb n] [--window n]" << endl;
+            return 1;
+        }
+    }
+
+    ifstream file;
+    if (!inputFile.empty())
+    {
+        file.open(inputFile);
+        if (!file)
+        {
+            cerr << "Cannot open " << inputFile << endl;
+            return 1;
+        }
+    }
+    istream &in = inputFile.empty() ? cin : file;
+    ios::sync_with_stdio(false);
+
+    ThreadPool pool(threads);
+    auto start = chrono::steady_clock::now();
+    OrderedPipeline pipeline(pool, window, [&config](const string &line)
+                             { return analyzeLine(line, config); });
+    uint64_t count = pipeline.run(in, cout);
+    cout.flush();
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr << count << " positions in " << seconds << " s, " << (seconds > 0 ? count / seconds : 0.0) << " positions/sec" << endl;
+    return 0;
+}
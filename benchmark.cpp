@@ -0,0 +1,403 @@
+#include "include.h"
+#include "Benchmark.h"
+#include <new>
+
+// Count every heap allocation of the process. All replaceable forms are defined, so every new pairs with a delete
+// from this set: the plain, array, sized, nothrow and aligned variants all end in countedAlloc and countedFree.
+static void *countedAlloc(size_t size, size_t alignment = 0) noexcept
+{
+    Benchmark::allocations().fetch_add(1, memory_order_relaxed);
+    size = size ? size : 1;
+    if (alignment <= alignof(max_align_t))
+    {
+        return malloc(size);
+    }
+    void *p = nullptr;
+    return posix_memalign(&p, alignment, size) == 0 ? p : nullptr;
+}
+
+// Out of line: inlined into a delete expression, the free() would be matched against the new that made the pointer
+__attribute__((noinline)) static void countedFree(void *p) noexcept
+{
+    free(p);
+}
+
+void *operator new(size_t size)
+{
+    if (void *p = countedAlloc(size))
+    {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    if (void *p = countedAlloc(size))
+    {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void *operator new(size_t size, const nothrow_t &) noexcept
+{
+    return countedAlloc(size);
+}
+
+void *operator new[](size_t size, const nothrow_t &) noexcept
+{
+    return countedAlloc(size);
+}
+
+void *operator new(size_t size, align_val_t alignment)
+{
+    if (void *p = countedAlloc(size, static_cast<size_t>(alignment)))
+    {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void *operator new[](size_t size, align_val_t alignment)
+{
+    if (void *p = countedAlloc(size, static_cast<size_t>(alignment)))
+    {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void *operator new(size_t size, align_val_t alignment, const nothrow_t &) noexcept
+{
+    return countedAlloc(size, static_cast<size_t>(alignment));
+}
+
+void *operator new[](size_t size, align_val_t alignment, const nothrow_t &) noexcept
+{
+    return countedAlloc(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void *p) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete(void *p, const nothrow_t &) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete[](void *p, const nothrow_t &) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete(void *p, align_val_t) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete[](void *p, align_val_t) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete(void *p, size_t, align_val_t) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete[](void *p, size_t, align_val_t) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete(void *p, align_val_t, const nothrow_t &) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete[](void *p, align_val_t, const nothrow_t &) noexcept
+{
+    countedFree(p);
+}
+
+/**
+ * Run a metric on every playable tile of every corpus position.
+ */
+template <typename Positions, typename Metric>
+uint64_t forEachTile(Positions &corpus, Metric &&metric)
+{
+    uint64_t ops = 0;
+    for (auto &position : corpus)
+    {
+        for (int c = 0; c < Connect4Board::COLS; ++c)
+        {
+            int row = position.board.findRow(c);
+            if (row < 0)
+            {
+                continue;
+            }
+            Benchmark::doNotOptimize(metric(position.board, position.toMove, row, static_cast<Column>(c)));
+            ++ops;
+        }
+    }
+    return ops;
+}
+
+int main(int argc, char **argv)
+{
+    // Config
+    double minSeconds = 0.5;
+    string filter;
+    string jsonFile = "benchmark.json";
+    uint32_t seed = 42;
+    size_t positions = 512;
+    int maxTreeDepth = 5;
+    bool perfCounters = false;
+    bool checkAlloc = false; // only check that expanding a node does not allocate, exit with 1 if it does
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--min-time" && i + 1 < argc)
+        {
+            minSeconds = atof(argv[++i]);
+        }
+        else if (arg == "--filter" && i + 1 < argc)
+        {
+            filter = argv[++i];
+        }
+        else if (arg == "--json" && i + 1 < argc)
+        {
+            jsonFile = argv[++i];
+        }
+        else if (arg == "--seed" && i + 1 < argc)
+        {
+            seed = static_cast<uint32_t>(atoi(argv[++i]));
+        }
+        else if (arg == "--positions" && i + 1 < argc)
+        {
+            positions = static_cast<size_t>(atoi(argv[++i]));
+        }
+        else if (arg == "--max-depth" && i + 1 < argc)
+        {
+            maxTreeDepth = atoi(argv[++i]);
+        }
+        else if (arg == "--perf")
+        {
+            perfCounters = true;
+        }
+        else if (arg == "--check-alloc")
+        {
+            checkAlloc = true;
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--min-time s] [--filter name] [--json file] [--seed n] [--positions n] [--max-depth n] [--perf] [--check-alloc]" << endl;
+            return 1;
+        }
+    }
+
+    vector<CorpusPosition<Connect4Board>> corpus = generateCorpus<Connect4Board>(positions, seed);
+    cout << "Corpus: " << corpus.size() << " positions, seed " << seed << endl;
+
+    if (checkAlloc)
+    {
+        // the node pool, the metrics cache and the search statistics are set up by the first expansion,
+        // after that expanding a node must not touch the heap
+        uint64_t expansions = 0;
+        uint64_t allocations = 0;
+        for (size_t i = 0; i < corpus.size(); ++i)
+        {
+            Connect4Board board = corpus[i].board;
+            TreeNode root(Column::INVALID, "Root", 0, board.getOponent(corpus[i].toMove));
+            uint64_t before = Benchmark::allocations().load(memory_order_relaxed);
+            root.addLayer(board, 1, 0);
+            uint64_t counted = Benchmark::allocations().load(memory_order_relaxed) - before;
+            for (TreeNode *child : root.children)
+            {
+                deleteSubtree(child);
+            }
+            root.children.clear();
+            if (i == 0)
+            {
+                continue;
+            }
+            ++expansions;
+            allocations += counted;
+        }
+        cout << "Node expansion: " << allocations << " heap allocations in " << expansions << " expansions" << endl;
+        return allocations == 0 ? 0 : 1;
+    }
+
+    Benchmark bench(minSeconds, filter);
+    if (perfCounters && !bench.enablePerfCounters())
+    {
+        cout << "Hardware counters are not available (check /proc/sys/kernel/perf_event_paranoid), reporting wall-clock time only" << endl;
+    }
+    bench.printHeader();
+
+    // Board kernels
+    bench.run("Connect4Board::checkWin", [&](Benchmark::State &)
+              {
+        uint64_t ops = 0;
+        for (auto &position : corpus)
+        {
+            Benchmark::doNotOptimize(position.board.checkWin(Player::BOT));
+            Benchmark::doNotOptimize(position.board.checkWin(Player::USER));
+            ops += 2;
+        }
+        return ops; });
+
+    bench.run("Connect4Board::findRow", [&](Benchmark::State &)
+              {
+        uint64_t ops = 0;
+        for (auto &position : corpus)
+        {
+            for (int c = 0; c < Connect4Board::COLS; ++c)
+            {
+                Benchmark::doNotOptimize(position.board.findRow(c));
+                ++ops;
+            }
+        }
+        return ops; });
+
+    bench.run("Connect4Board::getPossibleMoves", [&](Benchmark::State &)
+              {
+        for (auto &position : corpus)
+        {
+            Connect4Board::MoveList moves = position.board.getPossibleMoves();
+            Benchmark::doNotOptimize(moves);
+        }
+        return uint64_t(corpus.size()); });
+
+    bench.run("Connect4Board::nonLosingColumns", [&](Benchmark::State &)
+              {
+        for (auto &position : corpus)
+        {
+            Benchmark::doNotOptimize(position.board.nonLosingColumns(position.toMove));
+        }
+        return uint64_t(corpus.size()); });
+
+    // Tile metrics
+    bench.run("Metrics::getTilePressure", [&](Benchmark::State &)
+              { return forEachTile(corpus, [](Connect4Board &b, Player p, int r, Column c)
+                                   { return Metrics::getTilePressure(b, p, r, c); }); });
+    bench.run("Metrics::getTileWinOptions", [&](Benchmark::State &)
+              { return forEachTile(corpus, [](Connect4Board &b, Player p, int r, Column c)
+                                   { return Metrics::getTileWinOptions(b, p, r, c); }); });
+    bench.run("Metrics::getTileThreat", [&](Benchmark::State &)
+              { return forEachTile(corpus, [](Connect4Board &b, Player p, int r, Column c)
+                                   { return Metrics::getTileThreat(b, p, r, c); }); });
+    bench.run("Metrics::getTileMinorThreat", [&](Benchmark::State &)
+              { return forEachTile(corpus, [](Connect4Board &b, Player p, int r, Column c)
+                                   { return Metrics::getTileMinorThreat(b, p, r, c); }); });
+    bench.run("Metrics::getTileWinningMove", [&](Benchmark::State &)
+              { return forEachTile(corpus, [](Connect4Board &b, Player p, int r, Column c)
+                                   { return Metrics::getTileWinningMove(b, p, r, c); }); });
+    bench.run("Metrics::getTilePreferredWinningRow", [&](Benchmark::State &)
+              { return forEachTile(corpus, [](Connect4Board &b, Player p, int r, Column c)
+                                   { return Metrics::getTilePreferredWinningRow(b, r, c, p); }); });
+    bench.run("Metrics::getTileEnablesOpponentThreat", [&](Benchmark::State &)
+              { return forEachTile(corpus, [](Connect4Board &b, Player p, int, Column c)
+                                   { return Metrics::getTileEnablesOpponentThreat(b, c, p); }); });
+
+    bool useCache = Metrics::useCache;
+    Metrics::useCache = false;
+    bench.run("Metrics::generateMetricsForTile", [&](Benchmark::State &)
+              { return forEachTile(corpus, [](Connect4Board &b, Player p, int r, Column c)
+                                   { return Metrics::generateMetricsForTile(b, p, r, c).pressure; }); });
+    Metrics::useCache = true;
+    bench.run("Metrics::generateMetricsForTile/cached", [&](Benchmark::State &)
+              { return forEachTile(corpus, [](Connect4Board &b, Player p, int r, Column c)
+                                   { return Metrics::generateMetricsForTile(b, p, r, c).pressure; }); });
+    Metrics::useCache = useCache;
+
+    bench.run("Metrics::generateMetricsForLayer", [&](Benchmark::State &)
+              {
+        for (auto &position : corpus)
+        {
+            Benchmark::doNotOptimize(Metrics::generateMetricsForLayer(position.board, position.toMove)[0].pressure);
+        }
+        return uint64_t(corpus.size()); });
+
+    // Tree kernels, the metrics cache is cleared per iteration so every expansion computes its metrics
+    for (int depth = 1; depth <= maxTreeDepth; ++depth)
+    {
+        bench.run("TreeNode::addLayer/depth=" + to_string(depth), [&](Benchmark::State &state)
+                  {
+            uint64_t ops = 0;
+            for (size_t i = 0; i < corpus.size(); i += 8)
+            {
+                state.pauseTiming();
+                Metrics::cache().clear();
+                Connect4Board board = corpus[i].board;
+                TreeNode root(Column::INVALID, "Root", 0, board.getOponent(corpus[i].toMove));
+                state.resumeTiming();
+
+                root.addLayer(board, depth, 0);
+
+                state.pauseTiming();
+                for (TreeNode *child : root.children)
+                {
+                    deleteSubtree(child);
+                }
+                root.children.clear();
+                state.resumeTiming();
+                ++ops;
+            }
+            return ops; });
+    }
+
+    bench.run("Tree::moveRootUp", [&](Benchmark::State &state)
+              {
+        state.pauseTiming();
+        Connect4Board board;
+        Tree tree(board, Player::USER, maxTreeDepth);
+        state.resumeTiming();
+
+        tree.moveRootUp(Column::D);
+
+        state.pauseTiming();
+        deleteSubtree(tree.ROOT);
+        state.resumeTiming();
+        return uint64_t(1); });
+
+    bench.run("Tree::updateTree", [&](Benchmark::State &state)
+              {
+        state.pauseTiming();
+        Connect4Board board;
+        Tree tree(board, Player::USER, maxTreeDepth);
+        tree.EXPORTDOT = false;
+        board.dropDisc(Column::D, Player::USER);
+        state.resumeTiming();
+
+        tree.updateTree(board, Column::D);
+
+        state.pauseTiming();
+        deleteSubtree(tree.ROOT);
+        state.resumeTiming();
+        return uint64_t(1); });
+
+    bench.writeJson(jsonFile);
+    cout << "Results written to " << jsonFile << endl;
+
+    return 0;
+}
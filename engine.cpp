@@ -0,0 +1,9 @@
+#include "include.h"
+#include "EngineProtocol.h"
+
+int main()
+{
+    EngineProtocol protocol(cout);
+    protocol.run(cin);
+    return 0;
+}
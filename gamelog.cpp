@@ -0,0 +1,78 @@
+#include "include.h"
+#include <chrono>
+
+int main(int argc, char **argv)
+{
+    // Config
+    string path;
+    bool dump = false; // if true, print every game as a line "<first player> <level> <result> <moves>"
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--dump")
+        {
+            dump = true;
+        }
+        else if (path.empty() && arg[0] != '-')
+        {
+            path = arg;
+        }
+        else
+        {
+            path.clear();
+            break;
+        }
+    }
+    if (path.empty())
+    {
+        cerr << "Usage: " << argv[0] << " <game log> [--dump]" << endl;
+        return 1;
+    }
+
+    try
+    {
+        auto start = chrono::steady_clock::now();
+        GameLogReader reader(path);
+
+        array<uint64_t, 4> results{};
+        array<uint64_t, GameLog::COLS> firstMoves{};
+        uint64_t moves = 0;
+        for (GameLogReader::Game game : reader)
+        {
+            if (game.result() <= GameLog::DRAW)
+            {
+                ++results[game.result()];
+            }
+            moves += game.moves();
+            if (game.moves() > 0)
+            {
+                ++firstMoves[game.column(0)];
+            }
+            if (dump)
+            {
+                cout << Connect4Board::playerToChar(game.firstPlayer()) << " " << static_cast<int>(game.level()) << " "
+                     << static_cast<int>(game.result()) << " " << game.moveString() << "\n";
+            }
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        size_t games = reader.games();
+        cout << games << " games, " << moves << " moves, " << (games ? static_cast<double>(moves) / games : 0.0) << " moves/game" << endl;
+        cout << "X (bot) wins " << results[GameLog::BOTWIN] << ", O (user) wins " << results[GameLog::USERWIN]
+             << ", draws " << results[GameLog::DRAW] << ", unfinished " << results[GameLog::UNFINISHED] << endl;
+        cout << "First moves:";
+        for (int c = 0; c < GameLog::COLS; ++c)
+        {
+            cout << " " << Connect4Board::colToChar(static_cast<Column>(c)) << "=" << firstMoves[c];
+        }
+        cout << endl;
+        cout << "Read in " << seconds << " s, " << (seconds > 0 ? games / seconds : 0.0) << " games/sec" << endl;
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "include.h"
+#include <memory>
 
 int main()
 {
@@ -7,6 +8,13 @@ int main()
 
     // Config
     bool debug = false;
+    bool stats = false;          // if true, print the search counters after every move
+    bool memory = false;         // if true, print the memory footprint of the tree after every move
+    bool exportDot = true;       // if true, the tree is written to tree.dot and tree.svg after every move
+    string gameLog = "games.c4log"; // every game is appended to this binary game log, empty to disable
+    string book = "book.c4pi";      // position index built by indexer.cpp, used for the bot's moves while the position is known
+    string treeSnapshot = "tree.c4ts"; // the initial game tree is loaded from this snapshot, or built and saved to it, empty to always build
+    size_t takebacks = 8;        // moves 'undo' takes back instantly, the tree keeps that many previous roots
     bool run = true;
     bool letBotPlay = true;      // if false, the user plays both players
     int depth = 7;               // depth of the game tree, higher values will take longer to compute, depth=4 should compile fast enough, 5 or higher will be slow
@@ -18,28 +26,58 @@ int main()
 
     Level level = Level::HARD; // EASY, MEDIUM, HARD
 
-    GameTheorie brain = GameTheorie(initBoard, startingPlayer, depth, level, advancedPruning);
+    GameTheorie brain = GameTheorie(initBoard, startingPlayer, depth, level, advancedPruning, exportDot, treeSnapshot);
+    brain.setTakebacks(takebacks);
+    unique_ptr<PositionIndex> bookIndex;
+    if (!book.empty() && filesystem::exists(book))
+    {
+        bookIndex = make_unique<PositionIndex>(book);
+        brain.setBook(bookIndex.get());
+        cout << "Using book " << book << " with " << bookIndex->size() << " positions" << endl;
+    }
     Connect4Board board = brain.getBoard();
 
     board.print();
 
     string move;
+    bool skipBot = false; // the bot moves first, but not right after an undo
     while (run)
     {
         if (startingPlayer == Player::USER)
         {
-            cout << "User: Enter your move (A-G) or 'exit' to quit: " << endl;
+            cout << "User: Enter your move (A-G), 'undo' to take your last move back or 'exit' to quit: " << endl;
             getline(cin, move);
             if (move == "exit" || move == "Exit" || move == "quit" || move == "q")
             {
                 break;
             }
+            if (move == "undo" || move == "u")
+            {
+                // the bot's reply and the user's move, nothing before the user's first move
+                if (brain.MOVERECORDER.getHistory().size() >= 2 && brain.undoMove() && brain.undoMove())
+                {
+                    brain.printBoard();
+                }
+                else
+                {
+                    cout << "Nothing to undo" << endl;
+                }
+                continue;
+            }
             // player 1
 
             Column col = Connect4Board::charToColumn(move[0]);
 
             bool userWon = brain.playMove(col, startingPlayer);
             brain.printBoard();
+            if (stats)
+            {
+                brain.printMoveStats();
+            }
+            if (memory)
+            {
+                brain.getTree()->printMemory();
+            }
             if (userWon)
             {
                 cout << "User won!" << endl;
@@ -61,6 +99,14 @@ int main()
             bool botWon = brain.playMove(bestMove, opponentPlayer);
 
             brain.printBoard();
+            if (stats)
+            {
+                brain.printMoveStats();
+            }
+            if (memory)
+            {
+                brain.getTree()->printMemory();
+            }
             if (botWon)
             {
                 cout << "Bot won!" << endl;
@@ -69,39 +115,72 @@ int main()
         }
         else
         {
-
-            // player 2
-            Column bestMove = brain.getBestMove(level, debug);
-
-            if (!letBotPlay)
-            {
-                cout << "Best move for user: " << Connect4Board::colToChar(bestMove) << endl;
-                cout << "Bot: Enter your move (A-G) or 'exit' to quit: " << endl;
-                getline(cin, move);
-                bestMove = Connect4Board::charToColumn(move[0]);
-            }
-
-            bool botWon = brain.playMove(bestMove, opponentPlayer);
-
-            brain.printBoard();
-            if (botWon)
+            // player 2, unless the user took moves back and is to move again
+            if (!skipBot)
             {
-                cout << "Bot won!" << endl;
-                break;
+                Column bestMove = brain.getBestMove(level, debug);
+
+                if (!letBotPlay)
+                {
+                    cout << "Best move for user: " << Connect4Board::colToChar(bestMove) << endl;
+                    cout << "Bot: Enter your move (A-G) or 'exit' to quit: " << endl;
+                    getline(cin, move);
+                    bestMove = Connect4Board::charToColumn(move[0]);
+                }
+
+                bool botWon = brain.playMove(bestMove, opponentPlayer);
+
+                brain.printBoard();
+                if (stats)
+                {
+                    brain.printMoveStats();
+                }
+                if (memory)
+                {
+                    brain.getTree()->printMemory();
+                }
+                if (botWon)
+                {
+                    cout << "Bot won!" << endl;
+                    break;
+                }
             }
+            skipBot = false;
 
-            cout << "User: Enter your move (A-G) or 'exit' to quit: " << endl;
+            cout << "User: Enter your move (A-G), 'undo' to take your last move back or 'exit' to quit: " << endl;
             getline(cin, move);
             if (move == "exit" || move == "Exit" || move == "quit" || move == "q")
             {
                 break;
             }
+            if (move == "undo" || move == "u")
+            {
+                // the bot's reply and the user's move, nothing before the user's first move; the user moves again
+                if (brain.MOVERECORDER.getHistory().size() >= 2 && brain.undoMove() && brain.undoMove())
+                {
+                    brain.printBoard();
+                }
+                else
+                {
+                    cout << "Nothing to undo" << endl;
+                }
+                skipBot = true;
+                continue;
+            }
             // player 1
 
             Column col = Connect4Board::charToColumn(move[0]);
 
             bool userWon = brain.playMove(col, startingPlayer);
             brain.printBoard();
+            if (stats)
+            {
+                brain.printMoveStats();
+            }
+            if (memory)
+            {
+                brain.getTree()->printMemory();
+            }
             if (userWon)
             {
                 cout << "User won!" << endl;
@@ -116,6 +195,27 @@ int main()
     }
     cout << "Game over!" << endl;
     brain.printHistory();
+    if (!gameLog.empty())
+    {
+        GameLogWriter log(gameLog);
+        brain.saveGame(log);
+        log.close();
+        cout << "Game appended to " << gameLog << " (" << log.size() << " games)" << endl;
+    }
+    if (debug)
+    {
+        Metrics::cache().printStats();
+    }
+    if (stats)
+    {
+        cout << "Search totals:" << endl;
+        SearchStats::aggregate().print();
+    }
+    if (Trace::ENABLED)
+    {
+        size_t spans = Trace::dump("trace.json");
+        cout << "Trace with " << spans << " spans written to trace.json" << endl;
+    }
 
     return 0;
 }
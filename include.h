@@ -13,15 +13,33 @@
 #include <sstream>
 #include <cstdlib>
 #include <queue>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <mutex>
+#include <initializer_list>
+#include <type_traits>
+#include <atomic>
 
 using namespace std;
 
+#include "BoundsCheck.h"
+#include "StaticVector.h"
+#include "NodePool.h"
+#include "SearchStats.h"
+#include "Trace.h"
 #include "Connect4Board.h"
 using Column = Connect4Board::Column;
 using Player = Connect4Board::Player;
 
+#include "MappedFile.h"
+#include "GameLog.h"
+#include "PositionIndex.h"
 #include "MoveRecorder.h"
 #include "Metrics.h"
+#include "TreeSnapshot.h"
+#include "Reclaimer.h"
+#include "Published.h"
 #include "Tree.h"
 #include "GameTheorie.h"
 using Level = GameTheorie::Level;
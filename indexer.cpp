@@ -0,0 +1,134 @@
+#include "include.h"
+#include <chrono>
+#include <iomanip>
+
+/**
+ * Print the statistics of a position given as a move string, e.g. "DDC".
+ */
+int query(const string &indexFile, const string &moves)
+{
+    PositionIndex index(indexFile);
+    Connect4Board board;
+    Player player = Player::USER;
+    for (char c : moves)
+    {
+        Column column = Connect4Board::charToColumn(c);
+        if (column >= Connect4Board::COLS || board.findRow(column) < 0)
+        {
+            cerr << "Illegal move " << c << endl;
+            return 1;
+        }
+        board.dropDisc(column, player);
+        player = board.getOponent(player);
+    }
+
+    PositionIndex::Record record;
+    if (!index.lookup(board, Player::USER, record))
+    {
+        cout << "Position not in the index" << endl;
+        return 0;
+    }
+    cout << "Visits " << record.visits << endl;
+    cout << "move      wins     draws    losses     score" << endl;
+    for (int column = 0; column < Connect4Board::COLS; ++column)
+    {
+        const PositionIndex::MoveStats &m = record.moves[column];
+        if (m.games() == 0)
+        {
+            continue;
+        }
+        cout << setw(4) << Connect4Board::colToChar(static_cast<Column>(column)) << setw(10) << m.wins << setw(10) << m.draws
+             << setw(10) << m.losses << setw(10) << fixed << setprecision(3) << m.score() << endl;
+    }
+    Column best = index.bestMove(board, Player::USER, 1);
+    if (best != Column::INVALID)
+    {
+        cout << "Best move " << Connect4Board::colToChar(best) << endl;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    // Config
+    vector<string> logs;
+    string indexFile = "book.c4pi";
+    string queryMoves;
+    bool queryMode = false;
+    int maxPly = 16;         // positions with this many discs or more are not indexed
+    uint32_t minVisits = 1;  // positions seen less often are left out
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--out" && i + 1 < argc)
+        {
+            indexFile = argv[++i];
+        }
+        else if (arg == "--max-ply" && i + 1 < argc)
+        {
+            maxPly = atoi(argv[++i]);
+        }
+        else if (arg == "--min-visits" && i + 1 < argc)
+        {
+            minVisits = static_cast<uint32_t>(atoi(argv[++i]));
+        }
+        else if (arg == "--query" && i + 1 < argc)
+        {
+            queryMode = true;
+            queryMoves = argv[++i];
+        }
+        else if (arg[0] != '-')
+        {
+            logs.push_back(arg);
+        }
+        else
+        {
+            logs.clear();
+            queryMode = false;
+            break;
+        }
+    }
+    if (logs.empty() && !queryMode)
+    {
+        cerr << "Usage: " << argv[0] << " [--out index] [--max-ply n] [--min-visits n] <game log>..." << endl;
+        cerr << "       " << argv[0] << " [--out index] --query <moves>" << endl;
+        return 1;
+    }
+
+    try
+    {
+        if (queryMode)
+        {
+            return query(indexFile, queryMoves);
+        }
+
+        auto start = chrono::steady_clock::now();
+        PositionIndexBuilder builder(maxPly);
+        size_t games = 0;
+        size_t invalid = 0;
+        for (const string &log : logs)
+        {
+            GameLogReader reader(log);
+            for (GameLogReader::Game game : reader)
+            {
+                ++games;
+                if (!builder.add(game))
+                {
+                    ++invalid;
+                }
+            }
+        }
+        size_t written = builder.write(indexFile, minVisits);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        cout << games << " games (" << invalid << " invalid), " << builder.size() << " positions, " << written
+             << " written to " << indexFile << " in " << seconds << " s" << endl;
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
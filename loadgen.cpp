@@ -0,0 +1,217 @@
+#include "include.h"
+#include "LocalSocket.h"
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <thread>
+
+/**
+ * Latency percentile in microseconds.
+ */
+double percentile(vector<double> &samples, double p)
+{
+    if (samples.empty())
+    {
+        return 0.0;
+    }
+    size_t index = min(samples.size() - 1, static_cast<size_t>(p / 100.0 * samples.size()));
+    nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+void printLatency(const string &name, vector<double> &samples)
+{
+    cout << name << " latency us: p50 " << percentile(samples, 50) << " p90 " << percentile(samples, 90) << " p99 "
+         << percentile(samples, 99) << " max " << percentile(samples, 100) << " (" << samples.size() << " samples)" << endl;
+}
+
+/**
+ * Results of one client connection
+ */
+struct ClientResult
+{
+    vector<double> moveLatency;
+    vector<double> newLatency;
+    size_t finished = 0;
+    size_t errors = 0;
+};
+
+/**
+ * Play random games over one connection, keeping a number of sessions open and moving in each in turn.
+ */
+void runClient(const string &socketPath, const string &newCommand, int live, atomic<int> &remaining, uint32_t seed, ClientResult &result)
+{
+    unique_ptr<LocalSocket> socket = LocalSocket::connect(socketPath);
+    mt19937 rng(seed);
+    struct Game
+    {
+        string id;
+        Connect4Board board;
+    };
+    vector<Game> games;
+
+    auto request = [&](const string &command, vector<double> &latency)
+    {
+        auto start = chrono::steady_clock::now();
+        string line;
+        if (!socket->writeLine(command) || !socket->readLine(line))
+        {
+            throw runtime_error("Connection closed by the server");
+        }
+        latency.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+        return line;
+    };
+    auto open = [&]()
+    {
+        if (remaining.fetch_sub(1) <= 0)
+        {
+            return false;
+        }
+        stringstream reply(request(newCommand, result.newLatency));
+        string word;
+        Game game;
+        if (!(reply >> word >> game.id) || word != "session")
+        {
+            ++result.errors;
+            return true;
+        }
+        string bot;
+        if (reply >> word >> bot && word == "bot")
+        {
+            game.board.dropDisc(Connect4Board::charToColumn(bot[0]), Player::BOT);
+        }
+        games.push_back(game);
+        return true;
+    };
+
+    while (true)
+    {
+        while (static_cast<int>(games.size()) < live && open())
+        {
+        }
+        if (games.empty())
+        {
+            break;
+        }
+        for (size_t i = 0; i < games.size();)
+        {
+            Game &game = games[i];
+            typename Connect4Board::MoveList moves = game.board.getPossibleMoves();
+            Column column = moves[rng() % moves.size()];
+            stringstream reply(request("play " + game.id + " " + Connect4Board::colToChar(column), result.moveLatency));
+            string id, played, user, botWord, bot, resultWord, outcome;
+            reply >> id >> played >> user >> botWord >> bot >> resultWord >> outcome;
+            bool over = true;
+            if (played != "played")
+            {
+                ++result.errors;
+            }
+            else
+            {
+                game.board.dropDisc(column, Player::USER);
+                if (bot != "none")
+                {
+                    game.board.dropDisc(Connect4Board::charToColumn(bot[0]), Player::BOT);
+                }
+                over = outcome != "ongoing";
+            }
+            if (!over)
+            {
+                ++i;
+                continue;
+            }
+            vector<double> closeLatency;
+            request("close " + game.id, closeLatency);
+            ++result.finished;
+            games.erase(games.begin() + static_cast<long>(i));
+        }
+    }
+    socket->writeLine("quit");
+}
+
+int main(int argc, char **argv)
+{
+    // Config
+    string socketPath = "c4.sock";
+    int clients = 8;      // connections, each plays its sessions one move at a time
+    int live = 4;         // sessions kept open per connection, clients * live sessions are in play at once
+    int sessions = 200;   // games played in total
+    int depth = 0;        // tree depth of the sessions, 0 for the server default
+    uint32_t seed = 1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc)
+        {
+            socketPath = argv[++i];
+        }
+        else if (arg == "--clients" && i + 1 < argc)
+        {
+            clients = max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--live" && i + 1 < argc)
+        {
+            live = max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--sessions" && i + 1 < argc)
+        {
+            sessions = atoi(argv[++i]);
+        }
+        else if (arg == "--depth" && i + 1 < argc)
+        {
+            depth = atoi(argv[++i]);
+        }
+        else if (arg == "--seed" && i + 1 < argc)
+        {
+            seed = static_cast<uint32_t>(atoi(argv[++i]));
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--socket path] [--clients n] [--live n] [--sessions n] [--depth d] [--seed n]" << endl;
+            return 1;
+        }
+    }
+
+    string newCommand = depth > 0 ? "new depth " + to_string(depth) : "new";
+    atomic<int> remaining{sessions};
+    vector<ClientResult> results(static_cast<size_t>(clients));
+    vector<thread> threads;
+    atomic<int> failed{0};
+    auto start = chrono::steady_clock::now();
+    for (int c = 0; c < clients; ++c)
+    {
+        threads.emplace_back([&, c]
+                             {
+            try
+            {
+                runClient(socketPath, newCommand, live, remaining, seed + static_cast<uint32_t>(c), results[static_cast<size_t>(c)]);
+            }
+            catch (const exception &e)
+            {
+                cerr << "Client " << c << ": " << e.what() << endl;
+                ++failed;
+            } });
+    }
+    for (thread &t : threads)
+    {
+        t.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    ClientResult total;
+    for (ClientResult &r : results)
+    {
+        total.moveLatency.insert(total.moveLatency.end(), r.moveLatency.begin(), r.moveLatency.end());
+        total.newLatency.insert(total.newLatency.end(), r.newLatency.begin(), r.newLatency.end());
+        total.finished += r.finished;
+        total.errors += r.errors;
+    }
+    cout << fixed << setprecision(1);
+    cout << total.finished << " sessions in " << seconds << " s: " << total.finished / seconds << " sessions/s, "
+         << total.moveLatency.size() << " moves, " << total.moveLatency.size() / seconds << " moves/s, "
+         << clients * live << " sessions in play, " << total.errors << " errors" << endl;
+    printLatency("move", total.moveLatency);
+    printLatency("new", total.newLatency);
+    return failed > 0 || total.errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+#include "include.h"
+#include "Perft.h"
+#include <chrono>
+
+/**
+ * Run perft on a board variant.
+ * @param moves The moves leading to the start position, e.g. "DCE".
+ * @param maxDepth Count every depth from 1 up to this depth.
+ * @param divide Print the counts per first move.
+ * @param check Compare against the known values.
+ * @return The number of mismatches with the known values.
+ */
+template <typename Board>
+int runPerft(const string &moves, int maxDepth, bool divide, bool check)
+{
+    Board board;
+    Player player = Player::USER;
+    for (char ch : moves)
+    {
+        Column column = Board::charToColumn(ch);
+        if (column >= Board::COLS || !board.columnHasSpace(column))
+        {
+            throw invalid_argument(string("Illegal move in move string: ") + ch);
+        }
+        if (board.dropDisc(column, player))
+        {
+            throw invalid_argument("The move string ends the game");
+        }
+        player = board.getOponent(player);
+    }
+
+    board.print();
+    cout << "Board " << Board::ROWS << "x" << Board::COLS << ", connect " << Board::WIN << endl;
+
+    int mismatches = 0;
+    for (int depth = 1; depth <= maxDepth; ++depth)
+    {
+        auto start = chrono::steady_clock::now();
+        uint64_t nodes = Perft::count(board, player, depth);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        cout << "depth " << depth << ": " << nodes << " nodes, " << seconds << " s, "
+             << static_cast<uint64_t>(seconds > 0 ? nodes / seconds : 0) << " nodes/s";
+
+        uint64_t expected = 0;
+        if (check && Perft::known(board, depth, expected))
+        {
+            bool ok = expected == nodes;
+            cout << (ok ? "  OK" : "  MISMATCH, expected " + to_string(expected));
+            if (!ok)
+            {
+                ++mismatches;
+            }
+        }
+        cout << endl;
+    }
+
+    if (divide && maxDepth > 0)
+    {
+        cout << "Divide at depth " << maxDepth << ":" << endl;
+        for (auto &entry : Perft::divide(board, player, maxDepth))
+        {
+            cout << "  " << Board::colToChar(entry.first) << ": " << entry.second << endl;
+        }
+    }
+
+    return mismatches;
+}
+
+int main(int argc, char **argv)
+{
+    // Config
+    int depth = 8;
+    string moves;
+    string variant = "6x7x4";
+    bool divide = false;
+    bool check = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--depth" && i + 1 < argc)
+        {
+            depth = atoi(argv[++i]);
+        }
+        else if (arg == "--moves" && i + 1 < argc)
+        {
+            moves = argv[++i];
+        }
+        else if (arg == "--board" && i + 1 < argc)
+        {
+            variant = argv[++i];
+        }
+        else if (arg == "--divide")
+        {
+            divide = true;
+        }
+        else if (arg == "--check")
+        {
+            check = true;
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--depth n] [--moves DCE] [--board 6x7x4|7x6x4|8x7x4|6x7x5] [--divide] [--check]" << endl;
+            return 1;
+        }
+    }
+
+    int mismatches = 0;
+    if (variant == "6x7x4")
+    {
+        mismatches = runPerft<Connect4Board>(moves, depth, divide, check);
+    }
+    else if (variant == "7x6x4")
+    {
+        mismatches = runPerft<BasicConnect4Board<7, 6, 4>>(moves, depth, divide, check);
+    }
+    else if (variant == "8x7x4")
+    {
+        mismatches = runPerft<BasicConnect4Board<8, 7, 4>>(moves, depth, divide, check);
+    }
+    else if (variant == "6x7x5")
+    {
+        mismatches = runPerft<BasicConnect4Board<6, 7, 5>>(moves, depth, divide, check);
+    }
+    else
+    {
+        cerr << "Unknown board variant: " << variant << endl;
+        return 1;
+    }
+
+    return mismatches == 0 ? 0 : 1;
+}
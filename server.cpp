@@ -0,0 +1,116 @@
+#include "include.h"
+#include "SessionServer.h"
+#include "LocalSocket.h"
+#include <csignal>
+#include <memory>
+#include <thread>
+
+/**
+ * Serve one client connection until it quits or disconnects, then close the sessions it left open.
+ */
+void serveClient(SessionServer &server, shared_ptr<LocalSocket> client)
+{
+    SessionServer::Reply reply = [client](const string &message)
+    {
+        client->writeLine(message);
+    };
+    SessionServer::Owned owned;
+    string line;
+    while (client->readLine(line) && server.execute(line, reply, owned))
+    {
+    }
+    client->shutdown();
+    server.disconnect(owned);
+}
+
+int main(int argc, char **argv)
+{
+    // Config
+    SessionServer::Config config;
+    string socketPath;              // serve on this unix socket, empty to serve stdin/stdout
+    string book = "book.c4pi";      // position index shared by all sessions, used if present
+    config.threads = 0;             // workers, 0 for one per hardware thread
+    config.depth = 4;               // tree depth of new sessions
+    config.maxDepth = 0;            // deepest tree a client may request, 0 for depth
+    config.treeSnapshot = "";       // initial tree of sessions with the default settings, e.g. server.c4ts
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc)
+        {
+            socketPath = argv[++i];
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            config.threads = static_cast<size_t>(atoi(argv[++i]));
+        }
+        else if (arg == "--depth" && i + 1 < argc)
+        {
+            config.depth = atoi(argv[++i]);
+        }
+        else if (arg == "--max-depth" && i + 1 < argc)
+        {
+            config.maxDepth = atoi(argv[++i]);
+        }
+        else if (arg == "--pruning" && i + 1 < argc)
+        {
+            config.advancedPruning = atoi(argv[++i]) != 0;
+        }
+        else if (arg == "--book" && i + 1 < argc)
+        {
+            book = argv[++i];
+        }
+        else if (arg == "--snapshot" && i + 1 < argc)
+        {
+            config.treeSnapshot = argv[++i];
+        }
+        else if (arg == "--dot-dir" && i + 1 < argc)
+        {
+            config.dotDir = argv[++i];
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--socket path] [--threads n] [--depth d] [--max-depth d] [--pruning 0|1] [--book index] [--snapshot file] [--dot-dir dir]" << endl;
+            cerr << "Commands are documented in SessionServer.h, without --socket they are read from stdin." << endl;
+            return 1;
+        }
+    }
+
+    try
+    {
+        unique_ptr<PositionIndex> bookIndex;
+        if (!book.empty() && filesystem::exists(book))
+        {
+            bookIndex = make_unique<PositionIndex>(book);
+            config.book = bookIndex.get();
+        }
+        SessionServer server(config);
+
+        if (socketPath.empty())
+        {
+            server.serve(cin, cout);
+            return 0;
+        }
+
+        unique_ptr<LocalSocket> listener = LocalSocket::listen(socketPath);
+        cerr << "Serving on " << socketPath << " with " << server.threads() << " workers"
+             << (bookIndex ? ", book " + book : "") << endl;
+        signal(SIGPIPE, SIG_IGN);
+        while (true)
+        {
+            unique_ptr<LocalSocket> client = listener->accept();
+            if (!client)
+            {
+                break;
+            }
+            thread(serveClient, ref(server), shared_ptr<LocalSocket>(std::move(client))).detach();
+        }
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
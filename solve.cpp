@@ -0,0 +1,89 @@
+#include "include.h"
+#include "DistributedSolver.h"
+#include <chrono>
+#include <thread>
+
+int main(int argc, char **argv)
+{
+    // Config
+    DistributedSolver::Config config;
+    config.workers = max(1u, thread::hardware_concurrency()); // worker processes
+    config.split = 2;                                           // moves in the opening prefixes
+    vector<string> positions;                                   // move strings, read from stdin if none are given
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--workers" && i + 1 < argc)
+        {
+            config.workers = static_cast<size_t>(max(1, atoi(argv[++i])));
+        }
+        else if (arg == "--split" && i + 1 < argc)
+        {
+            config.split = max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--tt-mb" && i + 1 < argc)
+        {
+            config.ttEntries = strtoull(argv[++i], nullptr, 10) * 1024 * 1024 / 16;
+        }
+        else if (arg == "--budget" && i + 1 < argc)
+        {
+            config.budget = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--checkpoint" && i + 1 < argc)
+        {
+            config.checkpoint = argv[++i];
+        }
+        else if (arg == "--checkpoint-seconds" && i + 1 < argc)
+        {
+            config.checkpointSeconds = atof(argv[++i]);
+        }
+        else if (arg == "--heartbeat" && i + 1 < argc)
+        {
+            config.heartbeatSeconds = atof(argv[++i]);
+        }
+        else if (arg == "--verbose")
+        {
+            config.verbose = true;
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            cerr << "Usage: " << argv[0] << " [--workers n] [--split moves] [--tt-mb m] [--budget nodes] [--checkpoint file] [--checkpoint-seconds s] [--heartbeat s] [--verbose] [moves...]" << endl;
+            return 1;
+        }
+        else
+        {
+            positions.push_back(arg);
+        }
+    }
+    if (positions.empty())
+    {
+        string line;
+        while (getline(cin, line))
+        {
+            positions.push_back(line);
+        }
+    }
+
+    DistributedSolver solver(config);
+    int status = 0;
+    for (const string &moves : positions)
+    {
+        auto start = chrono::steady_clock::now();
+        try
+        {
+            DistributedSolver::Result result = solver.solve(moves);
+            auto us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+            cout << moves << " bestmove " << Connect4Board::colToChar(result.bestMove) << " score " << result.score
+                 << " exact " << result.exact << " nodes " << result.nodes << " subproblems " << result.subproblems
+                 << " solved " << result.solved << " searches " << result.searches << " merged " << result.merged << " redispatched " << result.redispatched << " resumed " << result.resumed
+                 << " time " << us << endl;
+        }
+        catch (const exception &e)
+        {
+            cout << moves << " error " << e.what() << endl;
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,91 @@
+#include "include.h"
+#include "Tournament.h"
+
+int main(int argc, char **argv)
+{
+    // Config
+    vector<string> specs;
+    int games = 100;
+    int openingMoves = 4;
+    uint32_t seed = 42;
+    size_t threads = 0;
+    string logFile;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--engine" && i + 1 < argc)
+        {
+            specs.push_back(argv[++i]);
+        }
+        else if (arg == "--games" && i + 1 < argc)
+        {
+            games = atoi(argv[++i]);
+        }
+        else if (arg == "--opening" && i + 1 < argc)
+        {
+            openingMoves = atoi(argv[++i]);
+        }
+        else if (arg == "--seed" && i + 1 < argc)
+        {
+            seed = static_cast<uint32_t>(atoi(argv[++i]));
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            threads = static_cast<size_t>(atoi(argv[++i]));
+        }
+        else if (arg == "--log" && i + 1 < argc)
+        {
+            logFile = argv[++i];
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--engine level:depth:pruning]... [--games n] [--opening n] [--seed n] [--threads n] [--log file]" << endl;
+            cerr << "  e.g. --engine easy:4:0 --engine hard:7:1" << endl;
+            return 1;
+        }
+    }
+    if (specs.empty())
+    {
+        specs = {"easy:4:0", "medium:4:0", "hard:4:0", "hard:7:1"};
+    }
+    if (specs.size() < 2)
+    {
+        cerr << "At least two engines are needed." << endl;
+        return 1;
+    }
+
+    vector<EngineConfig> engines;
+    try
+    {
+        for (const string &spec : specs)
+        {
+            engines.push_back(EngineConfig::parse(spec));
+        }
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    unique_ptr<GameLogWriter> log;
+    if (!logFile.empty())
+    {
+        log = make_unique<GameLogWriter>(logFile);
+    }
+
+    ThreadPool pool(threads);
+    Tournament tournament(engines, games, openingMoves, seed);
+    tournament.setGameLog(log.get());
+    cout << "Playing " << games << " games per pair on " << pool.size() << " threads, " << openingMoves << " random opening moves, seed " << seed << endl;
+    tournament.run(pool);
+    tournament.print();
+    if (log)
+    {
+        log->close();
+        cout << "Games appended to " << logFile << " (" << log->size() << " games)" << endl;
+    }
+
+    return 0;
+}